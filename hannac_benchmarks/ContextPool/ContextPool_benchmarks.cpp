@@ -0,0 +1,68 @@
+#include "Allocations.hpp"
+#include "ContextPool.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Programs.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "Trace.hpp"
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace
+{
+// Heap allocations of all phases so far, 0 unless allocations are tracked.
+std::uint64_t count_allocations()
+{
+    std::uint64_t allocations = 0;
+    for (std::size_t slot = 0; slot < hannac::HAllocationTracker::Slots; slot++)
+        allocations += hannac::HAllocationTracker::get_stats(static_cast<hannac::HPhase>(slot)).mAllocations;
+    return allocations;
+}
+} // namespace
+
+// Overhead per generated function when running a program of state.range(0) methods, each called by its own
+// statement. Every method and every statement is a function in its own module, all taking their context from the
+// pool. Setting up the session and parsing aren't timed, the allocations are counted in builds configured with
+// HANNAC_TRACK_ALLOCATIONS.
+static void BM_ContextPoolProgram(benchmark::State &state)
+{
+    auto methods = static_cast<std::size_t>(state.range(0));
+    hannac::benchmarks::HProgramFile file{"pool", hannac::benchmarks::make_program(methods, methods)};
+    std::uint64_t functions = 0;
+    std::uint64_t allocations = 0;
+    hannac::HContextPoolStats pool;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto session = std::make_unique<hannac::HSession>();
+        hannac::HTokenParser parser{*session, hannac::HLexer{hannac::HFileParser{file.get_path()}}};
+        auto executor = std::make_unique<hannac::HExecutor>(*session, parser.parse());
+        auto startAllocations = count_allocations();
+        state.ResumeTiming();
+
+        auto results = (*executor)();
+
+        state.PauseTiming();
+        allocations += count_allocations() - startAllocations;
+        functions += session->get_library().get_compiled_methods() + results.size();
+        auto stats = session->get_context_pool().get_stats();
+        pool.mCreated += stats.mCreated;
+        pool.mReused += stats.mReused;
+        executor.reset();
+        session.reset();
+        state.ResumeTiming();
+    }
+    state.counters["function"] =
+        benchmark::Counter(functions, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["contexts_created"] = benchmark::Counter(pool.mCreated, benchmark::Counter::kAvgIterations);
+    state.counters["contexts_reused"] = benchmark::Counter(pool.mReused, benchmark::Counter::kAvgIterations);
+    if (hannac::HAllocationTracker::enabled())
+        state.counters["allocations_per_function"] =
+            benchmark::Counter(functions > 0 ? static_cast<double>(allocations) / functions : 0.0);
+}
+BENCHMARK(BM_ContextPoolProgram)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
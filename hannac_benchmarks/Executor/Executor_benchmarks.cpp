@@ -0,0 +1,50 @@
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Programs.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstdint>
+#include <memory>
+
+// Round trip of a main statement calling a compiled method: generating and adding its module, looking it up,
+// running it and removing it again.
+// The methods are defined in a library session and compiled by a first run. Every iteration runs the statements of
+// a new program session linked against it, setting up and parsing the program isn't timed.
+static void BM_ExecutorStatement(benchmark::State &state)
+{
+    constexpr std::size_t Methods = 10;
+    hannac::benchmarks::HProgramFile methods{"methods", hannac::benchmarks::make_methods(Methods)};
+    hannac::benchmarks::HProgramFile main{"statements", hannac::benchmarks::make_main(Methods, state.range(0))};
+
+    hannac::HSession library;
+    hannac::HTokenParser{library, hannac::HLexer{hannac::HFileParser{methods.get_path()}}}.parse_library();
+    {
+        hannac::HSession program{library};
+        hannac::HTokenParser parser{program, hannac::HLexer{hannac::HFileParser{main.get_path()}}};
+        hannac::HExecutor{program, parser.parse()}();
+    }
+
+    std::uint64_t statements = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto program = std::make_unique<hannac::HSession>(library);
+        hannac::HTokenParser parser{*program, hannac::HLexer{hannac::HFileParser{main.get_path()}}};
+        auto executor = std::make_unique<hannac::HExecutor>(*program, parser.parse());
+        state.ResumeTiming();
+
+        auto results = (*executor)();
+        statements += results.size();
+
+        state.PauseTiming();
+        executor.reset();
+        program.reset();
+        state.ResumeTiming();
+    }
+    state.counters["statement"] =
+        benchmark::Counter(statements, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_ExecutorStatement)->Arg(100);
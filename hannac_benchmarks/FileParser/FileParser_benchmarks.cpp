@@ -0,0 +1,26 @@
+#include "FileParser.hpp"
+#include "Programs.hpp"
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstdint>
+#include <cstdio>
+
+// Characters read per second from a program of state.range(0) methods.
+static void BM_FileParserRead(benchmark::State &state)
+{
+    hannac::benchmarks::HProgramFile file{"read", hannac::benchmarks::make_program(state.range(0), state.range(0))};
+    std::int64_t characters = 0;
+    for (auto _ : state)
+    {
+        hannac::HFileParser parser{file.get_path()};
+        char current;
+        while ((current = parser.read()) != EOF)
+        {
+            benchmark::DoNotOptimize(current);
+            characters++;
+        }
+    }
+    state.SetBytesProcessed(characters);
+}
+BENCHMARK(BM_FileParserRead)->Arg(100)->Arg(10000);
@@ -0,0 +1,144 @@
+#include "Codegen.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "JIT.hpp"
+#include "Programs.hpp"
+#include "Scheduler.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "benchmark/benchmark.h"
+
+// llvm includes.
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace
+{
+// Generate a function name returning value into the module of ctx.
+void gen_constant(hannac::HCompilationContext &ctx, std::string const &name, std::int64_t value)
+{
+    auto &builder = ctx.get_builder();
+    auto type = llvm::FunctionType::get(builder.getInt64Ty(), false);
+    auto function = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, ctx.get_module());
+    builder.SetInsertPoint(llvm::BasicBlock::Create(ctx.get_context(), "entry", function));
+    builder.CreateRet(builder.getInt64(value));
+    return;
+}
+} // namespace
+
+// Compile latency per method specialization by optimization level and batch size, materialization included.
+// Every iteration compiles all specializations of a new session like the compile scheduler does upfront, parsing
+// and type inference aren't timed.
+static void BM_CompileSpecializations(benchmark::State &state)
+{
+    constexpr std::size_t Methods = 200;
+    hannac::benchmarks::HProgramFile file{"compile", hannac::benchmarks::make_program(Methods, Methods)};
+    std::uint64_t specializations = 0;
+    std::uint64_t modules = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        hannac::HSettings settings;
+        settings.set_opt_level(static_cast<int>(state.range(0)));
+        settings.set_batch_size(state.range(1));
+        auto session = std::make_unique<hannac::HSession>(settings);
+        hannac::HTokenParser parser{*session, hannac::HLexer{hannac::HFileParser{file.get_path()}}};
+        auto program = parser.parse();
+        hannac::HCompileScheduler scheduler{*session, program};
+        session->get_optimizer().set_call_frequencies(scheduler.get_call_frequencies());
+        state.ResumeTiming();
+
+        scheduler();
+
+        state.PauseTiming();
+        specializations += session->get_library().get_compiled_methods();
+        modules += session->get_library().get_compiled_modules();
+        program.clear();
+        session.reset();
+        state.ResumeTiming();
+    }
+    state.counters["specialization"] =
+        benchmark::Counter(specializations, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["modules"] = benchmark::Counter(modules, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_CompileSpecializations)
+    ->ArgNames({"opt", "batch"})
+    ->ArgsProduct({{0, 1, 2, 3}, {1}})
+    ->ArgsProduct({{0, 2}, {8, 64, 512}})
+    ->Unit(benchmark::kMillisecond);
+
+// Wall time compiling all specializations of a program upfront by number of compile threads, the speed-up of
+// parallel compilation. The methods don't call each other, every one can be compiled on its own thread.
+static void BM_CompileJobs(benchmark::State &state)
+{
+    constexpr std::size_t Methods = 400;
+    hannac::benchmarks::HProgramFile file{"jobs", hannac::benchmarks::make_program(Methods, Methods)};
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        hannac::HSettings settings;
+        settings.set_opt_level(2);
+        settings.set_jobs(static_cast<unsigned>(state.range(0)));
+        auto session = std::make_unique<hannac::HSession>(settings);
+        hannac::HTokenParser parser{*session, hannac::HLexer{hannac::HFileParser{file.get_path()}}};
+        auto program = parser.parse();
+        hannac::HCompileScheduler scheduler{*session, program};
+        state.ResumeTiming();
+
+        scheduler();
+
+        state.PauseTiming();
+        program.clear();
+        session.reset();
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_CompileJobs)
+    ->ArgName("jobs")
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Handing a module of one function to the JIT and opening the next one in a pooled context.
+// Generating the function isn't timed.
+static void BM_GenModuleAndReset(benchmark::State &state)
+{
+    hannac::HSession session;
+    std::uint64_t id = 0;
+    for (auto _ : state)
+    {
+        hannac::HCompilationContext ctx(session);
+        gen_constant(ctx, "__benchmark." + std::to_string(id++), 42);
+
+        auto start = std::chrono::steady_clock::now();
+        hannac::gen_module_and_reset(ctx);
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+BENCHMARK(BM_GenModuleAndReset)->UseManualTime();
+
+// Looking up a symbol already materialized.
+static void BM_FindSymbol(benchmark::State &state)
+{
+    hannac::HSession session;
+    {
+        hannac::HCompilationContext ctx(session);
+        gen_constant(ctx, "__benchmark", 42);
+        hannac::gen_module_and_reset(ctx);
+    }
+    session.get_library().find_symbol("__benchmark");
+
+    for (auto _ : state)
+    {
+        auto symbol = session.get_library().find_symbol("__benchmark");
+        benchmark::DoNotOptimize(symbol);
+    }
+}
+BENCHMARK(BM_FindSymbol);
@@ -0,0 +1,130 @@
+#include "AST.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "Kernels/Native.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "benchmark/benchmark.h"
+
+// llvm includes.
+#include "llvm/Support/Error.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Quality of the code generated for the kernels in data/kernels.hanna, compared to hand-written C++ compiled at -O2.
+// Every benchmark times the JIT specialization of a kernel and its native equivalent on the same inputs, both called
+// through a function pointer. The time reported is the JIT's, native_call gives the native time per call and ratio
+// the JIT's time over the native one.
+namespace
+{
+constexpr std::int64_t Calls = 1000;
+
+struct HKernel
+{
+    char const *mName;
+    std::int64_t (*mInt)(std::int64_t, std::int64_t);
+    double (*mReal)(double, double);
+};
+
+namespace native = hannac::benchmarks::native;
+std::vector<HKernel> const Kernels{
+    {"add", native::add, native::add},
+    {"multiply", native::multiply, native::multiply},
+    {"callAdd", native::callAdd, native::callAdd},
+    {"callcallAdd", native::callcallAdd, native::callcallAdd},
+    {"precedence", native::precedence, native::precedence},
+    {"divide", native::divide, native::divide},
+    {"sub", native::sub, native::sub},
+    {"callSub", native::callSub, native::callSub},
+    {"polynomial", native::polynomial, native::polynomial},
+    {"chain", native::chain, native::chain},
+};
+
+template <typename T> T run_kernel(T (*kernel)(T, T))
+{
+    benchmark::DoNotOptimize(kernel);
+    T sum = 0;
+    for (std::int64_t i = 1; i <= Calls; i++)
+        sum += kernel(static_cast<T>(i), static_cast<T>(3));
+    return sum;
+}
+
+// Seconds running kernel Calls times, the sum of its results is stored in sum.
+template <typename T> double time_kernel(T (*kernel)(T, T), T &sum)
+{
+    auto start = std::chrono::steady_clock::now();
+    sum = run_kernel(kernel);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// state.range(0) is the optimization level, state.range(1) enables fast math.
+template <typename T> void BM_Kernel(benchmark::State &state, char const *name, T (*nativeKernel)(T, T))
+{
+    hannac::HSettings settings;
+    settings.set_opt_level(static_cast<int>(state.range(0)));
+    settings.set_fast_math(state.range(1) != 0);
+    hannac::HSession session{settings};
+    std::filesystem::path path(__FILE__);
+    hannac::HTokenParser{session,
+                         hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/kernels.hanna"}}}
+        .parse_library();
+
+    // The body of the specialization, calling it doesn't go through its lazy stub.
+    auto type = std::is_same_v<T, double> ? hannac::ast::ASTType::RealNumber : hannac::ast::ASTType::Number;
+    hannac::ast::request_specialization(session, name, {type, type});
+    static llvm::ExitOnError err;
+    auto address = err(session.get_library().lookup_method(hannac::ast::produce_func_name(name, {type, type})));
+    auto jitKernel = address.template toPtr<T (*)(T, T)>();
+
+    // Warm up, callees are compiled on their first call.
+    T jitSum = run_kernel(jitKernel);
+    T nativeSum = run_kernel(nativeKernel);
+    if (std::is_integral_v<T> && jitSum != nativeSum)
+    {
+        state.SkipWithError("JIT and native results differ.");
+        return;
+    }
+
+    double nativeSeconds = 0.0;
+    double jitSeconds = 0.0;
+    for (auto _ : state)
+    {
+        auto seconds = time_kernel(jitKernel, jitSum);
+        state.SetIterationTime(seconds);
+        jitSeconds += seconds;
+        nativeSeconds += time_kernel(nativeKernel, nativeSum);
+    }
+    benchmark::DoNotOptimize(jitSum);
+    benchmark::DoNotOptimize(nativeSum);
+
+    auto calls = static_cast<double>(state.iterations()) * Calls;
+    state.counters["call"] = benchmark::Counter(Calls, benchmark::Counter::kIsIterationInvariantRate |
+                                                           benchmark::Counter::kInvert);
+    state.counters["native_call"] = calls > 0 ? nativeSeconds / calls : 0.0;
+    state.counters["ratio"] = nativeSeconds > 0.0 ? jitSeconds / nativeSeconds : 0.0;
+}
+
+[[maybe_unused]] bool const Registered = []() {
+    // Fast math only affects real arithmetic.
+    for (auto const &kernel : Kernels)
+    {
+        benchmark::RegisterBenchmark(("BM_Kernel/" + std::string(kernel.mName) + "/int").c_str(),
+                                     BM_Kernel<std::int64_t>, kernel.mName, kernel.mInt)
+            ->ArgNames({"opt", "fast_math"})
+            ->ArgsProduct({{0, 1, 2, 3}, {0}})
+            ->UseManualTime();
+        benchmark::RegisterBenchmark(("BM_Kernel/" + std::string(kernel.mName) + "/real").c_str(),
+                                     BM_Kernel<double>, kernel.mName, kernel.mReal)
+            ->ArgNames({"opt", "fast_math"})
+            ->ArgsProduct({{0, 1, 2, 3}, {0, 1}})
+            ->UseManualTime();
+    }
+    return true;
+}();
+} // namespace
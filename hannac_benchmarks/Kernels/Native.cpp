@@ -0,0 +1,104 @@
+#include "Kernels/Native.hpp"
+
+namespace hannac::benchmarks::native
+{
+std::int64_t add(std::int64_t x, std::int64_t y)
+{
+    return x + y;
+}
+
+double add(double x, double y)
+{
+    return x + y;
+}
+
+std::int64_t multiply(std::int64_t a, std::int64_t b)
+{
+    return a * b;
+}
+
+double multiply(double a, double b)
+{
+    return a * b;
+}
+
+std::int64_t callAdd(std::int64_t a, std::int64_t b)
+{
+    return add(a, b);
+}
+
+double callAdd(double a, double b)
+{
+    return add(a, b);
+}
+
+std::int64_t callcallAdd(std::int64_t a, std::int64_t b)
+{
+    return callAdd(a, b);
+}
+
+double callcallAdd(double a, double b)
+{
+    return callAdd(a, b);
+}
+
+std::int64_t precedence(std::int64_t a, std::int64_t b)
+{
+    return a + b * a + b;
+}
+
+double precedence(double a, double b)
+{
+    return a + b * a + b;
+}
+
+std::int64_t divide(std::int64_t a, std::int64_t b)
+{
+    return a / b;
+}
+
+double divide(double a, double b)
+{
+    return a / b;
+}
+
+std::int64_t sub(std::int64_t a, std::int64_t b)
+{
+    return a - b;
+}
+
+double sub(double a, double b)
+{
+    return a - b;
+}
+
+std::int64_t callSub(std::int64_t a, std::int64_t b)
+{
+    return sub(b, a);
+}
+
+double callSub(double a, double b)
+{
+    return sub(b, a);
+}
+
+std::int64_t polynomial(std::int64_t x, std::int64_t y)
+{
+    return x * x * x + 3 * x * y - y * y * 5 + 7 * x - 2 + y / 4;
+}
+
+double polynomial(double x, double y)
+{
+    return x * x * x + 3 * x * y - y * y * 5 + 7 * x - 2 + y / 4;
+}
+
+std::int64_t chain(std::int64_t x, std::int64_t y)
+{
+    return polynomial(x, y) - precedence(y, x) * 2 + multiply(x, y);
+}
+
+double chain(double x, double y)
+{
+    return polynomial(x, y) - precedence(y, x) * 2 + multiply(x, y);
+}
+} // namespace hannac::benchmarks::native
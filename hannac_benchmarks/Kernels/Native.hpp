@@ -0,0 +1,32 @@
+#ifndef NATIVE_HPP
+#define NATIVE_HPP
+
+// stdlib includes.
+#include <cstdint>
+
+// Hand-written equivalents of the kernels in data/kernels.hanna. They are compiled at -O2 in their own translation
+// unit, so like the JIT code they can't be inlined into the benchmark loop.
+namespace hannac::benchmarks::native
+{
+std::int64_t add(std::int64_t x, std::int64_t y);
+double add(double x, double y);
+std::int64_t multiply(std::int64_t a, std::int64_t b);
+double multiply(double a, double b);
+std::int64_t callAdd(std::int64_t a, std::int64_t b);
+double callAdd(double a, double b);
+std::int64_t callcallAdd(std::int64_t a, std::int64_t b);
+double callcallAdd(double a, double b);
+std::int64_t precedence(std::int64_t a, std::int64_t b);
+double precedence(double a, double b);
+std::int64_t divide(std::int64_t a, std::int64_t b);
+double divide(double a, double b);
+std::int64_t sub(std::int64_t a, std::int64_t b);
+double sub(double a, double b);
+std::int64_t callSub(std::int64_t a, std::int64_t b);
+double callSub(double a, double b);
+std::int64_t polynomial(std::int64_t x, std::int64_t y);
+double polynomial(double x, double y);
+std::int64_t chain(std::int64_t x, std::int64_t y);
+double chain(double x, double y);
+} // namespace hannac::benchmarks::native
+#endif // NATIVE_HPP
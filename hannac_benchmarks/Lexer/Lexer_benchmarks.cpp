@@ -0,0 +1,23 @@
+#include "FileParser.hpp"
+#include "Lexer.hpp"
+#include "Programs.hpp"
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstdint>
+
+// Tokens lexed per second from a program of state.range(0) methods.
+static void BM_LexerGetToken(benchmark::State &state)
+{
+    hannac::benchmarks::HProgramFile file{"lex", hannac::benchmarks::make_program(state.range(0), state.range(0))};
+    std::uint64_t tokens = 0;
+    for (auto _ : state)
+    {
+        hannac::HLexer lexer{hannac::HFileParser{file.get_path()}};
+        while (lexer.get_token().first != hannac::HTokenType::END)
+            ;
+        tokens += lexer.get_token_count();
+    }
+    state.counters["tokens"] = benchmark::Counter(tokens, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_LexerGetToken)->Arg(100)->Arg(10000);
@@ -0,0 +1,71 @@
+#ifndef PROGRAMS_HPP
+#define PROGRAMS_HPP
+
+// stdlib includes.
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace hannac::benchmarks
+{
+// Source file of a generated hanna program, removed again when destroyed.
+class HProgramFile final
+{
+  public:
+    HProgramFile(std::string const &name, std::string const &source)
+        : mPath(std::filesystem::temp_directory_path() / ("hannac_benchmark_" + name + ".hanna"))
+    {
+        std::ofstream file(mPath, std::ios::binary);
+        file << source;
+    }
+
+    HProgramFile(const HProgramFile &) = delete;
+    HProgramFile &operator=(const HProgramFile &) = delete;
+
+    ~HProgramFile()
+    {
+        std::error_code error;
+        std::filesystem::remove(mPath, error);
+    }
+
+    std::filesystem::path const &get_path() const noexcept
+    {
+        return mPath;
+    }
+
+  private:
+    std::filesystem::path mPath;
+};
+
+// Methods m0 to m<methods - 1>, each of two parameters and independent of the others, so every method called once
+// compiles to exactly one specialization.
+inline std::string make_methods(std::size_t methods)
+{
+    std::string source;
+    for (std::size_t i = 0; i < methods; i++)
+    {
+        auto id = std::to_string(i);
+        source += "# Method " + id + "\n";
+        source += "method m" + id + "(a, b)\n";
+        source += "    return a * b + a - b * " + std::to_string(i + 1) + " + b / 3\n\n";
+    }
+    return source;
+}
+
+// Main calling the methods in turn, statements times.
+inline std::string make_main(std::size_t methods, std::size_t statements)
+{
+    std::string source = "main\n";
+    for (std::size_t i = 0; i < statements; i++)
+        source +=
+            "    m" + std::to_string(i % methods) + "(" + std::to_string(i) + ", " + std::to_string(i + 1) + ")\n";
+    return source;
+}
+
+inline std::string make_program(std::size_t methods, std::size_t statements)
+{
+    return make_methods(methods) + make_main(methods, statements);
+}
+} // namespace hannac::benchmarks
+#endif // PROGRAMS_HPP
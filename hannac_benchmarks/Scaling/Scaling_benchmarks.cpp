@@ -0,0 +1,158 @@
+#include "Allocations.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Generator.hpp"
+#include "Lexer.hpp"
+#include "Programs.hpp"
+#include "Scheduler.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "Trace.hpp"
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Every stage on generated programs of state.range(0) methods and as many statements, to plot time and memory
+// against the size of the input. The counters give the size of the source, heap sizes are counted in builds
+// configured with HANNAC_TRACK_ALLOCATIONS.
+namespace
+{
+std::string generate(benchmark::State const &state)
+{
+    hannac::HGeneratorOptions options;
+    options.mMethods = state.range(0);
+    options.mStatements = state.range(0);
+    return hannac::HProgramGenerator{options}.generate();
+}
+
+// Heap allocated and still allocated so far, over all phases.
+struct HHeap
+{
+    std::uint64_t mBytes = 0;
+    std::uint64_t mLiveBytes = 0;
+};
+
+HHeap get_heap()
+{
+    HHeap heap;
+    for (std::size_t slot = 0; slot < hannac::HAllocationTracker::Slots; slot++)
+    {
+        auto stats = hannac::HAllocationTracker::get_stats(static_cast<hannac::HPhase>(slot));
+        heap.mBytes += stats.mBytes;
+        heap.mLiveBytes += stats.mLiveBytes;
+    }
+    return heap;
+}
+
+void set_counters(benchmark::State &state, std::string const &source, HHeap const &allocated, HHeap const &retained)
+{
+    state.counters["source_bytes"] = static_cast<double>(source.size());
+    state.counters["methods"] = static_cast<double>(state.range(0));
+    if (!hannac::HAllocationTracker::enabled())
+        return;
+    // Bytes allocated per run, and bytes still held once the stage is done.
+    state.counters["heap_bytes"] = benchmark::Counter(allocated.mBytes, benchmark::Counter::kAvgIterations);
+    state.counters["retained_bytes"] = benchmark::Counter(retained.mLiveBytes, benchmark::Counter::kAvgIterations);
+}
+
+// Runs stage on a parsed program every iteration, only stage is timed.
+template <typename Stage> void run_stage(benchmark::State &state, char const *name, Stage stage)
+{
+    auto source = generate(state);
+    hannac::benchmarks::HProgramFile file{name, source};
+    HHeap allocated;
+    HHeap retained;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto session = std::make_unique<hannac::HSession>();
+        hannac::HTokenParser parser{*session, hannac::HLexer{hannac::HFileParser{file.get_path()}}};
+        auto program = parser.parse();
+        auto start = get_heap();
+        state.ResumeTiming();
+
+        stage(*session, program);
+
+        state.PauseTiming();
+        auto end = get_heap();
+        allocated.mBytes += end.mBytes - start.mBytes;
+        retained.mLiveBytes += end.mLiveBytes - start.mLiveBytes;
+        program.clear();
+        session.reset();
+        state.ResumeTiming();
+    }
+    set_counters(state, source, allocated, retained);
+}
+} // namespace
+
+static void BM_ScalingLex(benchmark::State &state)
+{
+    auto source = generate(state);
+    hannac::benchmarks::HProgramFile file{"scaling_lex", source};
+    HHeap allocated;
+    for (auto _ : state)
+    {
+        auto start = get_heap();
+        hannac::HLexer lexer{hannac::HFileParser{file.get_path()}};
+        while (lexer.get_token().first != hannac::HTokenType::END)
+            ;
+        allocated.mBytes += get_heap().mBytes - start.mBytes;
+    }
+    set_counters(state, source, allocated, {});
+}
+BENCHMARK(BM_ScalingLex)->RangeMultiplier(4)->Range(64, 65536)->Unit(benchmark::kMillisecond);
+
+// Lexing and parsing into a new session, setting up the session isn't timed.
+static void BM_ScalingParse(benchmark::State &state)
+{
+    auto source = generate(state);
+    hannac::benchmarks::HProgramFile file{"scaling_parse", source};
+    HHeap allocated;
+    HHeap retained;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto session = std::make_unique<hannac::HSession>();
+        hannac::HTokenParser parser{*session, hannac::HLexer{hannac::HFileParser{file.get_path()}}};
+        auto start = get_heap();
+        state.ResumeTiming();
+
+        auto program = parser.parse();
+
+        state.PauseTiming();
+        auto end = get_heap();
+        allocated.mBytes += end.mBytes - start.mBytes;
+        retained.mLiveBytes += end.mLiveBytes - start.mLiveBytes;
+        program.clear();
+        session.reset();
+        state.ResumeTiming();
+    }
+    set_counters(state, source, allocated, retained);
+}
+BENCHMARK(BM_ScalingParse)->RangeMultiplier(4)->Range(64, 65536)->Unit(benchmark::kMillisecond);
+
+// Type inference and compiling every reachable specialization upfront.
+static void BM_ScalingCompile(benchmark::State &state)
+{
+    run_stage(state, "scaling_compile", [](hannac::HSession &session, auto const &program) {
+        hannac::HCompileScheduler scheduler{session, program};
+        session.get_optimizer().set_call_frequencies(scheduler.get_call_frequencies());
+        scheduler();
+    });
+}
+BENCHMARK(BM_ScalingCompile)->RangeMultiplier(4)->Range(64, 4096)->Unit(benchmark::kMillisecond);
+
+// Running all statements, methods are compiled lazily on their first call.
+static void BM_ScalingExecute(benchmark::State &state)
+{
+    run_stage(state, "scaling_execute", [](hannac::HSession &session, auto &program) {
+        hannac::HExecutor executor{session, std::move(program)};
+        benchmark::DoNotOptimize(executor());
+    });
+}
+BENCHMARK(BM_ScalingExecute)->RangeMultiplier(4)->Range(64, 4096)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,38 @@
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "Lexer.hpp"
+#include "Programs.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstdint>
+#include <memory>
+
+// AST nodes parsed per second from a program of state.range(0) methods, lexing included.
+// Methods can't be redefined, every iteration parses into a new session. Setting it up isn't timed.
+static void BM_TokenParserParse(benchmark::State &state)
+{
+    hannac::benchmarks::HProgramFile file{"parse", hannac::benchmarks::make_program(state.range(0), state.range(0))};
+    std::uint64_t nodes = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto session = std::make_unique<hannac::HSession>();
+        hannac::HTokenParser parser{*session, hannac::HLexer{hannac::HFileParser{file.get_path()}}};
+        state.ResumeTiming();
+
+        auto program = parser.parse();
+        benchmark::DoNotOptimize(program.data());
+
+        state.PauseTiming();
+        for (auto const &[kind, count] : session->get_jit().get_run_stats().get_nodes())
+            nodes += count;
+        program.clear();
+        session.reset();
+        state.ResumeTiming();
+    }
+    state.counters["nodes"] = benchmark::Counter(nodes, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TokenParserParse)->Arg(100)->Arg(10000);
@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+# Compares end-to-end time of JIT execution and an ahead of time compiled executable.
+# Usage: jit_vs_aot.sh <HANNAC_COMPILER> [HANNA_FILE] [RUNS]
+set -euo pipefail
+
+compiler=${1:?"Path to hannac_compiler required."}
+program=${2:-"$(dirname "$0")/../examples/test.hanna"}
+runs=${3:-100}
+
+workdir=$(mktemp -d)
+trap 'rm -rf "${workdir}"' EXIT
+executable="${workdir}/aot"
+
+# Time in nanoseconds for running a command ${runs} times.
+time_runs()
+{
+    local start end
+    start=$(date +%s%N)
+    for ((i = 0; i < runs; i++)); do
+        "$@" > /dev/null
+    done
+    end=$(date +%s%N)
+    echo $((end - start))
+}
+
+compileStart=$(date +%s%N)
+"${compiler}" "${program}" --emit=exe -o "${executable}" > /dev/null
+compileEnd=$(date +%s%N)
+
+jit=$(time_runs "${compiler}" "${program}")
+aot=$(time_runs "${executable}")
+
+echo "Program:      ${program}"
+echo "Runs:         ${runs}"
+echo "AOT compile:  $(((compileEnd - compileStart) / 1000)) us"
+echo "JIT per run:  $((jit / runs / 1000)) us"
+echo "AOT per run:  $((aot / runs / 1000)) us"
@@ -0,0 +1,33 @@
+#include "benchmark/benchmark.h"
+
+// stdlib includes
+#include <cstring>
+#include <vector>
+
+// Runs the benchmarks selected by the usual Google Benchmark flags. Unless --benchmark_out is given, results are
+// also written as JSON to hannac_benchmarks.json, which tools/compare.py of Google Benchmark diffs against an
+// earlier run.
+int main(int argc, char **argv)
+{
+    static char out[] = "--benchmark_out=hannac_benchmarks.json";
+    static char format[] = "--benchmark_out_format=json";
+
+    std::vector<char *> args(argv, argv + argc);
+    bool hasOut = false;
+    for (int i = 1; i < argc; i++)
+        hasOut = hasOut || std::strncmp(argv[i], "--benchmark_out=", std::strlen("--benchmark_out=")) == 0;
+    if (!hasOut)
+    {
+        args.push_back(out);
+        args.push_back(format);
+    }
+
+    auto count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
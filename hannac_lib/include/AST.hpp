@@ -2,20 +2,32 @@
 #define AST_HPP
 
 // stdlib includes
+#include <atomic>
 #include <cstdint>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
 #include <vector>
 
-// hanna includes.
-#include "Codegen.hpp"
-#include "GlobalSettings.hpp"
-
 // llvm includes
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ExecutionEngine/Orc/Shared/ExecutorAddress.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Value.h"
 #include "llvm/IR/Verifier.h"
 
 namespace hannac
 {
+// Forward declarations.
+class HSession;
+class HCompilationContext;
+
 namespace ast
 {
 // Types of AST nodes available in hanna.
@@ -47,7 +59,7 @@ static std::string ast_to_string(ASTType type)
     }
 }
 
-inline std::string produce_func_name(std::string &name, std::vector<ASTType> argTypes)
+inline std::string produce_func_name(std::string const &name, std::vector<ASTType> const &argTypes)
 {
     std::string funcName{name};
     for (auto const &el : argTypes)
@@ -57,48 +69,108 @@ inline std::string produce_func_name(std::string &name, std::vector<ASTType> arg
     return funcName;
 }
 
+// Name of a method specialization as shown in debuggers and profilers, e.g. "scale(int, double)".
+inline std::string produce_display_name(std::string const &name, std::vector<ASTType> const &argTypes)
+{
+    std::string displayName{name + "("};
+    for (std::size_t i = 0; i < argTypes.size(); i++)
+        displayName += (i > 0 ? ", " : "") + ast_to_string(argTypes[i]);
+    return displayName + ")";
+}
+
 // Function AST buffer.
 // Code for functions is generated lazily, i.e. only when they are actually called.
-// From definition of the function to its first use, store the AST Node in this buffer.
+// Calls are routed through lazy JIT stubs, the first call of a stub generates the code of the called specialization
+// from the AST Node stored in this buffer.
 // The argument and return type of the function is determined by the arguments it is called with.
 // Much like template functions in C++. Therefore storing only the name as key suffices.
+// Filled by the parser, read-only during code generation.
 struct MethodDefinition; // Forward declaration
-class HMethodBuffer final
-{
-  public:
-    static std::map<std::string, std::shared_ptr<MethodDefinition>> &get()
-    {
-        static HMethodBuffer buffer;
-        return buffer.funcMap;
-    }
-
-    HMethodBuffer(const HMethodBuffer &) = delete;
-    HMethodBuffer &operator=(const HMethodBuffer &) = delete;
-
-    std::map<std::string, std::shared_ptr<MethodDefinition>> funcMap;
-
-  private:
-    HMethodBuffer() {};
-};
+using HMethodBuffer = std::map<std::string, std::shared_ptr<MethodDefinition>>;
 
 // Since we are putting code for each function in a separate module, we need a way for subsequent calls to functions to
-// gather the function declaration. This is done by storing the function declarations produced so far here.
+// gather the function declaration. This is done by storing the function declarations and their inferred return types
+// produced so far here.
 struct MethodDeclaration; // Forward declaration
 class HMethodDeclarations final
 {
   public:
-    static std::map<std::string, std::pair<std::shared_ptr<hannac::ast::MethodDeclaration>, ASTType>> &get()
-    {
-        static HMethodDeclarations funcMap;
-        return funcMap.mFunctions;
-    }
-
+    HMethodDeclarations() = default;
     HMethodDeclarations(const HMethodDeclarations &) = delete;
     HMethodDeclarations &operator=(const HMethodDeclarations &) = delete;
+
     std::map<std::string, std::pair<std::shared_ptr<hannac::ast::MethodDeclaration>, ASTType>> mFunctions;
+    // Specializations are compiled concurrently, guard every access to the map with this mutex.
+    std::mutex mMutex;
+};
 
-  private:
-    HMethodDeclarations() = default;
+// List of method specializations: Method name and argument types.
+using HSpecializationList = std::vector<std::pair<std::string, std::vector<ASTType>>>;
+
+// Specializations requested by calls during ahead of time compilation whose code has not been generated yet.
+// In JIT mode lazy stubs take care of this.
+class HPendingSpecializations final
+{
+  public:
+    HPendingSpecializations() = default;
+    HPendingSpecializations(const HPendingSpecializations &) = delete;
+    HPendingSpecializations &operator=(const HPendingSpecializations &) = delete;
+
+    HSpecializationList mQueue;
+    std::set<std::string> mRequested;
+};
+
+// Argument of a call site known at compile time.
+struct HConstantArgument
+{
+    // Position in the argument list.
+    std::size_t mIndex = 0;
+    ASTType mType = ASTType::Number;
+    std::int64_t mInt = 0;
+    double mReal = 0.0;
+};
+using HConstantArguments = std::vector<HConstantArgument>;
+
+// Calls of method specializations with constant arguments, keyed by the name of the clone the constants would be baked
+// into. Calls are predicted from the call graph, so a call site in a hot method counts as many calls. Every call site
+// counts once, however often its caller is generated again, e.g. after eviction or on tier-up.
+// Once the calls reach the clone threshold the call sites call the clone instead, until the clone cap is reached.
+class HValueProfile final
+{
+  public:
+    // Call site: library and function of the caller and the call in its AST.
+    using HCallSite = std::tuple<std::string, std::string, void const *>;
+
+    HValueProfile() = default;
+    HValueProfile(const HValueProfile &) = delete;
+    HValueProfile &operator=(const HValueProfile &) = delete;
+
+    std::map<std::string, std::uint64_t> mCalls;
+    std::map<std::string, std::set<HCallSite>> mCallSites;
+    std::set<std::string> mClones;
+    // Call sites are generated concurrently, guard every access with this mutex.
+    std::mutex mMutex;
+};
+
+// Guards against generating a specialization for every argument type tuple a method is called with.
+// Once a method has the maximum number of specializations, calls with further argument types run its generic version
+// on boxed values instead. A boxed value is a pair of 64 bit integers, the type tag (0 int, 1 double, like HResultType)
+// and the payload (the bits of the int or double, like res).
+class HSpecializationGuard final
+{
+  public:
+    HSpecializationGuard() = default;
+    HSpecializationGuard(const HSpecializationGuard &) = delete;
+    HSpecializationGuard &operator=(const HSpecializationGuard &) = delete;
+
+    // Specializations by method name.
+    std::map<std::string, std::set<std::string>> mSpecializations;
+    // Argument type tuples dispatched to the generic version, by method name.
+    std::map<std::string, std::set<std::string>> mFallbacks;
+    // Calls of the generic version, counted by the generated code, by method name.
+    std::map<std::string, std::unique_ptr<std::atomic<std::uint64_t>>> mCalls;
+    // Call sites are generated concurrently, guard every access with this mutex.
+    std::mutex mMutex;
 };
 
 /******************************************************************************
@@ -119,8 +191,24 @@ struct Expression
 
     virtual std::string get_name() const noexcept = 0;
 
+    // Unique string representation of the AST below this node. Used for hashing.
+    virtual std::string get_ast_string() const = 0;
+
     // Codegen.
-    virtual llvm::Value *codegen() = 0;
+    virtual llvm::Value *codegen(HCompilationContext &ctx) = 0;
+
+    // Codegen of the generic version of a method, all values are boxed.
+    virtual llvm::Value *codegen_boxed(HCompilationContext &ctx);
+
+    // Infer the type this expression evaluates to given the types of the variables in scope.
+    // Returns ASTType::Variable if the type can't be determined.
+    virtual ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const = 0;
+
+    // Collect the method specializations called by this expression given the types of the variables in scope.
+    virtual void collect_calls(HSession &session, std::map<std::string, ASTType> const &variables,
+                               HSpecializationList &calls) const
+    {
+    }
 
     ASTType get_type() const noexcept
     {
@@ -156,10 +244,16 @@ struct Number final : public Expression
     ~Number() = default;
 
     // Codegen.
-    virtual llvm::Value *codegen() final;
+    virtual llvm::Value *codegen(HCompilationContext &ctx) final;
+
+    virtual llvm::Value *codegen_boxed(HCompilationContext &ctx) override;
 
     virtual std::string get_name() const noexcept override;
 
+    virtual std::string get_ast_string() const override;
+
+    virtual ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
   private:
     std::int64_t mNum;
 };
@@ -175,10 +269,16 @@ struct RealNumber final : public Expression
     ~RealNumber() = default;
 
     // Codegen.
-    virtual llvm::Value *codegen() final;
+    virtual llvm::Value *codegen(HCompilationContext &ctx) final;
+
+    virtual llvm::Value *codegen_boxed(HCompilationContext &ctx) override;
 
     virtual std::string get_name() const noexcept override;
 
+    virtual std::string get_ast_string() const override;
+
+    virtual ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
   private:
     double mNum;
 };
@@ -195,10 +295,16 @@ struct Variable final : public Expression
     ~Variable() = default;
 
     // Codegen.
-    virtual llvm::Value *codegen() final;
+    virtual llvm::Value *codegen(HCompilationContext &ctx) final;
+
+    virtual llvm::Value *codegen_boxed(HCompilationContext &ctx) override;
 
     virtual std::string get_name() const noexcept override;
 
+    virtual std::string get_ast_string() const override;
+
+    virtual ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
   private:
     std::string mName;
 };
@@ -218,10 +324,19 @@ struct Binary final : public Expression
     ~Binary() = default;
 
     // Codegen.
-    virtual llvm::Value *codegen() final;
+    virtual llvm::Value *codegen(HCompilationContext &ctx) final;
+
+    virtual llvm::Value *codegen_boxed(HCompilationContext &ctx) override;
 
     virtual std::string get_name() const noexcept override;
 
+    virtual std::string get_ast_string() const override;
+
+    virtual ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
+    virtual void collect_calls(HSession &session, std::map<std::string, ASTType> const &variables,
+                               HSpecializationList &calls) const override;
+
     virtual ASTType get_return_type() const noexcept override;
 
     virtual std::string get_call() const override;
@@ -248,10 +363,14 @@ struct MethodDeclaration final : public Expression
     ~MethodDeclaration() = default;
 
     // Codegen.
-    virtual llvm::Function *codegen() final;
+    virtual llvm::Function *codegen(HCompilationContext &ctx) final;
 
     std::string get_name() const noexcept override;
 
+    std::string get_ast_string() const override;
+
+    ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
     void set_arg_types(std::vector<ASTType> argTypes) noexcept;
 
     void set_return_type(ASTType rType) noexcept;
@@ -280,16 +399,21 @@ struct MethodCall final : public Expression
     ~MethodCall() = default;
 
     // Codegen.
-    virtual llvm::Value *codegen() final;
+    virtual llvm::Value *codegen(HCompilationContext &ctx) final;
+
+    virtual llvm::Value *codegen_boxed(HCompilationContext &ctx) override;
 
     std::string get_name() const noexcept override;
-    // In order to produce code for the correct data types, we need to be able to query the types of the input arguments
-    // of a function call.
-    std::vector<ASTType> get_argtypes();
 
-    void set_arg_types(std::vector<ASTType> &args);
+    std::string get_ast_string() const override;
 
-    std::vector<std::string> getArgNames();
+    ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
+    void collect_calls(HSession &session, std::map<std::string, ASTType> const &variables,
+                       HSpecializationList &calls) const override;
+
+    // Types of the arguments of the last generated call.
+    std::vector<ASTType> get_argtypes();
 
     virtual ASTType get_return_type() const noexcept override;
 
@@ -315,8 +439,32 @@ struct MethodDefinition final : public Expression
 
     std::string get_name() const noexcept override;
 
+    std::string get_ast_string() const override;
+
     // Codegen.
-    virtual llvm::Function *codegen() final;
+    // Generates the specialization for the argument types set via set_arg_types.
+    virtual llvm::Function *codegen(HCompilationContext &ctx) final;
+
+    // Generates the specialization for the given argument types.
+    // Safe to call concurrently, specializations of the same method are generated one after another.
+    llvm::Function *codegen_specialization(HCompilationContext &ctx, std::vector<ASTType> const &argTypes);
+
+    // Generates the clone of a specialization with constant arguments baked in.
+    // The clone only takes the remaining arguments.
+    llvm::Function *codegen_clone(HCompilationContext &ctx, std::vector<ASTType> const &argTypes,
+                                  HConstantArguments const &constants);
+
+    // Generates the generic version taking and returning boxed values, see HSpecializationGuard.
+    llvm::Function *codegen_generic(HCompilationContext &ctx);
+
+    // Collect the specializations called by the specialization for the given argument types.
+    void collect_specialization_calls(HSession &session, std::vector<ASTType> const &argTypes,
+                                      HSpecializationList &calls) const;
+
+    ASTType infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const override;
+
+    // Infer the return type of this method when called with the given argument types.
+    ASTType infer_return_type(HSession &session, std::vector<ASTType> const &argTypes) const;
 
     void set_arg_types(std::vector<ASTType> argTypes) noexcept;
 
@@ -326,32 +474,85 @@ struct MethodDefinition final : public Expression
 
     void set_return_type(ASTType type) noexcept;
 
+    // Source file and lines of the declaration and the body, debug info maps the generated code to them.
+    void set_source(std::string const &file, unsigned line, unsigned bodyLine);
+
   private:
-    void gen_buffered_func();
+    // Generates the specialization for the argument types set via set_arg_types, instrumented if profile is set and
+    // profiling is enabled. Code run once, like main statements, isn't instrumented.
+    llvm::Function *gen_specialization(HCompilationContext &ctx, bool profile);
+
+    // Generate the body into the empty function func. Arguments with a constant are replaced by it.
+    llvm::Function *gen_body(HCompilationContext &ctx, llvm::Function *func, std::string const &funcName,
+                             HConstantArguments const &constants, bool profile);
+
+    // Describe func, generated from this method, in the debug info of its module if enabled.
+    // Returns the location of the body, code generated while it is set belongs to the body.
+    llvm::DebugLoc gen_debug_info(HCompilationContext &ctx, llvm::Function *func, std::string const &displayName);
 
     std::shared_ptr<MethodDeclaration> mDeclaration;
     std::unique_ptr<Expression> mFuncBody;
     std::vector<ASTType> mArgTypes;
     ASTType mReturnType;
+    std::string mSourceFile;
+    unsigned mLine = 0;
+    unsigned mBodyLine = 0;
+    // Codegen stores state in the AST.
+    std::mutex mMutex;
 };
 
-inline llvm::Function *gen_func_decl(std::string &name, std::vector<ASTType> argTypes, ASTType returnType)
+// Get the prototype of a method specialization in the current module, declaring it if necessary.
+llvm::Function *gen_func_decl(HCompilationContext &ctx, std::string const &name, std::vector<ASTType> const &argTypes,
+                              ASTType returnType);
+
+// Get the prototype of function funcName in the current module, declaring it if necessary.
+llvm::Function *gen_func_proto(HCompilationContext &ctx, std::string const &funcName,
+                               std::vector<ASTType> const &argTypes, ASTType returnType);
+
+// Name of the generic version of a method.
+inline std::string produce_generic_name(std::string const &name)
 {
+    return name + "_generic";
+}
 
-    auto func = HModuleSingelton::get_module().mModule->getFunction(produce_func_name(name, argTypes));
-    if (func != nullptr)
-        return func;
+// Get the prototype of the generic version of a method in the current module, declaring it if necessary.
+llvm::Function *gen_generic_decl(HCompilationContext &ctx, std::string const &name, std::size_t arguments);
 
-    auto proto = HMethodDeclarations::get().find(produce_func_name(name, argTypes));
-    if (proto != HMethodDeclarations::get().end())
-    {
-        std::get<0>(proto->second)->set_arg_types(argTypes);
-        std::get<0>(proto->second)->set_return_type(returnType);
-        return std::get<0>(proto->second)->codegen();
-    }
+// Whether a call of method name with the given argument types calls a specialization or the generic version.
+// Counts the specialization against the specialization cap of the method.
+bool allow_specialization(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes);
 
-    return nullptr;
-}
+// Name of the clone of a method specialization with the given constant arguments.
+std::string produce_clone_name(std::string const &name, std::vector<ASTType> const &argTypes,
+                               HConstantArguments const &constants);
+
+// Infer the return type of a call to method name with the given argument types.
+ASTType infer_method_return_type(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes);
+
+// Make sure code for a called method specialization will exist.
+// In JIT mode a lazy stub is registered which generates the code on its first call.
+// Ahead of time the specialization is queued for gen_pending_specializations.
+void request_specialization(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes);
+
+// Make sure code for the generic version of a method will exist. JIT mode only.
+void request_generic(HSession &session, std::string const &name);
+
+// Make sure code for a clone of a method specialization with constant arguments will exist. JIT mode only.
+void request_clone(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes,
+                   HConstantArguments const &constants);
+
+// Generate all queued specializations into the current module.
+void gen_pending_specializations(HCompilationContext &ctx);
+
+// Run body on a new compilation context of session and hand over the module generated.
+llvm::Expected<llvm::orc::ThreadSafeModule> gen_module(HSession &session,
+                                                       llvm::function_ref<llvm::Error(HCompilationContext &)> body);
+
+// Get the address of the compiled code of a method specialization, compiling it if necessary.
+// Safe to call from any thread, every specialization is compiled exactly once. Failures aren't remembered, the
+// specialization is compiled again on its next request.
+llvm::Expected<llvm::orc::ExecutorAddr> compile_specialization(HSession &session, std::string const &name,
+                                                               std::vector<ASTType> const &argTypes);
 
 } // namespace ast
 } // namespace hannac
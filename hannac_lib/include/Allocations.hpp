@@ -0,0 +1,245 @@
+#ifndef ALLOCATIONS_HPP
+#define ALLOCATIONS_HPP
+
+// stdlib includes.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// system includes.
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+// hannac includes.
+#include "Trace.hpp"
+
+namespace hannac
+{
+// Heap allocations made while a phase ran, see HAllocationTracker.
+struct HAllocationStats
+{
+    std::uint64_t mAllocations = 0;
+    std::uint64_t mBytes = 0;
+    std::uint64_t mFrees = 0;
+    // Bytes allocated in the phase and not freed yet, wherever they are freed.
+    std::uint64_t mLiveBytes = 0;
+    std::uint64_t mPeakLiveBytes = 0;
+};
+
+// Code calling operator new.
+struct HAllocationSite
+{
+    std::uintptr_t mAddress = 0;
+    std::uint64_t mAllocations = 0;
+    std::uint64_t mBytes = 0;
+};
+
+// Counts heap allocations by the phase running on the allocating thread, see HPhaseScope::get_current_phase.
+// Only builds configured with HANNAC_TRACK_ALLOCATIONS replace operator new and delete to feed it, every count stays
+// 0 otherwise. The replacements put a header in front of every allocation, so frees are accounted to the phase the
+// memory was allocated in.
+// Everything called from the replaced operators must not allocate itself.
+class HAllocationTracker final
+{
+  public:
+    // A slot per phase and one for allocations outside of any phase.
+    static constexpr std::size_t Slots = static_cast<std::size_t>(HPhase::Count) + 1;
+    // Keeps the alignment of malloc.
+    static constexpr std::size_t HeaderSize = 16;
+
+    static constexpr bool enabled() noexcept
+    {
+#ifdef HANNAC_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Allocate size bytes for code at site. Returns nullptr if out of memory.
+    static void *allocate(std::size_t size, void const *site) noexcept
+    {
+        auto header = static_cast<Header *>(std::malloc(size + HeaderSize));
+        if (header == nullptr)
+            return nullptr;
+
+        auto phase = static_cast<std::size_t>(HPhaseScope::get_current_phase());
+        header->mSize = size;
+        header->mPhase = static_cast<std::uint8_t>(phase);
+
+        auto &counters = sCounters[phase];
+        counters.mAllocations.fetch_add(1, std::memory_order_relaxed);
+        counters.mBytes.fetch_add(size, std::memory_order_relaxed);
+        auto live = counters.mLiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        auto peak = counters.mPeakLiveBytes.load(std::memory_order_relaxed);
+        while (live > peak && !counters.mPeakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            ;
+
+        if (auto entry = find_site(reinterpret_cast<std::uintptr_t>(site), phase))
+        {
+            entry->mAllocations.fetch_add(1, std::memory_order_relaxed);
+            entry->mBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+        return reinterpret_cast<char *>(header) + HeaderSize;
+    }
+
+    // Free memory returned by allocate.
+    static void deallocate(void *ptr) noexcept
+    {
+        if (ptr == nullptr)
+            return;
+
+        auto header = reinterpret_cast<Header *>(static_cast<char *>(ptr) - HeaderSize);
+        auto &counters = sCounters[header->mPhase];
+        counters.mFrees.fetch_add(1, std::memory_order_relaxed);
+        counters.mLiveBytes.fetch_sub(header->mSize, std::memory_order_relaxed);
+        std::free(header);
+        return;
+    }
+
+    // Allocations made in phase, HPhase::Count for those outside of any phase.
+    static HAllocationStats get_stats(HPhase phase) noexcept
+    {
+        auto const &counters = sCounters[static_cast<std::size_t>(phase)];
+        HAllocationStats stats;
+        stats.mAllocations = counters.mAllocations.load(std::memory_order_relaxed);
+        stats.mBytes = counters.mBytes.load(std::memory_order_relaxed);
+        stats.mFrees = counters.mFrees.load(std::memory_order_relaxed);
+        stats.mLiveBytes = counters.mLiveBytes.load(std::memory_order_relaxed);
+        stats.mPeakLiveBytes = counters.mPeakLiveBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    // The count sites of phase allocating the most bytes.
+    static std::vector<HAllocationSite> get_top_sites(HPhase phase, std::size_t count)
+    {
+        std::vector<HAllocationSite> sites;
+        for (auto const &entry : sSites)
+        {
+            auto key = entry.mKey.load(std::memory_order_relaxed);
+            if (key == 0 || key % Slots != static_cast<std::size_t>(phase))
+                continue;
+            sites.push_back({key / Slots, entry.mAllocations.load(std::memory_order_relaxed),
+                             entry.mBytes.load(std::memory_order_relaxed)});
+        }
+
+        std::sort(sites.begin(), sites.end(),
+                  [](HAllocationSite const &a, HAllocationSite const &b) { return a.mBytes > b.mBytes; });
+        sites.resize(std::min(sites.size(), count));
+        return sites;
+    }
+
+    // Name of the function containing address, or its module and offset if the function isn't exported.
+    static std::string get_site_name(std::uintptr_t address)
+    {
+        Dl_info info{};
+        if (dladdr(reinterpret_cast<void *>(address), &info) == 0)
+            return to_hex(address);
+
+        if (info.dli_sname == nullptr)
+            return std::string(info.dli_fname != nullptr ? info.dli_fname : "?") + "+" +
+                   to_hex(address - reinterpret_cast<std::uintptr_t>(info.dli_fbase));
+
+        int status = 0;
+        auto demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+        std::free(demangled);
+        return name + "+" + to_hex(address - reinterpret_cast<std::uintptr_t>(info.dli_saddr));
+    }
+
+    static char const *get_phase_name(std::size_t slot) noexcept
+    {
+        return slot < static_cast<std::size_t>(HPhase::Count) ? to_string(static_cast<HPhase>(slot)) : "Other";
+    }
+
+    // Print the allocations of every phase and its top sites.
+    static void print(std::ostream &out, std::size_t sites = 5)
+    {
+        out << "Allocations:" << std::endl;
+        out << "\t" << std::left << std::setw(16) << "Phase" << std::right << std::setw(14) << "allocations"
+            << std::setw(16) << "bytes" << std::setw(16) << "peak live bytes" << std::endl;
+        for (std::size_t slot = 0; slot < Slots; slot++)
+        {
+            auto stats = get_stats(static_cast<HPhase>(slot));
+            if (stats.mAllocations == 0)
+                continue;
+            out << "\t" << std::left << std::setw(16) << get_phase_name(slot) << std::right << std::setw(14)
+                << stats.mAllocations << std::setw(16) << stats.mBytes << std::setw(16) << stats.mPeakLiveBytes
+                << std::endl;
+            for (auto const &site : get_top_sites(static_cast<HPhase>(slot), sites))
+                out << "\t\t" << std::setw(12) << site.mAllocations << std::setw(16) << site.mBytes << "  "
+                    << get_site_name(site.mAddress) << std::endl;
+        }
+        return;
+    }
+
+  private:
+    struct Header
+    {
+        std::uint64_t mSize;
+        std::uint8_t mPhase;
+    };
+    static_assert(sizeof(Header) <= HeaderSize);
+
+    struct Counters
+    {
+        std::atomic<std::uint64_t> mAllocations{0};
+        std::atomic<std::uint64_t> mBytes{0};
+        std::atomic<std::uint64_t> mFrees{0};
+        std::atomic<std::uint64_t> mLiveBytes{0};
+        std::atomic<std::uint64_t> mPeakLiveBytes{0};
+    };
+
+    // Entry of the site table, keyed by address and phase.
+    struct Site
+    {
+        std::atomic<std::uintptr_t> mKey{0};
+        std::atomic<std::uint64_t> mAllocations{0};
+        std::atomic<std::uint64_t> mBytes{0};
+    };
+
+    // The site table is an open addressing hash table which can't grow, allocating isn't possible. Sites not finding
+    // a free entry within a few probes are only counted per phase.
+    static constexpr std::size_t SiteEntries = 4096;
+    static constexpr std::size_t SiteProbes = 32;
+
+    static Site *find_site(std::uintptr_t address, std::size_t phase) noexcept
+    {
+        auto key = address * Slots + phase;
+        auto index = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 52);
+        for (std::size_t probe = 0; probe < SiteProbes; probe++)
+        {
+            auto &entry = sSites[(index + probe) % SiteEntries];
+            auto current = entry.mKey.load(std::memory_order_relaxed);
+            if (current == 0 && entry.mKey.compare_exchange_strong(current, key, std::memory_order_relaxed))
+                return &entry;
+            if (current == key)
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    static std::string to_hex(std::uintptr_t value)
+    {
+        std::ostringstream hex;
+        hex << "0x" << std::hex << value;
+        return hex.str();
+    }
+
+    static std::array<Counters, Slots> sCounters;
+    static std::array<Site, SiteEntries> sSites;
+};
+
+// Zero initialized before anything runs, allocations of static initializers are counted as well.
+inline std::array<HAllocationTracker::Counters, HAllocationTracker::Slots> HAllocationTracker::sCounters{};
+inline std::array<HAllocationTracker::Site, HAllocationTracker::SiteEntries> HAllocationTracker::sSites{};
+} // namespace hannac
+#endif // ALLOCATIONS_HPP
@@ -2,184 +2,203 @@
 #define CODEGEN_HPP
 
 // stdlib includes
+#include <filesystem>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
+#include <string>
 
 // llvm includes.
-#include "llvm/Analysis/CGSCCPassManager.h"
-#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
-#include "llvm/Passes/PassBuilder.h"
-#include "llvm/Passes/StandardInstrumentations.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
-#include "llvm/Transforms/InstCombine/InstCombine.h"
-#include "llvm/Transforms/Scalar/GVN.h"
-#include "llvm/Transforms/Scalar/Reassociate.h"
-#include "llvm/Transforms/Scalar/SimplifyCFG.h"
 
 // hanna includes.
+#include "ContextPool.hpp"
+#include "GlobalSettings.hpp"
 #include "JIT.hpp"
+#include "Session.hpp"
 
 namespace hannac
 {
-class HContextSingelton final
+// State of generating code for one module.
+// Every compile task generates into its own context, so tasks of one session can run on different threads. The
+// context is taken from the session's context pool when the module is opened and locked until the module is taken.
+class HCompilationContext final
 {
   public:
-    static HContextSingelton &get_context()
+    explicit HCompilationContext(HSession &session) : mSession(session)
     {
-        static HContextSingelton context;
-        return context;
     }
 
-    void reset()
+    HCompilationContext(const HCompilationContext &) = delete;
+    HCompilationContext &operator=(const HCompilationContext &) = delete;
+
+    ~HCompilationContext()
     {
-        mContext = std::make_unique<llvm::LLVMContext>();
-        return;
+        close();
     }
 
-    HContextSingelton(const HContextSingelton &) = delete;
-    HContextSingelton &operator=(const HContextSingelton &) = delete;
-
-    std::unique_ptr<llvm::LLVMContext> mContext = std::make_unique<llvm::LLVMContext>();
-
-  private:
-    HContextSingelton() {};
-};
-
-class HBuilderSingelton final
-{
-  public:
-    static HBuilderSingelton &get_builder()
+    HSession &get_session() noexcept
     {
-        static HBuilderSingelton builder;
-        return builder;
+        return mSession;
     }
 
-    void reset()
+    llvm::LLVMContext &get_context()
     {
-        mBuilder = std::make_unique<llvm::IRBuilder<>>(*HContextSingelton::get_context().mContext);
-
-        return;
+        open();
+        return *mPooled->mContext.getContext();
     }
 
-    static std::unique_ptr<llvm::IRBuilder<>> get()
+    llvm::Module &get_module()
     {
-        return std::make_unique<llvm::IRBuilder<>>(*HContextSingelton::get_context().mContext);
+        open();
+        return *mModule;
     }
 
-    HBuilderSingelton(const HBuilderSingelton &) = delete;
-    HBuilderSingelton &operator=(const HBuilderSingelton &) = delete;
+    llvm::IRBuilder<> &get_builder()
+    {
+        open();
+        return *mBuilder;
+    }
 
-    std::unique_ptr<llvm::IRBuilder<>> mBuilder =
-        std::make_unique<llvm::IRBuilder<>>(*HContextSingelton::get_context().mContext);
+    // Function pass pipeline of the current context.
+    FPM &get_fpm()
+    {
+        open();
+        return mPooled->get_fpm();
+    }
 
-  private:
-    HBuilderSingelton() {};
-};
+    // Debug info of the current module, nullptr unless debug info is enabled.
+    llvm::DIBuilder *get_di_builder()
+    {
+        open();
+        return mDIBuilder.get();
+    }
 
-class HModuleSingelton final
-{
-  public:
-    static HModuleSingelton &get_module()
+    // File of the debug info of the current module. The compile unit is created for the first file.
+    llvm::DIFile *get_di_file(std::string const &path)
     {
-        static HModuleSingelton builder;
-        return builder;
+        auto builder = get_di_builder();
+        std::filesystem::path file{path};
+        auto diFile = builder->createFile(file.filename().string(), file.parent_path().string());
+        if (mCompileUnit == nullptr)
+            mCompileUnit = builder->createCompileUnit(llvm::dwarf::DW_LANG_C, diFile, "hannac",
+                                                      mSession.get_settings().get_opt_level() > 0, "", 0);
+        return diFile;
     }
 
-    void reset()
+    // Complete the debug info of the current module. Required before the module is compiled.
+    void finalize_debug_info()
     {
-        mModule = std::make_unique<llvm::Module>("Hanna Jit", *HContextSingelton::get_context().mContext);
-        mModule->setDataLayout(jit::JITSingelton::get_jit().get_data_layout());
+        if (mDIBuilder != nullptr && !mDebugInfoFinalized)
+            mDIBuilder->finalize();
+        mDebugInfoFinalized = true;
         return;
     }
 
-    HModuleSingelton(const HModuleSingelton &) = delete;
-    HModuleSingelton &operator=(const HModuleSingelton &) = delete;
-
-    std::unique_ptr<llvm::Module> mModule =
-        std::make_unique<llvm::Module>("Hanna Jit", *HContextSingelton::get_context().mContext);
-
-  private:
-    HModuleSingelton()
+    // Values of the arguments of the function currently generated.
+    std::map<std::string, llvm::Value *> &get_names() noexcept
     {
+        return mNames;
+    }
 
-        mModule->setDataLayout(jit::JITSingelton::get_jit().get_data_layout());
-    };
-};
+    // Hand the current module over as ThreadSafeModule. The next access opens a new module.
+    llvm::orc::ThreadSafeModule take_module()
+    {
+        open();
+        finalize_debug_info();
+        llvm::orc::ThreadSafeModule module(std::move(mModule), mPooled->mContext);
+        close();
 
-class FPM final
-{
-  public:
-    FPM(const FPM &) = delete;
-    FPM &operator=(const FPM &) = delete;
-
-    std::unique_ptr<llvm::FunctionPassManager> mFuncPassManager = std::make_unique<llvm::FunctionPassManager>();
-    std::unique_ptr<llvm::FunctionAnalysisManager> mFuncAnalysisManager =
-        std::make_unique<llvm::FunctionAnalysisManager>();
-    std::unique_ptr<llvm::LoopAnalysisManager> mLoopAnalysisManager = std::make_unique<llvm::LoopAnalysisManager>();
-    std::unique_ptr<llvm::CGSCCAnalysisManager> mCGSCCAnalysisManager = std::make_unique<llvm::CGSCCAnalysisManager>();
-    std::unique_ptr<llvm::ModuleAnalysisManager> mModAnalysisManager = std::make_unique<llvm::ModuleAnalysisManager>();
-    std::unique_ptr<llvm::PassInstrumentationCallbacks> mPassInstCallbacl =
-        std::make_unique<llvm::PassInstrumentationCallbacks>();
-    std::unique_ptr<llvm::StandardInstrumentations> mStandardInst =
-        std::make_unique<llvm::StandardInstrumentations>(*HContextSingelton::get_context().mContext,
-                                                         /*DebugLogging*/ true);
-    llvm::PassBuilder mPassBuilder;
-
-    FPM()
-    {
-        mFuncPassManager->addPass(llvm::InstCombinePass());
-        mFuncPassManager->addPass(llvm::ReassociatePass());
-        mFuncPassManager->addPass(llvm::GVNPass());
-        mFuncPassManager->addPass(llvm::SimplifyCFGPass());
-
-        mStandardInst->registerCallbacks(*mPassInstCallbacl, mModAnalysisManager.get());
-        mPassBuilder.registerModuleAnalyses(*mModAnalysisManager);
-        mPassBuilder.registerFunctionAnalyses(*mFuncAnalysisManager);
-        mPassBuilder.crossRegisterProxies(*mLoopAnalysisManager, *mFuncAnalysisManager, *mCGSCCAnalysisManager,
-                                          *mModAnalysisManager);
+        return module;
     }
-};
 
-class HNamesMap final
-{
-  public:
-    static std::map<std::string, llvm::Value *> &get()
+    void reset_builder()
     {
-        static HNamesMap namesMap;
-        return namesMap.mMap;
+        if (mModule == nullptr)
+            return;
+
+        mBuilder = std::make_unique<llvm::IRBuilder<>>(*mPooled->mContext.getContext());
+        if (mSession.get_settings().get_fast_math())
+        {
+            llvm::FastMathFlags flags;
+            flags.setFast();
+            mBuilder->setFastMathFlags(flags);
+        }
+        return;
     }
 
-    HNamesMap(const HNamesMap &) = delete;
-    HNamesMap &operator=(const HNamesMap &) = delete;
+  private:
+    // Open a module in a pooled context.
+    // Opening lazily keeps the context unlocked while the JIT compiles the previous module, e.g. on a compile thread.
+    void open()
+    {
+        if (mModule != nullptr)
+            return;
+
+        mPooled = mSession.get_context_pool().acquire();
+        mLock.emplace(mPooled->mContext.getLock());
+        mModule = std::make_unique<llvm::Module>("Hanna Jit", *mPooled->mContext.getContext());
+        mModule->setDataLayout(mSession.get_jit().get_data_layout());
+        // Contexts are pooled, the handler is installed again for every module.
+        if (mSession.get_jit().get_remarks().enabled())
+            mPooled->mContext.getContext()->setDiagnosticHandler(
+                std::make_unique<HRemarkHandler>(mSession.get_jit().get_remarks()));
+        if (mSession.get_settings().get_debug_info())
+        {
+            mModule->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+            mModule->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+            mDIBuilder = std::make_unique<llvm::DIBuilder>(*mModule);
+            mCompileUnit = nullptr;
+            mDebugInfoFinalized = false;
+        }
+        reset_builder();
+        mNames.clear();
+        return;
+    }
 
-    std::map<std::string, llvm::Value *> mMap;
+    // Drop the current module, if any, and return the context to the pool.
+    void close()
+    {
+        mNames.clear();
+        mBuilder.reset();
+        mDIBuilder.reset();
+        mModule.reset();
+        mLock.reset();
+        if (mPooled != nullptr)
+            mSession.get_context_pool().release(std::move(mPooled));
+        return;
+    }
 
-  private:
-    HNamesMap() = default;
+    HSession &mSession;
+    std::unique_ptr<HPooledContext> mPooled;
+    std::optional<llvm::orc::ThreadSafeContext::Lock> mLock;
+    std::unique_ptr<llvm::Module> mModule;
+    std::unique_ptr<llvm::IRBuilder<>> mBuilder;
+    std::unique_ptr<llvm::DIBuilder> mDIBuilder;
+    llvm::DICompileUnit *mCompileUnit = nullptr;
+    bool mDebugInfoFinalized = false;
+    std::map<std::string, llvm::Value *> mNames;
 };
 
-inline void gen_module_and_reset(llvm::orc::ResourceTrackerSP rt = nullptr)
+inline void gen_module_and_reset(HCompilationContext &ctx, llvm::orc::ResourceTrackerSP rt = nullptr)
 {
+    // Ahead of time compilation collects all functions in one module which is emitted at the end.
+    if (ctx.get_session().get_settings().get_emit_type() != HEmitType::JIT)
+    {
+        ctx.reset_builder();
+        return;
+    }
+
     // Put current state in JIT module, close it and open a new one for next function.
     static llvm::ExitOnError err;
-    if (rt == nullptr)
-        err(jit::JITSingelton::get_jit().add_module(llvm::orc::ThreadSafeModule(
-            std::move(HModuleSingelton::get_module().mModule), std::move(HContextSingelton::get_context().mContext))));
-    else
-        err(jit::JITSingelton::get_jit().add_module(
-            llvm::orc::ThreadSafeModule(std::move(HModuleSingelton::get_module().mModule),
-                                        std::move(HContextSingelton::get_context().mContext)),
-            rt));
-
-    HContextSingelton::get_context().reset();
-    HModuleSingelton::get_module().reset();
-    HBuilderSingelton::get_builder().reset();
+    err(ctx.get_session().get_library().add_module(ctx.take_module(), rt));
 
     return;
 }
 } // namespace hannac
-#endif
\ No newline at end of file
+#endif
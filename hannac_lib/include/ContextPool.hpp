@@ -0,0 +1,192 @@
+#ifndef CONTEXTPOOL_HPP
+#define CONTEXTPOOL_HPP
+
+// stdlib includes
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// llvm includes.
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Scalar/Reassociate.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+
+namespace hannac
+{
+class FPM final
+{
+  public:
+    FPM(const FPM &) = delete;
+    FPM &operator=(const FPM &) = delete;
+
+    std::unique_ptr<llvm::FunctionPassManager> mFuncPassManager = std::make_unique<llvm::FunctionPassManager>();
+    std::unique_ptr<llvm::FunctionPassManager> mLightPassManager = std::make_unique<llvm::FunctionPassManager>();
+    std::unique_ptr<llvm::FunctionAnalysisManager> mFuncAnalysisManager =
+        std::make_unique<llvm::FunctionAnalysisManager>();
+    std::unique_ptr<llvm::LoopAnalysisManager> mLoopAnalysisManager = std::make_unique<llvm::LoopAnalysisManager>();
+    std::unique_ptr<llvm::CGSCCAnalysisManager> mCGSCCAnalysisManager = std::make_unique<llvm::CGSCCAnalysisManager>();
+    std::unique_ptr<llvm::ModuleAnalysisManager> mModAnalysisManager = std::make_unique<llvm::ModuleAnalysisManager>();
+    std::unique_ptr<llvm::PassInstrumentationCallbacks> mPassInstCallbacl =
+        std::make_unique<llvm::PassInstrumentationCallbacks>();
+    std::unique_ptr<llvm::StandardInstrumentations> mStandardInst;
+    // Traces every pass run as span of the function it runs on.
+    std::unique_ptr<llvm::PassInstrumentationCallbacks> mTraceCallbacks =
+        std::make_unique<llvm::PassInstrumentationCallbacks>();
+    llvm::PassBuilder mPassBuilder;
+
+    explicit FPM(llvm::LLVMContext &context)
+        : mStandardInst(std::make_unique<llvm::StandardInstrumentations>(context, /*DebugLogging*/ true))
+    {
+        mFuncPassManager->addPass(llvm::InstCombinePass());
+        mFuncPassManager->addPass(llvm::ReassociatePass());
+        mFuncPassManager->addPass(llvm::GVNPass());
+        mFuncPassManager->addPass(llvm::SimplifyCFGPass());
+
+        // Cheap cleanup for functions not worth the full pipeline.
+        mLightPassManager->addPass(llvm::InstCombinePass());
+        mLightPassManager->addPass(llvm::SimplifyCFGPass());
+
+        mStandardInst->registerCallbacks(*mPassInstCallbacl, mModAnalysisManager.get());
+
+        // Whether the time trace profiler runs is decided per thread, so it is checked per pass.
+        mTraceCallbacks->registerBeforeNonSkippedPassCallback([](llvm::StringRef pass, llvm::Any ir) {
+            if (!llvm::timeTraceProfilerEnabled())
+                return;
+            auto func = llvm::any_cast<const llvm::Function *>(&ir);
+            llvm::timeTraceProfilerBegin(pass, func != nullptr ? (*func)->getName() : llvm::StringRef());
+        });
+        mTraceCallbacks->registerAfterPassCallback([](llvm::StringRef, llvm::Any, llvm::PreservedAnalyses const &) {
+            if (llvm::timeTraceProfilerEnabled())
+                llvm::timeTraceProfilerEnd();
+        });
+        mTraceCallbacks->registerAfterPassInvalidatedCallback([](llvm::StringRef, llvm::PreservedAnalyses const &) {
+            if (llvm::timeTraceProfilerEnabled())
+                llvm::timeTraceProfilerEnd();
+        });
+        mFuncAnalysisManager->registerPass(
+            [this]() { return llvm::PassInstrumentationAnalysis(mTraceCallbacks.get()); });
+        mPassBuilder.registerModuleAnalyses(*mModAnalysisManager);
+        mPassBuilder.registerFunctionAnalyses(*mFuncAnalysisManager);
+        mPassBuilder.crossRegisterProxies(*mLoopAnalysisManager, *mFuncAnalysisManager, *mCGSCCAnalysisManager,
+                                          *mModAnalysisManager);
+    }
+
+    // Optimize a function with the full or the light pipeline.
+    // Cached analyses are dropped afterwards, the function is gone once its module is compiled.
+    void run(llvm::Function &func, bool full = true)
+    {
+        (full ? mFuncPassManager : mLightPassManager)->run(func, *mFuncAnalysisManager);
+        mFuncAnalysisManager->clear();
+        return;
+    }
+};
+
+/******************************************************************************
+ ******************************* CONTEXT POOL *********************************
+ *****************************************************************************/
+
+// Counters of a HContextPool.
+struct HContextPoolStats
+{
+    // Contexts allocated.
+    std::uint64_t mCreated = 0;
+    // Modules opened in an already existing context.
+    std::uint64_t mReused = 0;
+    // Contexts dropped after reaching their module limit.
+    std::uint64_t mRetired = 0;
+};
+
+// LLVMContext reused for many modules, together with its function pass pipeline.
+struct HPooledContext
+{
+    llvm::orc::ThreadSafeContext mContext;
+    std::unique_ptr<FPM> mFPM;
+    // Modules opened in this context so far.
+    std::uint64_t mModules = 0;
+
+    FPM &get_fpm()
+    {
+        if (mFPM == nullptr)
+            mFPM = std::make_unique<FPM>(*mContext.getContext());
+        return *mFPM;
+    }
+};
+
+// Pool of contexts shared by all compilation contexts of a JIT.
+// Setting up a context (type and constant uniquing tables, metadata) and a pass pipeline costs more than generating a
+// typical hanna method, so contexts are handed out again once the module generated in them is taken. Modules handed to
+// the JIT keep their context alive and lock it while being compiled, so a reused context is only used under its lock.
+// Contexts only grow, they are retired after a fixed number of modules.
+class HContextPool final
+{
+  public:
+    explicit HContextPool(std::uint64_t maxModules = 1024) : mMaxModules(maxModules)
+    {
+    }
+
+    HContextPool(const HContextPool &) = delete;
+    HContextPool &operator=(const HContextPool &) = delete;
+
+    std::unique_ptr<HPooledContext> acquire()
+    {
+        std::unique_ptr<HPooledContext> context;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mFree.empty())
+            {
+                context = std::move(mFree.back());
+                mFree.pop_back();
+                mStats.mReused++;
+            }
+            else
+            {
+                mStats.mCreated++;
+            }
+        }
+
+        if (context == nullptr)
+        {
+            context = std::make_unique<HPooledContext>();
+            context->mContext = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+        }
+        context->mModules++;
+
+        return context;
+    }
+
+    void release(std::unique_ptr<HPooledContext> context)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (context->mModules >= mMaxModules)
+        {
+            mStats.mRetired++;
+            return;
+        }
+
+        mFree.push_back(std::move(context));
+        return;
+    }
+
+    HContextPoolStats get_stats()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+  private:
+    std::uint64_t mMaxModules;
+    std::vector<std::unique_ptr<HPooledContext>> mFree;
+    std::mutex mMutex;
+    HContextPoolStats mStats;
+};
+} // namespace hannac
+#endif // CONTEXTPOOL_HPP
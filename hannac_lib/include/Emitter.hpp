@@ -0,0 +1,204 @@
+#ifndef EMITTER_HPP
+#define EMITTER_HPP
+
+// stdlib includes.
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// llvm includes.
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+
+// hannac includes.
+#include "AST.hpp"
+#include "Codegen.hpp"
+#include "GlobalSettings.hpp"
+#include "JIT.hpp"
+#include "Session.hpp"
+
+namespace hannac
+{
+struct EmitError : public std::exception
+{
+  public:
+    EmitError(std::string const &message) : mMessage{message}
+    {
+    }
+
+    const char *what() const throw()
+    {
+        return mMessage.c_str();
+    }
+
+  private:
+    std::string mMessage;
+};
+
+/******************************************************************************
+ ********************************* EMITTER ************************************
+ *****************************************************************************/
+
+// Compiles a hanna program ahead of time.
+// Every main statement becomes a function, all specializations reachable from them are generated into the same
+// module and a C main function calling the statements in order and printing their results is added.
+// The module is written as native object file or linked into a standalone executable.
+class HEmitter final
+{
+  public:
+    HEmitter(HSession &session, std::vector<std::unique_ptr<ast::Expression>> program)
+        : mSession(session), mProgram(std::move(program))
+    {
+    }
+
+    void operator()(std::filesystem::path const &output, HEmitType type)
+    {
+        if (type == HEmitType::JIT)
+            throw EmitError{"Nothing to emit for JIT execution."};
+
+        mSession.get_settings().set_emit_type(type);
+
+        // Everything is generated into one module.
+        HCompilationContext ctx(mSession);
+
+        // Generate a function for each statement.
+        std::vector<std::pair<llvm::Function *, ast::ASTType>> statements;
+        for (auto &line : mProgram)
+        {
+            if (mSession.get_settings().get_verbose() > 0)
+                std::cout << "Compiling: " << line->get_call() << std::endl;
+
+            auto name = "__hanna_statement_" + std::to_string(statements.size());
+            auto declaration = std::make_shared<hannac::ast::MethodDeclaration>(name, std::vector<std::string>());
+            auto method = std::make_unique<hannac::ast::MethodDefinition>(std::move(declaration), std::move(line));
+
+            auto code = method->codegen(ctx);
+            if (code == nullptr)
+                throw EmitError{"Unable to generate code for " + name};
+            if (mSession.get_settings().get_verbose() > 1)
+                code->print(llvm::outs());
+            gen_module_and_reset(ctx);
+
+            // Generate everything called by this statement.
+            ast::gen_pending_specializations(ctx);
+
+            statements.push_back({code, method->get_return_type()});
+        }
+
+        gen_main(ctx, statements);
+
+        ctx.finalize_debug_info();
+        auto &module = ctx.get_module();
+        if (llvm::verifyModule(module, &llvm::errs()))
+            throw EmitError{"Generated module is broken."};
+
+        if (type == HEmitType::OBJ)
+        {
+            emit_object(module, output);
+            return;
+        }
+
+        // Link object with the system compiler driver, which knows where to find the C runtime.
+        auto object = output;
+        object += ".o";
+        emit_object(module, object);
+        link(object, output);
+        std::error_code ec;
+        std::filesystem::remove(object, ec);
+
+        return;
+    }
+
+  private:
+    // Generate C main calling every statement and printing its result the same way print_result does.
+    void gen_main(HCompilationContext &ctx, std::vector<std::pair<llvm::Function *, ast::ASTType>> const &statements)
+    {
+        auto &context = ctx.get_context();
+        auto &module = ctx.get_module();
+        auto &builder = ctx.get_builder();
+
+        auto printfType = llvm::FunctionType::get(builder.getInt32Ty(), {builder.getPtrTy()}, true);
+        auto printfFunc = module.getOrInsertFunction("printf", printfType);
+
+        auto mainType = llvm::FunctionType::get(builder.getInt32Ty(), false);
+        auto mainFunc = llvm::Function::Create(mainType, llvm::Function::ExternalLinkage, "main", module);
+        builder.SetInsertPoint(llvm::BasicBlock::Create(context, "Entry", mainFunc));
+
+        auto intFormat = builder.CreateGlobalString("\tResult: %lld\n", "int_format");
+        auto realFormat = builder.CreateGlobalString("\tResult: %g\n", "real_format");
+        for (auto const &[func, type] : statements)
+        {
+            auto result = builder.CreateCall(func, {}, "result");
+            builder.CreateCall(printfFunc, {type == ast::ASTType::RealNumber ? realFormat : intFormat, result});
+        }
+        builder.CreateRet(builder.getInt32(0));
+
+        return;
+    }
+
+    void emit_object(llvm::Module &module, std::filesystem::path const &output)
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        auto triple = llvm::sys::getProcessTriple();
+        std::string error;
+        auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+        if (target == nullptr)
+            throw EmitError{error};
+
+        llvm::TargetOptions options;
+        std::unique_ptr<llvm::TargetMachine> targetMachine(target->createTargetMachine(
+            triple, "generic", "", options, llvm::Reloc::PIC_, std::nullopt,
+            jit::HJIT::get_codegen_opt_level(mSession.get_settings().get_opt_level())));
+        module.setTargetTriple(triple);
+        module.setDataLayout(targetMachine->createDataLayout());
+
+        std::error_code ec;
+        llvm::raw_fd_ostream dest(output.string(), ec, llvm::sys::fs::OF_None);
+        if (ec)
+            throw EmitError{"Unable to open " + output.string() + ": " + ec.message()};
+
+        llvm::legacy::PassManager passManager;
+        if (targetMachine->addPassesToEmitFile(passManager, dest, nullptr, llvm::CodeGenFileType::ObjectFile))
+            throw EmitError{"Target can't emit object files."};
+        passManager.run(module);
+        dest.flush();
+
+        return;
+    }
+
+    void link(std::filesystem::path const &object, std::filesystem::path const &output)
+    {
+        auto driver = llvm::sys::findProgramByName("cc");
+        if (!driver)
+            throw EmitError{"No system compiler driver (cc) found for linking."};
+
+        std::string objectPath = object.string();
+        std::string outputPath = output.string();
+        std::vector<llvm::StringRef> args{*driver, objectPath, "-o", outputPath};
+        std::string error;
+        if (llvm::sys::ExecuteAndWait(*driver, args, std::nullopt, {}, 0, 0, &error) != 0)
+            throw EmitError{"Linking " + outputPath + " failed. " + error};
+
+        return;
+    }
+
+    HSession &mSession;
+    std::vector<std::unique_ptr<ast::Expression>> mProgram;
+};
+} // namespace hannac
+#endif // EMITTER_HPP
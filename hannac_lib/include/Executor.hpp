@@ -5,11 +5,18 @@
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string>
 
 // hannac includes.
 #include "AST.hpp"
 #include "Codegen.hpp"
 #include "GlobalSettings.hpp"
+#include "Optimizer.hpp"
+#include "PerfCounters.hpp"
+#include "Profiler.hpp"
+#include "Scheduler.hpp"
+#include "Session.hpp"
+#include "Trace.hpp"
 
 namespace hannac
 {
@@ -70,6 +77,28 @@ inline void print_result(HResult &res)
     return;
 }
 
+inline void print_registry_stats(HRegistryStats const &stats)
+{
+    if (stats.mRequests == 0)
+        return;
+
+    std::cout << "Specialization registry: " << stats.mRequests << " requests, " << stats.mCreated << " compiled, "
+              << stats.mHits << " hits, " << stats.mWaits << " waited for in-flight compilation." << std::endl;
+    std::cout << "Specialization registry: " << stats.mContended << " contended locks, "
+              << stats.mLockWaitNanos / 1000 << "us waiting for locks." << std::endl;
+    return;
+}
+
+inline void print_optimizer_stats(HOptimizerStats const &stats)
+{
+    if (stats.mLight + stats.mFull == 0)
+        return;
+
+    std::cout << "Optimizer: " << stats.mFull << " full, " << stats.mLight << " light (" << stats.mOverBudget
+              << " over budget), " << stats.mNanos / 1000 << "us optimizing." << std::endl;
+    return;
+}
+
 /******************************************************************************
  ********************************* EXECUTOR ***********************************
  *****************************************************************************/
@@ -80,52 +109,112 @@ inline void print_result(HResult &res)
 class HExecutor final
 {
   public:
-    explicit HExecutor(std::vector<std::unique_ptr<ast::Expression>> program) : mProgram(std::move(program))
+    HExecutor(HSession &session, std::vector<std::unique_ptr<ast::Expression>> program)
+        : mSession(session), mProgram(std::move(program))
     {
     }
 
     std::vector<HResult> operator()()
     {
+        // The call graph predicts call frequencies for the optimizer. Everything the program calls is compiled
+        // upfront when multiple compile threads are available.
+        if (mSession.get_settings().get_jobs() > 1 || mSession.get_settings().get_opt_level() > 0)
+        {
+            HCompileScheduler scheduler{mSession, mProgram};
+            for (auto *session = &mSession; session != nullptr; session = session->get_base())
+                session->get_optimizer().set_call_frequencies(scheduler.get_call_frequencies());
+            if (mSession.get_settings().get_jobs() > 1)
+                scheduler();
+        }
+
         for (auto &line : mProgram)
         {
             auto declaration =
                 std::make_shared<hannac::ast::MethodDeclaration>("__hanna_execution", std::vector<std::string>());
 
-            if (HSettings::get_settings().get_verbose() > 0)
-                std::cout << "Executing: " << line->get_call() << std::endl;
+            auto call = line->get_call();
+            if (mSession.get_settings().get_verbose() > 0)
+                std::cout << "Executing: " << call << std::endl;
 
             auto method = std::make_unique<hannac::ast::MethodDefinition>(std::move(declaration), std::move(line));
 
             // Immediately execute artifical generated method.
-            hannac::HResult result = execute(std::move(method));
+            // Code generated on this thread meanwhile is accounted to its own phases.
+            hannac::HResult result = [&]() {
+                HPhaseScope scope(mSession.get_jit().get_time_report(), HPhase::Execute, "Execute", call);
+                return execute(std::move(method), call);
+            }();
+            mSession.get_jit().get_run_stats().mStatements++;
             mState.mResults.push_back(result);
 
-            if (HSettings::get_settings().get_verbose() > 0)
+            if (mSession.get_settings().get_verbose() > 0)
             {
                 print_result(result);
                 std::cout << std::endl;
             }
+
+            // No code runs between two statements, keep the resident code within the budget.
+            static llvm::ExitOnError err;
+            err(mSession.get_library().evict_cold_methods());
+        }
+
+        if (mSession.get_settings().get_verbose() > 0)
+        {
+            print_registry_stats(mSession.get_library().get_specializations().get_stats());
+            auto pool = mSession.get_context_pool().get_stats();
+            std::cout << "Context pool: " << pool.mCreated << " contexts created, " << pool.mReused << " reused, "
+                      << pool.mRetired << " retired." << std::endl;
+            print_optimizer_stats(mSession.get_optimizer().get_stats());
+            {
+                auto &profile = mSession.get_value_profile();
+                std::lock_guard<std::mutex> lock(profile.mMutex);
+                if (!profile.mClones.empty())
+                    std::cout << "Value clones: " << profile.mClones.size() << " of at most "
+                              << mSession.get_settings().get_max_clones() << "." << std::endl;
+            }
+            {
+                auto &guard = mSession.get_specialization_guard();
+                std::lock_guard<std::mutex> lock(guard.mMutex);
+                for (auto const &[name, fallbacks] : guard.mFallbacks)
+                {
+                    auto calls = guard.mCalls.find(name);
+                    std::cout << "Generic fallback: " << name << " for " << fallbacks.size() << " argument types, "
+                              << (calls != guard.mCalls.end() ? calls->second->load() : 0) << " calls." << std::endl;
+                }
+            }
+            if (mSession.get_library().get_merged_methods() > 0)
+                std::cout << "Identical code folding: " << mSession.get_library().get_merged_methods()
+                          << " methods merged, about " << mSession.get_library().get_merged_size() << " bytes saved."
+                          << std::endl;
+            if (mSession.get_settings().get_tier_up_threshold() > 0)
+                std::cout << "Tier-up: " << mSession.get_library().get_tiered_up_methods() << " methods optimized."
+                          << std::endl;
+            if (mSession.get_settings().get_code_budget() > 0)
+                std::cout << "Code budget: " << mSession.get_library().get_resident_size() << " bytes resident, "
+                          << mSession.get_library().get_evicted_methods() << " methods evicted." << std::endl;
         }
 
         return mState.mResults;
     }
 
-    HResult execute(std::unique_ptr<ast::MethodDefinition> method)
+    // Runs method once. The run is profiled and its hardware events are counted as statement if given.
+    HResult execute(std::unique_ptr<ast::MethodDefinition> method, std::string const &statement = {})
     {
         // Generate code.
-        auto code = method->codegen();
-        if (HSettings::get_settings().get_verbose() > 1)
+        HCompilationContext ctx(mSession);
+        auto code = method->codegen(ctx);
+        if (mSession.get_settings().get_verbose() > 1)
         {
             std::cout << "Executing " << method->get_name() << std::endl;
             code->print(llvm::outs());
         }
 
         // Create ressource tracker for execution method.
-        auto ressourceTracker = jit::JITSingelton::get_jit().create_ressource_tracker();
-        gen_module_and_reset(ressourceTracker);
+        auto ressourceTracker = mSession.get_library().create_ressource_tracker();
+        gen_module_and_reset(ctx, ressourceTracker);
 
         // Execute newly generated method by finding its symbol, getting its adress and calling it.
-        auto ExprSymbol = jit::JITSingelton::get_jit().find_symbol("__hanna_execution");
+        auto ExprSymbol = mSession.get_library().find_symbol("__hanna_execution");
 
         // Generate module, add function and reset module.
         static llvm::ExitOnError err;
@@ -133,27 +222,68 @@ class HExecutor final
         {
             // works because double and int64_t are 64Bit.
             double (*call)() = ExprSymbol.getAddress().toPtr<double (*)()>();
-            HResult dRes{HResultType::REAL, res{call()}};
+            HResult dRes{HResultType::REAL, res{profiled(call, statement)}};
 
             // Delete the anonymous expression module from the JIT.
-            err(ressourceTracker->remove());
+            err(mSession.get_library().remove_ressource_tracker(ressourceTracker));
 
             return dRes;
         }
         else
         {
             std::int64_t (*call)() = ExprSymbol.getAddress().toPtr<std::int64_t (*)()>();
-            HResult iRes{HResultType::INT, res{.i = call()}};
+            HResult iRes{HResultType::INT, res{.i = profiled(call, statement)}};
 
             // Delete the anonymous expression module from the JIT.
-            err(ressourceTracker->remove());
+            err(mSession.get_library().remove_ressource_tracker(ressourceTracker));
 
             return iRes;
         }
     }
 
   private:
+    // Call the code of a statement, profiling it and counting its hardware events if enabled.
+    // Statements are profiled like methods, the same statement of a program has one slot.
+    template <typename T> T profiled(T (*call)(), std::string const &statement)
+    {
+        auto &profiler = mSession.get_jit().get_profiler();
+        auto &counterReport = mSession.get_jit().get_counter_report();
+        bool profile = profiler.enabled() && !statement.empty();
+        bool count = counterReport.enabled() && !statement.empty() && open_counters();
+        if (!profile && !count)
+            return call();
+
+        std::uint64_t slot = 0;
+        if (profile)
+            slot = profiler.get_slot(mSession.get_library().get_name(), statement, "main:", " " + statement);
+
+        auto events = count ? mPerfCounters->read() : HCounterValues{};
+        if (profile)
+            HProfiler::enter(&profiler, slot);
+        T result = call();
+        if (profile)
+            HProfiler::exit(&profiler, slot);
+        if (count)
+            counterReport.add(statement, mPerfCounters->read() - events);
+        return result;
+    }
+
+    // Open the hardware counters of this thread on first use. Returns whether they are available.
+    bool open_counters()
+    {
+        if (mPerfCounters == nullptr)
+        {
+            mPerfCounters = std::make_unique<HPerfCounters>();
+            if (!mPerfCounters->available())
+                warn_counters_unavailable(mPerfCounters->get_error());
+        }
+        return mPerfCounters->available();
+    }
+
+    HSession &mSession;
     HProgramState mState;
+    // Counters of the thread running the statements.
+    std::unique_ptr<HPerfCounters> mPerfCounters;
     std::vector<std::unique_ptr<ast::Expression>> mProgram;
 };
 } // namespace hannac
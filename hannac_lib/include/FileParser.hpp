@@ -62,12 +62,30 @@ struct HFileParser final
         if (mFile.eof())
             return EOF;
 
+        // A newline ends its line, the line count moves on with the next character.
+        if (mNewline)
+            mLine++;
+        mNewline = current == '\n';
+
         return current;
     };
 
+    // Line of the character read last, starting at 1.
+    unsigned get_line() const noexcept
+    {
+        return mLine;
+    }
+
+    std::filesystem::path const &get_path() const noexcept
+    {
+        return mSourceFilePath;
+    }
+
   private:
     std::filesystem::path mSourceFilePath;
     std::ifstream mFile;
+    unsigned mLine = 1;
+    bool mNewline = false;
 };
 } // namespace hannac
 #endif // FILEPARSER_HPP
\ No newline at end of file
@@ -0,0 +1,180 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+// stdlib includes.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hannac
+{
+// Shape of a generated hanna program.
+struct HGeneratorOptions
+{
+    std::uint64_t mSeed = 1;
+    std::size_t mMethods = 100;
+    // Parameters per method, chosen uniformly. Methods have at least one.
+    std::size_t mMinParameters = 1;
+    std::size_t mMaxParameters = 3;
+    // Operands per expression.
+    std::size_t mExpressionWidth = 4;
+    // hanna has no parentheses, expressions nest as arguments of calls. Depth 1 is a flat expression.
+    std::size_t mExpressionDepth = 2;
+    // Methods calling each other in a chain, the first one of every chain calls none. Depth 1 generates no calls.
+    std::size_t mCallChainDepth = 4;
+    // Share of literals which are reals, the rest are integers.
+    double mRealRatio = 0.25;
+    // Share of operands which are literals, the rest are parameters.
+    double mLiteralDensity = 0.3;
+    // Share of methods and statements preceded by a comment line.
+    double mCommentRatio = 0.1;
+    std::size_t mStatements = 100;
+};
+
+// Generates hanna programs of a given shape for scaling experiments. The same options generate the same program on
+// every platform.
+// Generated programs always compile and run: calls only go to methods defined before, so there is no recursion, and
+// divisors are nonzero literals.
+class HProgramGenerator final
+{
+  public:
+    explicit HProgramGenerator(HGeneratorOptions options) : mOptions(std::move(options)), mRandom(mOptions.mSeed)
+    {
+        mOptions.mMethods = std::max<std::size_t>(mOptions.mMethods, 1);
+        mOptions.mMinParameters = std::max<std::size_t>(mOptions.mMinParameters, 1);
+        mOptions.mMaxParameters = std::max(mOptions.mMaxParameters, mOptions.mMinParameters);
+        mOptions.mExpressionWidth = std::max<std::size_t>(mOptions.mExpressionWidth, 1);
+        mOptions.mExpressionDepth = std::max<std::size_t>(mOptions.mExpressionDepth, 1);
+        mOptions.mCallChainDepth = std::max<std::size_t>(mOptions.mCallChainDepth, 1);
+    }
+
+    void generate(std::ostream &out)
+    {
+        for (std::size_t i = 0; i < mOptions.mMethods; i++)
+            gen_method(out, i);
+
+        out << "main\n";
+        for (std::size_t i = 0; i < mOptions.mStatements; i++)
+            gen_statement(out, i);
+        return;
+    }
+
+    std::string generate()
+    {
+        std::ostringstream out;
+        generate(out);
+        return out.str();
+    }
+
+  private:
+    // Method i calls method i - 1 unless it starts a chain.
+    void gen_method(std::ostream &out, std::size_t i)
+    {
+        auto parameters = mOptions.mMinParameters + next(mOptions.mMaxParameters - mOptions.mMinParameters + 1);
+        mParameters.push_back(parameters);
+
+        if (chance(mOptions.mCommentRatio))
+            out << "# Method " << i << " of chain " << i / mOptions.mCallChainDepth << "\n";
+        out << "method m" << i << "(";
+        for (std::size_t p = 0; p < parameters; p++)
+            out << (p > 0 ? ", " : "") << "p" << p;
+        out << ")\n";
+
+        auto callee = i % mOptions.mCallChainDepth > 0 ? static_cast<std::int64_t>(i) - 1 : -1;
+        out << "    return " << gen_expression(parameters, mOptions.mExpressionDepth, callee) << "\n\n";
+        return;
+    }
+
+    // Call of a random method with literal arguments, so every statement runs a specialization.
+    void gen_statement(std::ostream &out, std::size_t i)
+    {
+        if (chance(mOptions.mCommentRatio))
+            out << "    # Statement " << i << "\n";
+
+        auto method = next(mOptions.mMethods);
+        out << "    m" << method << "(";
+        for (std::size_t p = 0; p < mParameters[method]; p++)
+            out << (p > 0 ? ", " : "") << gen_literal();
+        out << ")\n";
+        return;
+    }
+
+    // Expression of mExpressionWidth operands over parameters p0 to p<parameters - 1>, calling callee if not -1.
+    // A call may not be the first operand of an expression: the parser ends an expression after a leading call.
+    std::string gen_expression(std::size_t parameters, std::size_t depth, std::int64_t callee)
+    {
+        auto width = mOptions.mExpressionWidth;
+        auto callAt = callee >= 0 ? (width > 1 ? 1 + next(width - 1) : 0) : width;
+
+        std::string expression;
+        for (std::size_t operand = 0; operand < width; operand++)
+        {
+            static constexpr char Operators[] = {'+', '-', '*', '/'};
+            char op = Operators[next(operand == callAt ? 3 : 4)];
+            if (operand > 0)
+                expression += std::string(" ") + op + " ";
+
+            // Only literals divide, they are never 0.
+            if (operand == callAt)
+                expression += gen_call(parameters, depth, static_cast<std::size_t>(callee));
+            else if (operand > 0 && op == '/')
+                expression += gen_divisor();
+            else if (chance(mOptions.mLiteralDensity))
+                expression += gen_literal();
+            else
+                expression += "p" + std::to_string(next(parameters));
+        }
+        return expression;
+    }
+
+    // Arguments nest depth - 1 levels of expressions without calls.
+    std::string gen_call(std::size_t parameters, std::size_t depth, std::size_t callee)
+    {
+        std::string call = "m" + std::to_string(callee) + "(";
+        for (std::size_t p = 0; p < mParameters[callee]; p++)
+        {
+            if (p > 0)
+                call += ", ";
+            call += depth > 1 ? gen_expression(parameters, depth - 1, -1) : "p" + std::to_string(next(parameters));
+        }
+        return call + ")";
+    }
+
+    std::string gen_literal()
+    {
+        if (chance(mOptions.mRealRatio))
+            return std::to_string(next(100)) + "." + std::to_string(next(100));
+        return std::to_string(next(100));
+    }
+
+    std::string gen_divisor()
+    {
+        if (chance(mOptions.mRealRatio))
+            return std::to_string(1 + next(9)) + ".5";
+        return std::to_string(2 + next(8));
+    }
+
+    // The standard distributions differ between implementations, only the engine's output is portable.
+    std::size_t next(std::size_t bound)
+    {
+        return static_cast<std::size_t>(mRandom() % bound);
+    }
+
+    bool chance(double probability)
+    {
+        return static_cast<double>(mRandom() >> 11) * 0x1.0p-53 < probability;
+    }
+
+    HGeneratorOptions mOptions;
+    std::mt19937_64 mRandom;
+    // Parameters of the methods generated so far.
+    std::vector<std::size_t> mParameters;
+};
+} // namespace hannac
+#endif // GENERATOR_HPP
@@ -1,17 +1,32 @@
 #ifndef GLOBALSETTINGS_HPP
 #define GLOBALSETTINGS_HPP
 
+// stdlib includes
+#include <cstdint>
+#include <string>
+
 namespace hannac
 {
+// What the compiler produces from a hanna program.
+enum class HEmitType : std::uint8_t
+{
+    JIT = 0, // Compile and execute in process.
+    OBJ = 1, // Native object file.
+    EXE = 2  // Standalone executable.
+};
+
+// Code hardware counters are read around.
+enum class HHardwareCounters : std::uint8_t
+{
+    None = 0,
+    Statements = 1, // Every main statement.
+    Methods = 2     // Every main statement and every profiled method, implies profiling.
+};
+
+// Settings of a compilation session.
 class HSettings final
 {
   public:
-    static HSettings &get_settings()
-    {
-        static HSettings settings;
-        return settings;
-    }
-
     void set_verbose(int lev) noexcept
     {
         mVerbose = lev;
@@ -21,14 +36,259 @@ class HSettings final
         return mVerbose;
     }
 
-    HSettings(const HSettings &) = delete;
-    HSettings &operator=(const HSettings &) = delete;
+    // Optimization level (0-3) used for IR passes and native code generation.
+    void set_opt_level(int lev) noexcept
+    {
+        mOptLevel = lev;
+    }
+    int get_opt_level() const noexcept
+    {
+        return mOptLevel;
+    }
 
-  private:
-    HSettings() {};
+    // Generate real arithmetic with all fast-math flags, like -ffast-math. Allows reassociating, contracting to fused
+    // multiply-adds and assuming there are no NaNs or infinities, results may differ in the last bits.
+    void set_fast_math(bool fastMath) noexcept
+    {
+        mFastMath = fastMath;
+    }
+    bool get_fast_math() const noexcept
+    {
+        return mFastMath;
+    }
+
+    // Directory of the persistent object cache. Empty disables the cache.
+    void set_cache_dir(std::string const &dir)
+    {
+        mCacheDir = dir;
+    }
+    std::string const &get_cache_dir() const noexcept
+    {
+        return mCacheDir;
+    }
+
+    // Upper bound of the object cache directory size in bytes.
+    void set_cache_size(std::uint64_t bytes) noexcept
+    {
+        mCacheSize = bytes;
+    }
+    std::uint64_t get_cache_size() const noexcept
+    {
+        return mCacheSize;
+    }
+
+    void set_emit_type(HEmitType type) noexcept
+    {
+        mEmitType = type;
+    }
+    HEmitType get_emit_type() const noexcept
+    {
+        return mEmitType;
+    }
+
+    // Number of threads compiling method specializations.
+    // More than one compiles everything reachable from main in parallel ahead of execution.
+    void set_jobs(unsigned jobs) noexcept
+    {
+        mJobs = jobs == 0 ? 1 : jobs;
+    }
+    unsigned get_jobs() const noexcept
+    {
+        return mJobs;
+    }
+
+    // Maximum number of method specializations generated into one JIT module.
+    // Specializations registered together, e.g. all callees of a statement, are then emitted and linked at once.
+    void set_batch_size(std::uint64_t size) noexcept
+    {
+        mBatchSize = size == 0 ? 1 : size;
+    }
+    std::uint64_t get_batch_size() const noexcept
+    {
+        return mBatchSize;
+    }
+
+    // Upper bound of the JIT code kept loaded per library in bytes, 0 is unlimited.
+    // Least recently used method specializations are evicted and compiled again when called. A program's library is
+    // checked after every statement, the shared library holding specializations of library methods between programs.
+    void set_code_budget(std::uint64_t bytes) noexcept
+    {
+        mCodeBudget = bytes;
+    }
+    std::uint64_t get_code_budget() const noexcept
+    {
+        return mCodeBudget;
+    }
+
+    // Calls after which a method specialization is recompiled with the full optimization pipeline, 0 disables it.
+    void set_tier_up_threshold(std::uint64_t calls) noexcept
+    {
+        mTierUpThreshold = calls;
+    }
+    std::uint64_t get_tier_up_threshold() const noexcept
+    {
+        return mTierUpThreshold;
+    }
+
+    // Milliseconds the IR optimizer may spend per program, 0 is unlimited.
+    // Once spent, specializations are optimized with the light pipeline only.
+    void set_opt_budget(std::uint64_t millis) noexcept
+    {
+        mOptBudget = millis;
+    }
+    std::uint64_t get_opt_budget() const noexcept
+    {
+        return mOptBudget;
+    }
+
+    // Predicted calls with the same constant arguments after which call sites call a clone of the method with the
+    // constants baked in, 0 disables cloning. Cloning is experimental and off by default.
+    void set_clone_threshold(std::uint64_t calls) noexcept
+    {
+        mCloneThreshold = calls;
+    }
+    std::uint64_t get_clone_threshold() const noexcept
+    {
+        return mCloneThreshold;
+    }
+
+    // Maximum number of clones per library.
+    void set_max_clones(std::uint64_t clones) noexcept
+    {
+        mMaxClones = clones;
+    }
+    std::uint64_t get_max_clones() const noexcept
+    {
+        return mMaxClones;
+    }
+
+    // Maximum number of specializations per method, 0 is unlimited and the default.
+    // Calls with further argument types run a generic version of the method on boxed values.
+    void set_max_specializations(std::uint64_t specializations) noexcept
+    {
+        mMaxSpecializations = specializations;
+    }
+    std::uint64_t get_max_specializations() const noexcept
+    {
+        return mMaxSpecializations;
+    }
+
+    // Report the time spent per compilation phase.
+    void set_time_report(bool timeReport) noexcept
+    {
+        mTimeReport = timeReport;
+    }
+    bool get_time_report() const noexcept
+    {
+        return mTimeReport;
+    }
+
+    // File to write a Chrome trace of compilation and execution to, empty disables tracing.
+    void set_trace_file(std::string const &traceFile)
+    {
+        mTraceFile = traceFile;
+    }
+    std::string const &get_trace_file() const noexcept
+    {
+        return mTraceFile;
+    }
+
+    // Emit DWARF line tables mapping generated code to the lines of the hanna source.
+    void set_debug_info(bool debugInfo) noexcept
+    {
+        mDebugInfo = debugInfo;
+    }
+    bool get_debug_info() const noexcept
+    {
+        return mDebugInfo;
+    }
+
+    // Make JIT code known to profilers: write /tmp/perf-<pid>.map and, if LLVM supports it, jitdump records.
+    void set_perf(bool perf) noexcept
+    {
+        mPerf = perf;
+    }
+    bool get_perf() const noexcept
+    {
+        return mPerf;
+    }
+
+    // File to write the run statistics to as JSON, empty disables them.
+    void set_stats_file(std::string const &statsFile)
+    {
+        mStatsFile = statsFile;
+    }
+    std::string const &get_stats_file() const noexcept
+    {
+        return mStatsFile;
+    }
+
+    // Count calls and time of every method specialization and main statement run, see HProfiler.
+    void set_profile(bool profile) noexcept
+    {
+        mProfile = profile;
+    }
+    bool get_profile() const noexcept
+    {
+        return mProfile;
+    }
+
+    // File to write the call graph of the profile to in DOT format, empty disables it. Implies profiling.
+    void set_call_graph_file(std::string const &callGraphFile)
+    {
+        mCallGraphFile = callGraphFile;
+    }
+    std::string const &get_call_graph_file() const noexcept
+    {
+        return mCallGraphFile;
+    }
 
+    // Read cycles, instructions, branch and cache misses via perf_event_open, see HPerfCounters.
+    void set_hardware_counters(HHardwareCounters counters) noexcept
+    {
+        mHardwareCounters = counters;
+    }
+    HHardwareCounters get_hardware_counters() const noexcept
+    {
+        return mHardwareCounters;
+    }
+
+    // File to write LLVM optimization remarks to, as JSON if it ends in .json and as YAML otherwise. Empty disables
+    // remarks.
+    void set_remarks_file(std::string const &remarksFile)
+    {
+        mRemarksFile = remarksFile;
+    }
+    std::string const &get_remarks_file() const noexcept
+    {
+        return mRemarksFile;
+    }
+
+  private:
     // Settings
     int mVerbose = 0;
+    int mOptLevel = 2;
+    bool mFastMath = false;
+    std::string mCacheDir{};
+    std::uint64_t mCacheSize = 256 * 1024 * 1024;
+    HEmitType mEmitType = HEmitType::JIT;
+    unsigned mJobs = 1;
+    std::uint64_t mBatchSize = 1;
+    std::uint64_t mCodeBudget = 0;
+    std::uint64_t mTierUpThreshold = 0;
+    std::uint64_t mOptBudget = 0;
+    std::uint64_t mCloneThreshold = 0;
+    std::uint64_t mMaxClones = 64;
+    std::uint64_t mMaxSpecializations = 0;
+    bool mTimeReport = false;
+    std::string mTraceFile{};
+    std::string mStatsFile{};
+    bool mDebugInfo = false;
+    bool mPerf = false;
+    bool mProfile = false;
+    std::string mCallGraphFile{};
+    HHardwareCounters mHardwareCounters = HHardwareCounters::None;
+    std::string mRemarksFile{};
 };
 } // namespace hannac
-#endif
\ No newline at end of file
+#endif
@@ -2,37 +2,1062 @@
 #define JIT_HPP
 
 // llvm includes.
+#include "llvm/ADT/FunctionExtras.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/Shared/ExecutorSymbolDef.h"
+#include "llvm/ExecutionEngine/Orc/TaskDispatch.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Transforms/Utils/FunctionComparator.h"
+
+// hannac includes.
+#include "GlobalSettings.hpp"
+#include "ObjectCache.hpp"
+#include "PerfCounters.hpp"
+#include "PerfMap.hpp"
+#include "Profiler.hpp"
+#include "Registry.hpp"
+#include "Remarks.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
 
 // stdlib includes.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
 #include <memory> // unique_ptr
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace hannac
 {
+class HCompilationContext;
+
 namespace jit
 {
+// Generates the code of a method specialization into the module of a compilation context.
+// Called again if the code of an evicted specialization is needed once more.
+using HMethodGenerator = llvm::unique_function<llvm::Error(HCompilationContext &)>;
+
+// Opens a compilation context, runs the given code generation on it and hands over the module generated.
+using HModuleGenerator = llvm::unique_function<llvm::Expected<llvm::orc::ThreadSafeModule>(
+    llvm::function_ref<llvm::Error(HCompilationContext &)>)>;
 
-class JITSingelton final
+// Prefix of the call counter generated next to a method specialization if the code budget is limited or hot methods
+// are tiered up.
+inline constexpr char const *HCallCounterPrefix = "__hanna_calls.";
+
+// Suffix of the fully optimized body of a hot method specialization.
+inline constexpr char const *HHotSuffix = ".hot";
+
+// Materializes a batch of method specializations in one module.
+// Code generation only happens once the JIT actually needs one of the symbols, i.e. when a lazy stub is called.
+class HMethodMaterializationUnit final : public llvm::orc::MaterializationUnit
 {
   public:
-    static JITSingelton &get_jit()
+    using Materializer = llvm::unique_function<void(std::unique_ptr<llvm::orc::MaterializationResponsibility>)>;
+
+    HMethodMaterializationUnit(llvm::orc::SymbolFlagsMap symbols, Materializer materializer)
+        : llvm::orc::MaterializationUnit(Interface(std::move(symbols), nullptr)), mMaterializer(std::move(materializer))
+    {
+    }
+
+    llvm::StringRef getName() const override
+    {
+        return "HMethodMaterializationUnit";
+    }
+
+    void materialize(std::unique_ptr<llvm::orc::MaterializationResponsibility> responsibility) override
     {
-        static JITSingelton jit = JITSingelton::make_jit();
-        return jit;
+        mMaterializer(std::move(responsibility));
     }
 
+  private:
+    void discard(const llvm::orc::JITDylib &lib, const llvm::orc::SymbolStringPtr &name) override
+    {
+    }
+
+    Materializer mMaterializer;
+};
+
+// Called by lazy stubs if their method could not be materialized.
+inline void handle_lazy_call_through_error()
+{
+    std::cerr << "ERROR: Unable to generate code for called method." << std::endl;
+    std::exit(1);
+}
+
+// Runs ORC tasks, e.g. materializations, on a thread pool with a fixed number of compile threads.
+class HTaskDispatcher final : public llvm::orc::TaskDispatcher
+{
+  public:
+    HTaskDispatcher(unsigned jobs, bool trace) : mPool(llvm::hardware_concurrency(jobs)), mTrace(trace)
+    {
+    }
+
+    void dispatch(std::unique_ptr<llvm::orc::Task> task) override
+    {
+        // The pool only accepts copyable functions.
+        // Pool threads live until the JIT is gone, their spans are handed over after every task.
+        std::shared_ptr<llvm::orc::Task> sharedTask = std::move(task);
+        mPool.async([sharedTask, trace = mTrace]() {
+            if (trace)
+                start_thread_trace();
+            sharedTask->run();
+            if (trace)
+                finish_thread_trace();
+        });
+    }
+
+    void shutdown() override
+    {
+        mPool.wait();
+    }
+
+  private:
+    llvm::DefaultThreadPool mPool;
+    bool mTrace;
+};
+
+// Compiles modules to objects with another compiler and accounts the time to code generation.
+class HTimedCompiler final : public llvm::orc::IRCompileLayer::IRCompiler
+{
+  public:
+    HTimedCompiler(std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler> compiler, HTimeReport &timeReport)
+        : IRCompiler(compiler->getManglingOptions()), mCompiler(std::move(compiler)), mTimeReport(timeReport)
+    {
+    }
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module &module) override
+    {
+        HPhaseScope scope(mTimeReport, HPhase::Codegen, "Codegen", module.getName());
+        return (*mCompiler)(module);
+    }
+
+  private:
+    std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler> mCompiler;
+    HTimeReport &mTimeReport;
+};
+
+// JIT dynamic libraries holding the code of one session.
+// <name> holds the lazy method stubs and all modules added, <name.implementation> the method bodies. Method bodies
+// resolve calls against the stubs, so callees stay lazy as well.
+// A library can link against another library, e.g. a program against a shared method library. Symbols of the other
+// library are visible but remain owned by it, so removing a library never touches shared code.
+//
+// Registering a method only creates its stub. Once the body is looked up, it is generated together with other
+// registered but not yet generated methods, up to the batch size, into one module, so emission, relocation and symbol
+// table work is paid once per batch. Methods registered while the batch is generated, e.g. callees, join it as long as
+// there is room. Every batch has its own resource tracker. Methods of a batch with identical bodies are folded, all but
+// one become aliases of it.
+//
+// With a code budget, the generated code counts its calls and the least recently used batches are evicted once the
+// resident code exceeds the budget. Their stubs are pointed back to the lazy call-through trampoline, so the next call
+// generates the bodies again (or loads them from the object cache).
+//
+// With a tier-up threshold, a background thread watches the call counters. A method called at least threshold times
+// is generated once more, optimized with the full -O3 pipeline using its call count as entry count and compiled at the
+// highest code generation level. Its stub is then pointed to the optimized body. The first body stays loaded, frames
+// still running it return normally.
+class HJITLibrary final
+{
+  public:
+    HJITLibrary(llvm::orc::ExecutionSession &executionSession, llvm::DataLayout const &dataLayout,
+                llvm::orc::IRLayer &compilationLayer, llvm::orc::IRLayer &hotCompilationLayer,
+                llvm::orc::LazyCallThroughManager &lazyCallThroughManager,
+                std::unique_ptr<llvm::orc::IndirectStubsManager> indirectStubsManager, llvm::orc::JITDylib &lib,
+                llvm::orc::JITDylib &implLib, HModuleGenerator moduleGenerator, HTimeReport &timeReport,
+                HRunStats &runStats, std::uint64_t batchSize, std::uint64_t codeBudget, std::uint64_t tierUpThreshold,
+                llvm::unique_function<void()> unregister)
+        : mExecutionSession(executionSession), mDataLayout(dataLayout), mCompilationLayer(compilationLayer),
+          mHotCompilationLayer(hotCompilationLayer), mLazyCallThroughManager(lazyCallThroughManager),
+          mIndirectStubsManager(std::move(indirectStubsManager)), mLib(lib), mImplLib(implLib),
+          mModuleGenerator(std::move(moduleGenerator)), mTimeReport(timeReport), mRunStats(runStats),
+          mBatchSize(batchSize == 0 ? 1 : batchSize), mCodeBudget(codeBudget), mTierUpThreshold(tierUpThreshold),
+          mUnregister(std::move(unregister))
+    {
+        mImplLib.addGenerator(std::make_unique<HMethodDefinitionGenerator>(*this));
+        if (mTierUpThreshold > 0)
+            mTierUpThread = std::thread([this]() { run_tier_up(); });
+    }
+
+    HJITLibrary(const HJITLibrary &) = delete;
+    HJITLibrary &operator=(const HJITLibrary &) = delete;
+
+    ~HJITLibrary()
+    {
+        if (auto err = remove())
+            mExecutionSession.reportError(std::move(err));
+    }
+
+    llvm::orc::JITDylib &get_dylib() noexcept
+    {
+        return mLib;
+    }
+
+    std::string const &get_name() const noexcept
+    {
+        return mLib.getName();
+    }
+
+    // Make the symbols of base visible to the code in this library.
+    void link_against(HJITLibrary &base)
+    {
+        mLib.addToLinkOrder(base.mLib, llvm::orc::JITDylibLookupFlags::MatchExportedSymbolsOnly);
+        mImplLib.addToLinkOrder(base.mLib, llvm::orc::JITDylibLookupFlags::MatchExportedSymbolsOnly);
+    }
+
+    llvm::orc::ResourceTrackerSP create_ressource_tracker()
+    {
+        return create_tracker(mLib);
+    }
+
+    // Remove the code of a tracker created by create_ressource_tracker.
+    llvm::Error remove_ressource_tracker(llvm::orc::ResourceTrackerSP const &ressourceTracker)
+    {
+        return remove_tracker(ressourceTracker);
+    }
+
+    llvm::Error add_module(llvm::orc::ThreadSafeModule threadSafeModule,
+                           llvm::orc::ResourceTrackerSP ressourceTracker = nullptr)
+    {
+        ressourceTracker = ressourceTracker == nullptr ? mLib.getDefaultResourceTracker() : ressourceTracker;
+        mRunStats.mModules++;
+        return mCompilationLayer.add(ressourceTracker, std::move(threadSafeModule));
+    }
+
+    // Register a lazily compiled method specialization.
+    // Calls to name go through a stub which generates and compiles the method on first call.
+    llvm::Error add_lazy_method(std::string const &name, HMethodGenerator generator)
+    {
+        auto symbol = mangle(name);
+        {
+            std::lock_guard<std::mutex> lock(mMethodsMutex);
+            auto [entry, inserted] = mMethods.try_emplace((*symbol).str());
+            if (!inserted)
+                return llvm::Error::success();
+
+            auto &method = entry->second;
+            method.mName = name;
+            method.mGenerator = std::move(generator);
+            method.mPending = true;
+            mPending.push_back(&method);
+        }
+
+        llvm::orc::SymbolAliasMap aliases;
+        aliases[symbol] = {symbol, llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable};
+        return mLib.define(
+            llvm::orc::lazyReexports(mLazyCallThroughManager, *mIndirectStubsManager, mImplLib, std::move(aliases)));
+    }
+
+    // Compile the bodies of registered method specializations now.
+    // ORC dispatches every batch as its own materialization task, so batches are compiled in parallel.
+    llvm::Error compile_methods(std::vector<std::string> const &names)
+    {
+        if (names.empty())
+            return llvm::Error::success();
+
+        llvm::orc::SymbolLookupSet symbols;
+        for (auto const &name : names)
+            symbols.add(mangle(name));
+
+        return mExecutionSession
+            .lookup({{&mImplLib, llvm::orc::JITDylibLookupFlags::MatchAllSymbols}}, std::move(symbols))
+            .takeError();
+    }
+
+    // Look up the compiled body of a registered method specialization, compiling it if necessary.
+    llvm::Expected<llvm::orc::ExecutorAddr> lookup_method(std::string const &name)
+    {
+        auto symbol =
+            mExecutionSession.lookup({{&mImplLib, llvm::orc::JITDylibLookupFlags::MatchAllSymbols}}, mangle(name));
+        if (!symbol)
+            return symbol.takeError();
+
+        return symbol->getAddress();
+    }
+
+    // Addresses of compiled method specializations, shared by all threads requesting code.
+    HCompileOnceRegistry<llvm::orc::ExecutorAddr> &get_specializations() noexcept
+    {
+        return mSpecializations;
+    }
+
+    // Number of method specializations compiled into this library, recompilations after eviction included.
+    std::uint64_t get_compiled_methods() const noexcept
+    {
+        return mCompiledMethods;
+    }
+
+    // Number of modules the method specializations were compiled in.
+    std::uint64_t get_compiled_modules() const noexcept
+    {
+        return mCompiledModules;
+    }
+
+    // Number of method specializations recompiled with the full optimization pipeline.
+    std::uint64_t get_tiered_up_methods() const noexcept
+    {
+        return mTieredUpMethods;
+    }
+
+    // Number of method specializations folded into an identical body of their batch.
+    std::uint64_t get_merged_methods() const noexcept
+    {
+        return mMergedMethods;
+    }
+
+    // Estimated code size saved by folding identical bodies in bytes.
+    std::uint64_t get_merged_size()
+    {
+        std::lock_guard<std::mutex> lock(mMethodsMutex);
+        return mMergedSize;
+    }
+
+    // Number of method bodies evicted to stay within the code budget.
+    std::uint64_t get_evicted_methods() const noexcept
+    {
+        return mEvictedMethods;
+    }
+
+    // Size of the method bodies currently loaded in bytes.
+    std::uint64_t get_resident_size()
+    {
+        std::lock_guard<std::mutex> lock(mMethodsMutex);
+        return mResidentSize;
+    }
+
+    // Called by the object layer once the object of a module of this library is loaded.
+    // counters holds the load addresses of the call counters defined by the object.
+    void notify_loaded(llvm::orc::SymbolFlagsMap const &symbols, std::uint64_t size,
+                       std::map<std::string, std::uint64_t> const &counters)
+    {
+        std::lock_guard<std::mutex> lock(mMethodsMutex);
+        std::vector<Method *> loaded;
+        for (auto const &[symbol, flags] : symbols)
+        {
+            auto name = (*symbol).str();
+            auto method = mMethods.find(name);
+            if (method != mMethods.end() && !method->second.mResident)
+            {
+                loaded.push_back(&method->second);
+                continue;
+            }
+
+            // Optimized body of a hot method, it is evicted together with the method.
+            auto suffix = std::string(HHotSuffix);
+            if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            {
+                method = mMethods.find(name.substr(0, name.size() - suffix.size()));
+                if (method != mMethods.end() && method->second.mResident)
+                {
+                    method->second.mSize += size;
+                    mResidentSize += size;
+                    return;
+                }
+            }
+        }
+
+        for (auto method : loaded)
+        {
+            auto counter = counters.find((*mangle(HCallCounterPrefix + method->mName)).str());
+            if (counter != counters.end())
+                method->mCounter = reinterpret_cast<std::atomic<std::uint64_t> *>(counter->second);
+        }
+
+        // Folded methods cost no code, estimate their size by the average body.
+        auto merged = std::count_if(loaded.begin(), loaded.end(), [](Method *method) { return method->mMerged; });
+        if (merged > 0 && static_cast<std::size_t>(merged) < loaded.size())
+            mMergedSize += size / (loaded.size() - merged) * merged;
+
+        // The object is shared by the batch, every method accounts for its part.
+        for (std::size_t i = 0; i < loaded.size(); i++)
+        {
+            // Freshly compiled code counts as used.
+            loaded[i]->mResident = true;
+            loaded[i]->mSize = size / loaded.size() + (i == 0 ? size % loaded.size() : 0);
+            loaded[i]->mLastUse = mTick;
+        }
+        if (!loaded.empty())
+            mResidentSize += size;
+    }
+
+    // Evict the least recently used batches until the resident code fits into the code budget.
+    // A method counts as used if its call counter changed since the previous call of this function, a batch if any
+    // of its methods did. Batches of methods being tiered up stay, the optimized body uses their call counters.
+    // Bodies are unloaded, so this must only be called while no code of this library runs, e.g. between two
+    // statements.
+    llvm::Error evict_cold_methods()
+    {
+        if (mCodeBudget == 0)
+            return llvm::Error::success();
+
+        std::lock_guard<std::mutex> lock(mMethodsMutex);
+        mTick++;
+
+        // Batches by their resource tracker.
+        std::map<llvm::orc::ResourceTracker *, std::pair<std::uint64_t, std::vector<Method *>>> batches;
+        std::set<llvm::orc::ResourceTracker *> tieringUp;
+        for (auto &[symbol, method] : mMethods)
+        {
+            if (!method.mResident)
+                continue;
+
+            auto calls = method.mCounter != nullptr ? method.mCounter->load(std::memory_order_relaxed) : 0;
+            if (calls != method.mSampledCalls)
+            {
+                method.mSampledCalls = calls;
+                method.mLastUse = mTick;
+            }
+
+            auto &batch = batches[method.mTracker.get()];
+            batch.first = std::max(batch.first, method.mLastUse);
+            batch.second.push_back(&method);
+            if (method.mTieringUp)
+                tieringUp.insert(method.mTracker.get());
+        }
+
+        std::vector<std::pair<std::uint64_t, std::vector<Method *>>> coldest;
+        for (auto &[tracker, batch] : batches)
+        {
+            if (tieringUp.count(tracker) == 0)
+                coldest.push_back(std::move(batch));
+        }
+        std::stable_sort(coldest.begin(), coldest.end(),
+                         [](auto const &a, auto const &b) { return a.first < b.first; });
+        for (auto const &[lastUse, methods] : coldest)
+        {
+            if (mResidentSize <= mCodeBudget)
+                break;
+            if (auto error = evict(methods))
+                return error;
+        }
+
+        return llvm::Error::success();
+    }
+
+    llvm::orc::ExecutorSymbolDef find_symbol(std::string name)
+    {
+        static llvm::ExitOnError err;
+        auto res = err(mExecutionSession.lookup({&mLib}, mangle(name)));
+
+        return res;
+    }
+
+    // Recompile the methods called at least tier-up threshold times with the full optimization pipeline and point
+    // their stubs to the optimized bodies. Called periodically by the tier-up thread.
+    llvm::Error tier_up()
+    {
+        if (mTierUpThreshold == 0)
+            return llvm::Error::success();
+
+        // One pass at a time, a method is never tiered up twice.
+        std::lock_guard<std::mutex> pass(mTierUpPassMutex);
+        std::vector<Method *> hot;
+        {
+            std::lock_guard<std::mutex> lock(mMethodsMutex);
+            for (auto &[symbol, method] : mMethods)
+            {
+                if (method.mResident && method.mHotTracker == nullptr && method.mCounter != nullptr &&
+                    method.mCounter->load(std::memory_order_relaxed) >= mTierUpThreshold)
+                    hot.push_back(&method);
+            }
+        }
+
+        llvm::Error result = llvm::Error::success();
+        for (auto method : hot)
+        {
+            if (auto error = tier_up(*method))
+                result = llvm::joinErrors(std::move(result), std::move(error));
+        }
+
+        return result;
+    }
+
+    // Remove all code of this library from the JIT.
+    llvm::Error remove()
+    {
+        if (mRemoved)
+            return llvm::Error::success();
+        mRemoved = true;
+        mUnregister();
+
+        // No more tier-up once the code is gone.
+        if (mTierUpThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mTierUpMutex);
+                mStopTierUp = true;
+            }
+            mTierUpCondition.notify_all();
+            mTierUpThread.join();
+        }
+
+        if (auto err = mLib.getDefaultResourceTracker()->remove())
+            return err;
+        if (auto err = mImplLib.getDefaultResourceTracker()->remove())
+            return err;
+
+        return mExecutionSession.removeJITDylibs({&mImplLib, &mLib});
+    }
+
+  private:
+    // Method specialization registered in this library.
+    struct Method
+    {
+        std::string mName{};
+        HMethodGenerator mGenerator{};
+        // Registered but not defined in the implementation dylib, i.e. not generated yet or evicted.
+        bool mPending = false;
+        // Tracker of the batch holding the current body, if any.
+        llvm::orc::ResourceTrackerSP mTracker{};
+        // Tracker of the optimized body of a hot method, if any.
+        llvm::orc::ResourceTrackerSP mHotTracker{};
+        bool mResident = false;
+        // An optimized body is being generated, it uses the call counter of the current one.
+        bool mTieringUp = false;
+        // The body is an alias of an identical body of the batch.
+        bool mMerged = false;
+        std::uint64_t mSize = 0;
+
+        // Usage tracking.
+        std::atomic<std::uint64_t> *mCounter = nullptr;
+        std::uint64_t mSampledCalls = 0;
+        std::uint64_t mLastUse = 0;
+    };
+
+    // Defines the bodies of registered methods when they are looked up in the implementation dylib.
+    class HMethodDefinitionGenerator final : public llvm::orc::DefinitionGenerator
+    {
+      public:
+        explicit HMethodDefinitionGenerator(HJITLibrary &library) : mLibrary(library)
+        {
+        }
+
+        llvm::Error tryToGenerate(llvm::orc::LookupState &, llvm::orc::LookupKind, llvm::orc::JITDylib &,
+                                  llvm::orc::JITDylibLookupFlags, llvm::orc::SymbolLookupSet const &symbols) override
+        {
+            return mLibrary.define_methods(symbols);
+        }
+
+      private:
+        HJITLibrary &mLibrary;
+    };
+
+    // Define batches for the pending methods among symbols.
+    llvm::Error define_methods(llvm::orc::SymbolLookupSet const &symbols)
+    {
+        std::lock_guard<std::mutex> lock(mMethodsMutex);
+        std::vector<Method *> requested;
+        for (auto const &[symbol, flags] : symbols)
+        {
+            auto method = mMethods.find((*symbol).str());
+            if (method != mMethods.end() && method->second.mPending)
+                requested.push_back(&method->second);
+        }
+
+        for (std::size_t first = 0; first < requested.size(); first += mBatchSize)
+        {
+            auto last = std::min<std::size_t>(first + mBatchSize, requested.size());
+            std::vector<Method *> batch(requested.begin() + first, requested.begin() + last);
+            for (auto method : batch)
+                method->mPending = false;
+
+            // The last batch is filled up with methods registered but not requested yet.
+            if (last == requested.size())
+                take_pending(batch);
+
+            auto tracker = create_tracker(mImplLib);
+            auto symbolFlags = get_symbol_flags(batch, tracker);
+            if (auto error = mImplLib.define(
+                    std::make_unique<HMethodMaterializationUnit>(
+                        std::move(symbolFlags),
+                        [this, batch](std::unique_ptr<llvm::orc::MaterializationResponsibility> responsibility) {
+                            materialize(std::move(responsibility), batch);
+                        }),
+                    tracker))
+                return error;
+        }
+
+        return llvm::Error::success();
+    }
+
+    // Move pending methods into batch while it has room. Requires mMethodsMutex.
+    void take_pending(std::vector<Method *> &batch)
+    {
+        for (auto method : mPending)
+        {
+            if (batch.size() >= mBatchSize)
+                break;
+            if (!method->mPending)
+                continue;
+
+            method->mPending = false;
+            batch.push_back(method);
+        }
+        auto generated = [](Method *method) { return !method->mPending; };
+        mPending.erase(std::remove_if(mPending.begin(), mPending.end(), generated), mPending.end());
+    }
+
+    // Symbols a batch defines. Requires mMethodsMutex.
+    llvm::orc::SymbolFlagsMap get_symbol_flags(std::vector<Method *> const &batch,
+                                               llvm::orc::ResourceTrackerSP const &tracker)
+    {
+        llvm::orc::SymbolFlagsMap symbols;
+        for (auto method : batch)
+        {
+            method->mTracker = tracker;
+            symbols[mangle(method->mName)] = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+            if (count_calls())
+                symbols[mangle(HCallCounterPrefix + method->mName)] = llvm::JITSymbolFlags::Exported;
+        }
+
+        return symbols;
+    }
+
+    // Generate a batch into one module and hand it to the compile layer.
+    void materialize(std::unique_ptr<llvm::orc::MaterializationResponsibility> responsibility,
+                     std::vector<Method *> batch)
+    {
+        auto module = mModuleGenerator([&](HCompilationContext &ctx) -> llvm::Error {
+            for (std::size_t i = 0; i < batch.size(); i++)
+            {
+                if (auto error = batch[i]->mGenerator(ctx))
+                    return error;
+                mCompiledMethods++;
+
+                // Methods registered meanwhile, e.g. callees, join the batch while it has room.
+                if (i + 1 == batch.size() && batch.size() < mBatchSize)
+                {
+                    std::lock_guard<std::mutex> lock(mMethodsMutex);
+                    auto size = batch.size();
+                    take_pending(batch);
+                    std::vector<Method *> joined(batch.begin() + size, batch.end());
+                    if (joined.empty())
+                        continue;
+
+                    if (auto error = responsibility->defineMaterializing(
+                            get_symbol_flags(joined, batch.front()->mTracker)))
+                    {
+                        llvm::consumeError(std::move(error));
+                        for (auto method : joined)
+                        {
+                            method->mPending = true;
+                            mPending.push_back(method);
+                        }
+                        batch.resize(size);
+                    }
+                }
+            }
+
+            return llvm::Error::success();
+        });
+        if (!module)
+        {
+            responsibility->getExecutionSession().reportError(module.takeError());
+            responsibility->failMaterialization();
+            return;
+        }
+
+        if (batch.size() > 1)
+        {
+            std::vector<std::string> merged;
+            module->withModuleDo([&merged](llvm::Module &mod) { merged = merge_identical_functions(mod); });
+            mMergedMethods += merged.size();
+
+            std::lock_guard<std::mutex> lock(mMethodsMutex);
+            for (auto method : batch)
+                method->mMerged = std::find(merged.begin(), merged.end(), method->mName) != merged.end();
+        }
+
+        // Calls of folded methods count for the body they share, in its counter.
+        if (count_calls())
+        {
+            for (auto method : batch)
+                count_calls(*module, method->mName);
+            module->withModuleDo([&batch](llvm::Module &mod) {
+                for (auto method : batch)
+                    share_call_counter(mod, method->mName);
+            });
+        }
+        mCompiledModules++;
+        mRunStats.mModules++;
+
+        // Linking is what remains after code generation.
+        HPhaseScope scope(mTimeReport, HPhase::Link, "Emit batch", batch.front()->mName);
+        mCompilationLayer.emit(std::move(responsibility), std::move(*module));
+    }
+
+    // Fold functions with identical bodies, all but the first become aliases of it.
+    // Candidates are bucketed by the structural hash of their bodies and compared exactly with the function comparator
+    // MergeFunctions uses. Returns the names of the folded functions.
+    static std::vector<std::string> merge_identical_functions(llvm::Module &mod)
+    {
+        // The AST hash tells methods with identical bodies apart and the pipeline may differ, leave the cache key
+        // attributes out of the comparison.
+        std::map<llvm::Function *, std::vector<llvm::Attribute>> keyAttributes;
+        std::map<std::uint64_t, std::vector<llvm::Function *>> buckets;
+        for (auto &func : mod.functions())
+        {
+            if (func.isDeclaration())
+                continue;
+
+            for (auto attribute : {HASTHashAttribute, HOptTierAttribute})
+            {
+                if (!func.hasFnAttribute(attribute))
+                    continue;
+                keyAttributes[&func].push_back(func.getFnAttribute(attribute));
+                func.removeFnAttr(attribute);
+            }
+            buckets[llvm::StructuralHash(func)].push_back(&func);
+        }
+
+        std::vector<std::string> merged;
+        llvm::GlobalNumberState globalNumbers;
+        for (auto &[hash, funcs] : buckets)
+        {
+            for (std::size_t i = 0; i < funcs.size(); i++)
+            {
+                for (std::size_t j = i + 1; funcs[i] != nullptr && j < funcs.size(); j++)
+                {
+                    if (funcs[j] == nullptr || llvm::FunctionComparator(funcs[i], funcs[j], &globalNumbers).compare())
+                        continue;
+
+                    auto duplicate = funcs[j];
+                    funcs[j] = nullptr;
+                    merged.push_back(duplicate->getName().str());
+                    keyAttributes.erase(duplicate);
+
+                    auto alias = llvm::GlobalAlias::create(duplicate->getLinkage(), "", funcs[i]);
+                    alias->takeName(duplicate);
+                    duplicate->replaceAllUsesWith(alias);
+                    duplicate->eraseFromParent();
+                }
+            }
+        }
+
+        for (auto &[func, attributes] : keyAttributes)
+            for (auto const &attribute : attributes)
+                func->addFnAttr(attribute);
+
+        return merged;
+    }
+
+    // Whether the generated code counts calls.
+    bool count_calls() const noexcept
+    {
+        return mCodeBudget > 0 || mTierUpThreshold > 0;
+    }
+
+    // Let the generated code of a method count its calls.
+    // The counter is sampled only, so a racy increment is good enough and costs no atomic RMW. The counter is defined
+    // next to the method, unless the address of an existing one is given.
+    static void count_calls(llvm::Module &mod, std::string const &name, std::atomic<std::uint64_t> *existing = nullptr)
+    {
+        auto func = mod.getFunction(name);
+        if (func == nullptr || func->isDeclaration())
+            return;
+
+        llvm::IRBuilder<> builder(&*func->getEntryBlock().getFirstInsertionPt());
+        llvm::Value *counter = nullptr;
+        if (existing != nullptr)
+            counter = builder.CreateIntToPtr(builder.getInt64(reinterpret_cast<std::uintptr_t>(existing)),
+                                             builder.getPtrTy());
+        else
+            counter = new llvm::GlobalVariable(mod, builder.getInt64Ty(), false, llvm::GlobalValue::ExternalLinkage,
+                                               builder.getInt64(0), HCallCounterPrefix + name);
+        auto calls = builder.CreateLoad(builder.getInt64Ty(), counter, "calls");
+        calls->setAtomic(llvm::AtomicOrdering::Monotonic);
+        auto store = builder.CreateStore(builder.CreateAdd(calls, builder.getInt64(1)), counter);
+        store->setAtomic(llvm::AtomicOrdering::Monotonic);
+    }
+
+    // Define the counter of a method folded into another one as alias of the counter of the body it shares. Every
+    // method of a batch declares a counter, the folded one has no body to define it with.
+    static void share_call_counter(llvm::Module &mod, std::string const &name)
+    {
+        auto alias = mod.getNamedAlias(name);
+        if (alias == nullptr)
+            return;
+
+        auto counter = mod.getNamedGlobal(HCallCounterPrefix + alias->getAliasee()->getName().str());
+        if (counter != nullptr)
+        {
+            llvm::GlobalAlias::create(counter->getLinkage(), HCallCounterPrefix + name, counter);
+            return;
+        }
+
+        // The body doesn't count its calls, neither does the folded method.
+        auto type = llvm::Type::getInt64Ty(mod.getContext());
+        new llvm::GlobalVariable(mod, type, false, llvm::GlobalValue::ExternalLinkage, llvm::ConstantInt::get(type, 0),
+                                 HCallCounterPrefix + name);
+        return;
+    }
+
+    static void count_calls(llvm::orc::ThreadSafeModule &module, std::string const &name)
+    {
+        module.withModuleDo([&name](llvm::Module &mod) { count_calls(mod, name); });
+    }
+
+    // Run the full optimization pipeline on the module of a hot method.
+    static void optimize_hot(llvm::Module &mod)
+    {
+        llvm::LoopAnalysisManager loopAnalysisManager;
+        llvm::FunctionAnalysisManager funcAnalysisManager;
+        llvm::CGSCCAnalysisManager cgsccAnalysisManager;
+        llvm::ModuleAnalysisManager modAnalysisManager;
+        llvm::PassBuilder passBuilder;
+        passBuilder.registerModuleAnalyses(modAnalysisManager);
+        passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+        passBuilder.registerFunctionAnalyses(funcAnalysisManager);
+        passBuilder.registerLoopAnalyses(loopAnalysisManager);
+        passBuilder.crossRegisterProxies(loopAnalysisManager, funcAnalysisManager, cgsccAnalysisManager,
+                                         modAnalysisManager);
+
+        auto passManager = passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
+        passManager.run(mod, modAnalysisManager);
+    }
+
+    // Generate a hot method again, optimize it fully and point its stub to the optimized body.
+    llvm::Error tier_up(Method &method)
+    {
+        std::atomic<std::uint64_t> *counter = nullptr;
+        std::uint64_t calls = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMethodsMutex);
+            // Evicted since the pass picked it.
+            if (!method.mResident || method.mCounter == nullptr || method.mHotTracker != nullptr)
+                return llvm::Error::success();
+
+            // The current body and its counter stay loaded until the optimized body is installed.
+            counter = method.mCounter;
+            calls = counter->load(std::memory_order_relaxed);
+            method.mTieringUp = true;
+        }
+
+        auto hot = compile_hot(method, counter, calls);
+
+        std::lock_guard<std::mutex> lock(mMethodsMutex);
+        method.mTieringUp = false;
+        if (!hot)
+            return hot.takeError();
+
+        auto &[hotTracker, address] = *hot;
+        if (auto error = mIndirectStubsManager->updatePointer((*mangle(method.mName)).str(), address))
+            return error;
+        method.mHotTracker = hotTracker;
+        mTieredUpMethods++;
+
+        return llvm::Error::success();
+    }
+
+    // Compile the optimized body of a hot method called calls times so far. Returns its tracker and address.
+    llvm::Expected<std::pair<llvm::orc::ResourceTrackerSP, llvm::orc::ExecutorAddr>>
+    compile_hot(Method &method, std::atomic<std::uint64_t> *counter, std::uint64_t calls)
+    {
+        auto module = mModuleGenerator([&method](HCompilationContext &ctx) { return method.mGenerator(ctx); });
+        if (!module)
+            return module.takeError();
+
+        // The optimized body keeps counting calls in the counter of the first body. It is evicted together with the
+        // first body, objects of hot methods aren't cached, so the address can be used directly.
+        auto hotName = method.mName + HHotSuffix;
+        module->withModuleDo([&](llvm::Module &mod) {
+            auto func = mod.getFunction(method.mName);
+            if (func == nullptr)
+                return;
+
+            func->setName(hotName);
+            func->setEntryCount(calls);
+            optimize_hot(mod);
+            count_calls(mod, hotName, counter);
+        });
+
+        auto hotTracker = create_tracker(mImplLib);
+        mRunStats.mModules++;
+        if (auto error = mHotCompilationLayer.add(hotTracker, std::move(*module)))
+            return std::move(error);
+        auto address =
+            mExecutionSession.lookup({{&mImplLib, llvm::orc::JITDylibLookupFlags::MatchAllSymbols}}, mangle(hotName));
+        if (!address)
+        {
+            llvm::consumeError(remove_tracker(hotTracker));
+            return address.takeError();
+        }
+
+        return std::pair<llvm::orc::ResourceTrackerSP, llvm::orc::ExecutorAddr>(hotTracker, address->getAddress());
+    }
+
+    // Body of the tier-up thread.
+    void run_tier_up()
+    {
+        std::unique_lock<std::mutex> lock(mTierUpMutex);
+        while (!mStopTierUp)
+        {
+            mTierUpCondition.wait_for(lock, std::chrono::milliseconds(10));
+            if (mStopTierUp)
+                break;
+
+            lock.unlock();
+            if (auto error = tier_up())
+                mExecutionSession.reportError(std::move(error));
+            lock.lock();
+        }
+    }
+
+    llvm::orc::ResourceTrackerSP create_tracker(llvm::orc::JITDylib &lib)
+    {
+        mRunStats.mTrackersCreated++;
+        return lib.createResourceTracker();
+    }
+
+    llvm::Error remove_tracker(llvm::orc::ResourceTrackerSP const &tracker)
+    {
+        mRunStats.mTrackersRemoved++;
+        return tracker->remove();
+    }
+
+    // Unload the bodies of a batch. Their stubs go through the lazy call-through trampoline again.
+    // Requires mMethodsMutex.
+    llvm::Error evict(std::vector<Method *> const &batch)
+    {
+        for (auto method : batch)
+        {
+            auto symbol = mangle(method->mName);
+            auto stub = (*symbol).str();
+            auto trampoline = mLazyCallThroughManager.getCallThroughTrampoline(
+                mImplLib, symbol, [this, stub](llvm::orc::ExecutorAddr address) {
+                    return mIndirectStubsManager->updatePointer(stub, address);
+                });
+            if (!trampoline)
+                return trampoline.takeError();
+            if (auto error = mIndirectStubsManager->updatePointer(stub, *trampoline))
+                return error;
+        }
+        if (auto error = remove_tracker(batch.front()->mTracker))
+            return error;
+        for (auto method : batch)
+        {
+            if (method->mHotTracker == nullptr)
+                continue;
+            if (auto error = remove_tracker(method->mHotTracker))
+                return error;
+            method->mHotTracker = nullptr;
+        }
+
+        for (auto method : batch)
+        {
+            mResidentSize -= method->mSize;
+            method->mResident = false;
+            method->mSize = 0;
+            method->mTracker = nullptr;
+            method->mCounter = nullptr;
+            method->mSampledCalls = 0;
+            method->mPending = true;
+            mPending.push_back(method);
+            mSpecializations.erase(method->mName);
+            mEvictedMethods++;
+        }
+
+        return llvm::Error::success();
+    }
+
+    llvm::orc::SymbolStringPtr mangle(std::string const &name)
+    {
+        llvm::orc::MangleAndInterner mangler(mExecutionSession, mDataLayout);
+        return mangler(name);
+    }
+
+    llvm::orc::ExecutionSession &mExecutionSession;
+    llvm::DataLayout const &mDataLayout;
+    llvm::orc::IRLayer &mCompilationLayer;
+    // Compiles the optimized bodies of hot methods.
+    llvm::orc::IRLayer &mHotCompilationLayer;
+    llvm::orc::LazyCallThroughManager &mLazyCallThroughManager;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> mIndirectStubsManager;
+
+    // JIT dynamic library.
+    llvm::orc::JITDylib &mLib;
+    // JIT dynamic library holding the method bodies.
+    llvm::orc::JITDylib &mImplLib;
+    bool mRemoved = false;
+
+    HModuleGenerator mModuleGenerator;
+    HTimeReport &mTimeReport;
+    HRunStats &mRunStats;
+    // Maximum number of methods generated into one module.
+    std::uint64_t mBatchSize = 1;
+
+    // Method specializations registered so far, by mangled name.
+    std::map<std::string, Method> mMethods;
+    // Methods waiting for code generation, in registration order.
+    std::vector<Method *> mPending;
+    std::mutex mMethodsMutex;
+    std::atomic<std::uint64_t> mCompiledMethods{0};
+    std::atomic<std::uint64_t> mCompiledModules{0};
+    std::atomic<std::uint64_t> mMergedMethods{0};
+    std::uint64_t mMergedSize = 0;
+
+    // Code budget in bytes, 0 is unlimited.
+    std::uint64_t mCodeBudget = 0;
+    std::uint64_t mResidentSize = 0;
+    std::uint64_t mTick = 0;
+    std::atomic<std::uint64_t> mEvictedMethods{0};
+
+    // Calls after which a method is optimized fully, 0 disables tier-up.
+    std::uint64_t mTierUpThreshold = 0;
+    std::atomic<std::uint64_t> mTieredUpMethods{0};
+
+    llvm::unique_function<void()> mUnregister;
+
+    // Compiled method specializations.
+    HCompileOnceRegistry<llvm::orc::ExecutorAddr> mSpecializations;
+
+    // Started last, it uses everything above.
+    std::mutex mTierUpPassMutex;
+    std::mutex mTierUpMutex;
+    std::condition_variable mTierUpCondition;
+    bool mStopTierUp = false;
+    std::thread mTierUpThread;
+};
+
+// JIT shared by a library session and all program sessions linked against it.
+// Holds the execution session and the compilation pipeline, the code itself lives in HJITLibrary instances.
+class HJIT final
+{
+  public:
     // Create JIT instance.
-    static JITSingelton make_jit()
+    static std::unique_ptr<HJIT> make_jit(HSettings const &settings)
     {
         // System setup.
         llvm::InitializeNativeTarget();
@@ -41,13 +1066,29 @@ class JITSingelton final
 
         // Control over process memory.
         static llvm::ExitOnError err;
+        // Materialization tasks run on a thread pool if parallel compilation is requested.
+        std::unique_ptr<llvm::orc::TaskDispatcher> dispatcher;
+        if (settings.get_jobs() > 1)
+            dispatcher = std::make_unique<HTaskDispatcher>(settings.get_jobs(), !settings.get_trace_file().empty());
+
         // Create execution session.
-        auto executionSession =
-            std::make_unique<llvm::orc::ExecutionSession>(err(llvm::orc::SelfExecutorProcessControl::Create()));
+        auto executionSession = std::make_unique<llvm::orc::ExecutionSession>(
+            err(llvm::orc::SelfExecutorProcessControl::Create(nullptr, std::move(dispatcher))));
 
         // Build target machine.
         llvm::orc::JITTargetMachineBuilder targetMachine(
             executionSession->getExecutorProcessControl().getTargetTriple());
+        targetMachine.setCodeGenOptLevel(get_codegen_opt_level(settings.get_opt_level()));
+
+        // Setup persistent object cache.
+        auto cache = std::make_unique<HObjectCache>();
+        cache->set_directory(settings.get_cache_dir());
+        cache->set_max_size(settings.get_cache_size());
+        cache->set_opt_level(settings.get_opt_level());
+        cache->set_fast_math(settings.get_fast_math());
+        cache->set_verbose(settings.get_verbose());
+        cache->set_target(targetMachine.getTargetTriple().str(), targetMachine.getCPU(),
+                          targetMachine.getFeatures().getString());
 
         // Build data layout.
         auto dataLayout = std::make_unique<llvm::DataLayout>(err(targetMachine.getDefaultDataLayoutForTarget()));
@@ -61,18 +1102,69 @@ class JITSingelton final
             objectLayer->setAutoClaimResponsibilityForObjectSymbols(true);
         }
 
+        // Debug info sections are only kept if asked for, debuggers and jitdump read them from the loaded object.
+        if (settings.get_debug_info())
+        {
+            objectLayer->setProcessAllSections(true);
+            objectLayer->registerJITEventListener(*llvm::JITEventListener::createGDBRegistrationListener());
+        }
+
+        // Symbolize JIT code in profilers. jitdump records need an LLVM built with perf support.
+        if (settings.get_perf())
+        {
+            objectLayer->registerJITEventListener(HPerfMapListener::get());
+            if (auto jitdump = llvm::JITEventListener::createPerfJITEventListener())
+                objectLayer->registerJITEventListener(*jitdump);
+            else
+                std::cout << "No jitdump support in this LLVM, only writing " << HPerfMapListener::get_path() << "."
+                          << std::endl;
+        }
+
+        // Time spent per phase.
+        auto timeReport =
+            std::make_unique<HTimeReport>(settings.get_time_report() || !settings.get_stats_file().empty());
+
+        // Hot methods are compiled at the highest level, their objects depend on the process and aren't cached.
+        auto hotTargetMachine = targetMachine;
+        hotTargetMachine.setCodeGenOptLevel(llvm::CodeGenOptLevel::Aggressive);
+        auto hotCompiler = std::make_unique<HTimedCompiler>(
+            std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(hotTargetMachine)), *timeReport);
+        auto hotCompilationLayer =
+            std::make_unique<llvm::orc::IRCompileLayer>(*executionSession, *objectLayer, std::move(hotCompiler));
+
         // Build compilation layer.
         auto compilationLayer = std::make_unique<llvm::orc::IRCompileLayer>(
             *executionSession, *objectLayer,
-            std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(targetMachine)));
+            std::make_unique<HTimedCompiler>(
+                std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(targetMachine), cache.get()),
+                *timeReport));
 
-        // Create lib.
-        auto &lib = executionSession->createBareJITDylib("<main>");
-        lib.addGenerator(
-            err(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(dataLayout->getGlobalPrefix())));
+        // Lazy stubs.
+        auto triple = executionSession->getExecutorProcessControl().getTargetTriple();
+        auto lazyCallThroughManager = err(llvm::orc::createLocalLazyCallThroughManager(
+            triple, *executionSession, llvm::orc::ExecutorAddr::fromPtr(&handle_lazy_call_through_error)));
+        auto indirectStubsManagerBuilder = llvm::orc::createLocalIndirectStubsManagerBuilder(triple);
+
+        return std::unique_ptr<HJIT>(new HJIT(std::move(executionSession), std::move(dataLayout),
+                                              std::move(objectLayer), std::move(cache), std::move(compilationLayer),
+                                              std::move(hotCompilationLayer), std::move(lazyCallThroughManager),
+                                              std::move(indirectStubsManagerBuilder), std::move(timeReport),
+                                              settings));
+    }
 
-        return JITSingelton(std::move(executionSession), std::move(dataLayout), std::move(objectLayer),
-                            std::move(compilationLayer), lib);
+    static llvm::CodeGenOptLevel get_codegen_opt_level(int level) noexcept
+    {
+        switch (level)
+        {
+        case 0:
+            return llvm::CodeGenOptLevel::None;
+        case 1:
+            return llvm::CodeGenOptLevel::Less;
+        case 3:
+            return llvm::CodeGenOptLevel::Aggressive;
+        default:
+            return llvm::CodeGenOptLevel::Default;
+        }
     }
 
     const llvm::DataLayout get_data_layout() const noexcept
@@ -80,57 +1172,175 @@ class JITSingelton final
         return *mDataLayout.get();
     }
 
-    llvm::orc::ResourceTrackerSP create_ressource_tracker()
+    // Create a new library. Its name must be unique within this JIT.
+    // Method bodies are generated into the modules moduleGenerator opens.
+    std::unique_ptr<HJITLibrary> create_library(std::string const &name, HModuleGenerator moduleGenerator)
     {
-        return mLib.createResourceTracker();
+        static llvm::ExitOnError err;
+        auto &lib = mExecutionSession->createBareJITDylib("<" + name + ">");
+        lib.addGenerator(
+            err(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(mDataLayout->getGlobalPrefix())));
+
+        // Method bodies resolve calls against the stubs in lib.
+        auto &implLib = mExecutionSession->createBareJITDylib("<" + name + ".implementation>");
+        implLib.setLinkOrder({{&lib, llvm::orc::JITDylibLookupFlags::MatchExportedSymbolsOnly}}, false);
+
+        auto library = std::make_unique<HJITLibrary>(
+            *mExecutionSession, *mDataLayout, *mCompilationLayer, *mHotCompilationLayer, *mLazyCallThroughManager,
+            mIndirectStubsManagerBuilder(), lib, implLib, std::move(moduleGenerator), *mTimeReport,
+            mRunStats, mSettings.get_batch_size(),
+            mSettings.get_code_budget(), mSettings.get_tier_up_threshold(), [this, &implLib]() {
+                std::lock_guard<std::mutex> lock(mLibrariesMutex);
+                mLibraries.erase(&implLib);
+            });
+        {
+            std::lock_guard<std::mutex> lock(mLibrariesMutex);
+            mLibraries[&implLib] = library.get();
+        }
+
+        return library;
     }
 
-    llvm::Error add_module(llvm::orc::ThreadSafeModule threadSafeModule,
-                           llvm::orc::ResourceTrackerSP ressourceTracker = nullptr)
+    // Unique id for naming libraries.
+    std::uint64_t next_library_id() noexcept
     {
-        ressourceTracker = ressourceTracker == nullptr ? mLib.getDefaultResourceTracker() : ressourceTracker;
-        return mCompilationLayer->add(ressourceTracker, std::move(threadSafeModule));
+        return mLibraryCount++;
     }
 
-    llvm::orc::ExecutorSymbolDef find_symbol(std::string name)
+    HObjectCache &get_cache() noexcept
     {
-        llvm::orc::MangleAndInterner mangler(*mExecutionSession, *mDataLayout);
-        static llvm::ExitOnError err;
-        auto res = err(mExecutionSession->lookup({&mLib}, mangler(name)));
+        return *mCache;
+    }
 
-        return res;
+    // Time spent per phase by all sessions sharing this JIT.
+    HTimeReport &get_time_report() noexcept
+    {
+        return *mTimeReport;
+    }
+
+    // Counters of all sessions sharing this JIT.
+    HRunStats &get_run_stats() noexcept
+    {
+        return mRunStats;
     }
 
-    JITSingelton(const JITSingelton &) = delete;
-    JITSingelton &operator=(const JITSingelton &) = delete;
+    // Profile of the hanna code run by all sessions sharing this JIT.
+    HProfiler &get_profiler() noexcept
+    {
+        return mProfiler;
+    }
 
-  private:
-    JITSingelton(std::unique_ptr<llvm::orc::ExecutionSession> executionSession,
-                 std::unique_ptr<llvm::DataLayout> dataLayout,
-                 std::unique_ptr<llvm::orc::RTDyldObjectLinkingLayer> objectLayer,
-                 std::unique_ptr<llvm::orc::IRCompileLayer> compLayer, llvm::orc::JITDylib &lib)
-        : mExecutionSession(std::move(executionSession)), mDataLayout(std::move(dataLayout)),
-          mObjectLayer(std::move(objectLayer)), mCompilationLayer(std::move(compLayer)), mLib(lib)
+    // Hardware events of the main statements run by all sessions sharing this JIT.
+    HCounterReport &get_counter_report() noexcept
     {
+        return mCounterReport;
     }
 
-    ~JITSingelton()
+    // Optimization remarks about the code of all sessions sharing this JIT.
+    HRemarks &get_remarks() noexcept
+    {
+        return mRemarks;
+    }
+
+    HJIT(const HJIT &) = delete;
+    HJIT &operator=(const HJIT &) = delete;
+
+    ~HJIT()
     {
         if (auto err = mExecutionSession->endSession())
             mExecutionSession->reportError(std::move(err));
     }
 
+  private:
+    HJIT(std::unique_ptr<llvm::orc::ExecutionSession> executionSession, std::unique_ptr<llvm::DataLayout> dataLayout,
+         std::unique_ptr<llvm::orc::RTDyldObjectLinkingLayer> objectLayer, std::unique_ptr<HObjectCache> cache,
+         std::unique_ptr<llvm::orc::IRCompileLayer> compLayer,
+         std::unique_ptr<llvm::orc::IRCompileLayer> hotCompLayer,
+         std::unique_ptr<llvm::orc::LazyCallThroughManager> lazyCallThroughManager,
+         std::function<std::unique_ptr<llvm::orc::IndirectStubsManager>()> indirectStubsManagerBuilder,
+         std::unique_ptr<HTimeReport> timeReport, HSettings const &settings)
+        : mExecutionSession(std::move(executionSession)), mDataLayout(std::move(dataLayout)),
+          mTimeReport(std::move(timeReport)), mObjectLayer(std::move(objectLayer)), mCache(std::move(cache)),
+          mCompilationLayer(std::move(compLayer)), mHotCompilationLayer(std::move(hotCompLayer)),
+          mLazyCallThroughManager(std::move(lazyCallThroughManager)),
+          mIndirectStubsManagerBuilder(std::move(indirectStubsManagerBuilder)), mSettings(settings),
+          mProfiler(settings.get_profile() || !settings.get_call_graph_file().empty() ||
+                        settings.get_hardware_counters() == HHardwareCounters::Methods,
+                    !settings.get_call_graph_file().empty(),
+                    settings.get_hardware_counters() == HHardwareCounters::Methods),
+          mCounterReport(settings.get_hardware_counters() != HHardwareCounters::None),
+          mRemarks(!settings.get_remarks_file().empty())
+    {
+        // Account the size of every loaded method body to its library and find its call counter.
+        mObjectLayer->setNotifyLoaded([this](llvm::orc::MaterializationResponsibility &responsibility,
+                                             llvm::object::ObjectFile const &object,
+                                             llvm::RuntimeDyld::LoadedObjectInfo const &info) {
+            std::uint64_t size = 0;
+            for (auto const &section : object.sections())
+            {
+                if (section.isText())
+                    mRunStats.mCodeBytes += section.getSize();
+                else if (section.isData() || section.isBSS())
+                    mRunStats.mDataBytes += section.getSize();
+                else
+                    continue;
+                size += section.getSize();
+            }
+
+            std::map<std::string, std::uint64_t> counters;
+            for (auto const &symbol : object.symbols())
+            {
+                auto name = symbol.getName();
+                auto address = symbol.getAddress();
+                auto section = symbol.getSection();
+                if (!name || !address || !section || *section == object.section_end() ||
+                    !name->contains(HCallCounterPrefix))
+                {
+                    llvm::consumeError(name.takeError());
+                    llvm::consumeError(address.takeError());
+                    llvm::consumeError(section.takeError());
+                    continue;
+                }
+
+                counters[name->str()] = info.getSectionLoadAddress(**section) + *address - (*section)->getAddress();
+            }
+
+            std::lock_guard<std::mutex> lock(mLibrariesMutex);
+            auto library = mLibraries.find(&responsibility.getTargetJITDylib());
+            if (library != mLibraries.end())
+                library->second->notify_loaded(responsibility.getSymbols(), size, counters);
+        });
+    }
+
     // Runnning jit program.
     std::unique_ptr<llvm::orc::ExecutionSession> mExecutionSession;
 
     // Target data layout.
     std::unique_ptr<llvm::DataLayout> mDataLayout;
 
+    // Time spent per phase, the compile layers account to it.
+    std::unique_ptr<HTimeReport> mTimeReport;
+
     std::unique_ptr<llvm::orc::RTDyldObjectLinkingLayer> mObjectLayer;
+    // Persistent object cache used by the compile layer.
+    std::unique_ptr<HObjectCache> mCache;
     std::unique_ptr<llvm::orc::IRCompileLayer> mCompilationLayer;
+    std::unique_ptr<llvm::orc::IRCompileLayer> mHotCompilationLayer;
 
-    // JIT dynamic library.
-    llvm::orc::JITDylib &mLib;
+    // Lazy compilation. Every library gets its own stubs.
+    std::unique_ptr<llvm::orc::LazyCallThroughManager> mLazyCallThroughManager;
+    std::function<std::unique_ptr<llvm::orc::IndirectStubsManager>()> mIndirectStubsManagerBuilder;
+
+    std::atomic<std::uint64_t> mLibraryCount{0};
+    HRunStats mRunStats;
+
+    // Libraries by the dylib holding their method bodies.
+    std::map<llvm::orc::JITDylib *, HJITLibrary *> mLibraries;
+    std::mutex mLibrariesMutex;
+    HSettings mSettings;
+    HProfiler mProfiler;
+    HCounterReport mCounterReport;
+    HRemarks mRemarks;
 };
 } // namespace jit
 } // namespace hannac
@@ -4,6 +4,7 @@
 // stdlib includes
 #include <cctype>
 #include <cstdint>
+#include <filesystem>
 #include <string>
 #include <utility>
 #include <variant>
@@ -64,7 +65,32 @@ struct HLexer final
     {
     }
 
+    // Path of the source file lexed.
+    std::filesystem::path const &get_path() const noexcept
+    {
+        return mParser.get_path();
+    }
+
+    // Line of the token lexed last.
+    unsigned get_line() const noexcept
+    {
+        return mLine;
+    }
+
+    // Tokens lexed so far.
+    std::uint64_t get_token_count() const noexcept
+    {
+        return mTokens;
+    }
+
     HTokenRes get_token()
+    {
+        mTokens++;
+        return lex_token();
+    }
+
+  private:
+    HTokenRes lex_token()
     {
         HToken token;
 
@@ -73,11 +99,13 @@ struct HLexer final
         {
             if (mCurrent == '\n')
             {
+                mLine = mParser.get_line();
                 mCurrent = mParser.read();
                 return {HTokenType::EOL, '\n'};
             }
             mCurrent = mParser.read();
         }
+        mLine = mParser.get_line();
 
         // Handle alphanumeric strings.
         if (mCurrent == EOF)
@@ -130,7 +158,7 @@ struct HLexer final
             while (mCurrent != EOF && mCurrent != '\n' && mCurrent != '\r');
 
             // Skipped comment call this function once again.
-            return get_token();
+            return lex_token();
         }
         else
         {
@@ -140,9 +168,10 @@ struct HLexer final
         }
     }
 
-  private:
     HFileParser mParser;
     char mCurrent = ' ';
+    unsigned mLine = 1;
+    std::uint64_t mTokens = 0;
 };
 } // namespace hannac
 #endif // LEXER_HPP
\ No newline at end of file
@@ -0,0 +1,333 @@
+#ifndef OBJECTCACHE_HPP
+#define OBJECTCACHE_HPP
+
+// llvm includes.
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+// stdlib includes.
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace hannac
+{
+namespace jit
+{
+// Name of the function attribute carrying the hash of the hanna AST a function was generated from.
+inline constexpr char const *HASTHashAttribute = "hanna-ast-hash";
+// Name of the function attribute carrying the optimization pipeline a function was optimized with, see HOptimizer.
+inline constexpr char const *HOptTierAttribute = "hanna-opt-tier";
+
+// Version of the code hannac generates for a hanna AST. Bump it whenever the lowering of the same AST changes, e.g. a
+// new calling convention or instrumentation, so objects cached by an older hannac are never loaded.
+inline constexpr unsigned HCodegenVersion = 1;
+
+// Persistent on-disk cache for compiled objects.
+// Hooked into the IRCompileLayer via the ConcurrentIRCompiler. Every module handed to the JIT is identified by the
+// AST hashes of the functions it defines, their signatures, the signatures of all functions it references, the
+// hannac codegen version, the target, the optimization level and the pipeline of every function. If an object for
+// that key exists on disk, LLVM codegen is skipped entirely.
+class HObjectCache final : public llvm::ObjectCache
+{
+  public:
+    HObjectCache() = default;
+    HObjectCache(const HObjectCache &) = delete;
+    HObjectCache &operator=(const HObjectCache &) = delete;
+
+    // Hash an arbitrary string, e.g. the string representation of a method AST.
+    static std::string hash(std::string const &in)
+    {
+        llvm::MD5 md5;
+        md5.update(in);
+        llvm::MD5::MD5Result result;
+        md5.final(result);
+        return std::string(result.digest().str());
+    }
+
+    // Objects already in the directory count towards the size budget.
+    void set_directory(std::filesystem::path const &dir)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDirectory = dir;
+        mSize = 0;
+        if (!mDirectory.empty())
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(mDirectory, ec);
+            if (ec)
+            {
+                std::cout << "Unable to create object cache directory " << mDirectory << ": " << ec.message()
+                          << std::endl;
+                mDirectory.clear();
+                return;
+            }
+            for (auto const &entry : get_entries())
+                mSize += entry.mSize;
+        }
+    }
+
+    void set_max_size(std::uint64_t bytes) noexcept
+    {
+        mMaxSize = bytes;
+    }
+
+    void set_target(std::string const &triple, std::string const &cpu, std::string const &features)
+    {
+        mTarget = triple + "|" + cpu + "|" + features;
+    }
+
+    void set_opt_level(int level) noexcept
+    {
+        mOptLevel = level;
+    }
+
+    void set_fast_math(bool fastMath) noexcept
+    {
+        mFastMath = fastMath;
+    }
+
+    void set_verbose(int level) noexcept
+    {
+        mVerbose = level;
+    }
+
+    bool enabled() const noexcept
+    {
+        return !mDirectory.empty();
+    }
+
+    // Compute the cache key of a module.
+    // Modules which define functions not generated from a hanna AST are not cacheable.
+    std::optional<std::string> get_key(llvm::Module const &module) const
+    {
+        std::string key{LLVM_VERSION_STRING};
+        key += "|hannac" + std::to_string(HCodegenVersion);
+        key += "|" + mTarget + "|O" + std::to_string(mOptLevel) + (mFastMath ? "|fast-math" : "");
+
+        for (auto const &func : module.functions())
+        {
+            std::string type;
+            llvm::raw_string_ostream typeStream(type);
+            func.getFunctionType()->print(typeStream);
+            typeStream.flush();
+
+            if (func.isDeclaration())
+            {
+                key += "|decl:" + func.getName().str() + ":" + type;
+                continue;
+            }
+
+            if (!func.hasFnAttribute(HASTHashAttribute))
+                return std::nullopt;
+
+            key += "|def:" + func.getName().str() + ":" + type + ":" +
+                   func.getFnAttribute(HASTHashAttribute).getValueAsString().str();
+            if (func.hasFnAttribute(HOptTierAttribute))
+                key += ":" + func.getFnAttribute(HOptTierAttribute).getValueAsString().str();
+
+            // Debug info refers to source lines the AST doesn't know about.
+            if (auto subprogram = func.getSubprogram())
+                key += "|dbg:" + subprogram->getFilename().str() + ":" + std::to_string(subprogram->getLine()) + ":" +
+                       std::to_string(subprogram->getScopeLine());
+        }
+
+        // Functions folded into an identical one.
+        for (auto const &alias : module.aliases())
+            key += "|alias:" + alias.getName().str() + ":" + alias.getAliasee()->getName().str();
+
+        // Globals defined next to the functions, e.g. call counters.
+        for (auto const &global : module.globals())
+        {
+            if (!global.isDeclaration())
+                key += "|global:" + global.getName().str();
+        }
+
+        return hash(key);
+    }
+
+    // Check whether an object for the given module is already cached.
+    bool contains(llvm::Module const &module) const
+    {
+        if (!enabled())
+            return false;
+
+        auto key = get_key(module);
+        if (!key)
+            return false;
+
+        std::error_code ec;
+        return std::filesystem::exists(get_path(*key), ec);
+    }
+
+    // Called by the compiler once an object for a module has been produced.
+    void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override
+    {
+        if (!enabled())
+            return;
+
+        auto key = get_key(*module);
+        if (!key)
+            return;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // Write to a temporary file first, so concurrent readers never see partial objects.
+        auto path = get_path(*key);
+        auto tmpPath = path;
+        tmpPath += ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary);
+            if (!file.is_open())
+                return;
+            file.write(object.getBufferStart(), object.getBufferSize());
+        }
+        std::error_code ec;
+        auto replaced = std::filesystem::file_size(path, ec);
+        if (!ec)
+            mSize -= std::min(mSize, static_cast<std::uint64_t>(replaced));
+        std::filesystem::rename(tmpPath, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+        mSize += object.getBufferSize();
+        mStores++;
+
+        if (mVerbose > 1)
+            std::cout << "Object cache: stored " << module->getModuleIdentifier() << " as " << *key << std::endl;
+
+        if (mSize > mMaxSize)
+            evict();
+    }
+
+    // Called by the compiler before compiling a module.
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override
+    {
+        if (!enabled())
+            return nullptr;
+
+        auto key = get_key(*module);
+        if (!key)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto path = get_path(*key);
+        auto buffer = llvm::MemoryBuffer::getFile(path.string());
+        if (!buffer)
+        {
+            mMisses++;
+            return nullptr;
+        }
+
+        // Mark entry as recently used.
+        std::error_code ec;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+        mHits++;
+
+        if (mVerbose > 1)
+            std::cout << "Object cache: loaded " << module->getModuleIdentifier() << " from " << *key << std::endl;
+
+        return std::move(*buffer);
+    }
+
+    std::uint64_t get_hits() const noexcept
+    {
+        return mHits;
+    }
+
+    std::uint64_t get_misses() const noexcept
+    {
+        return mMisses;
+    }
+
+    std::uint64_t get_stores() const noexcept
+    {
+        return mStores;
+    }
+
+  private:
+    struct Entry
+    {
+        std::filesystem::path mPath;
+        std::filesystem::file_time_type mTime;
+        std::uint64_t mSize;
+    };
+
+    std::filesystem::path get_path(std::string const &key) const
+    {
+        return mDirectory / (key + ".o");
+    }
+
+    // Objects in the cache directory. Requires mMutex.
+    std::vector<Entry> get_entries() const
+    {
+        std::error_code ec;
+        std::vector<Entry> entries;
+        for (auto const &file : std::filesystem::directory_iterator(mDirectory, ec))
+        {
+            if (!file.is_regular_file(ec) || file.path().extension() != ".o")
+                continue;
+            entries.push_back({file.path(), file.last_write_time(ec), file.file_size(ec)});
+        }
+
+        return entries;
+    }
+
+    // Remove least recently used objects until the cache fits into its size budget. Only called once the running
+    // total exceeds the budget, the directory is walked to account for objects other processes stored or removed.
+    // Requires mMutex.
+    void evict()
+    {
+        auto entries = get_entries();
+        mSize = 0;
+        for (auto const &entry : entries)
+            mSize += entry.mSize;
+        if (mSize <= mMaxSize)
+            return;
+
+        std::error_code ec;
+        std::sort(entries.begin(), entries.end(), [](Entry const &a, Entry const &b) { return a.mTime < b.mTime; });
+        for (auto const &entry : entries)
+        {
+            if (mSize <= mMaxSize)
+                break;
+            if (std::filesystem::remove(entry.mPath, ec))
+                mSize -= entry.mSize;
+        }
+    }
+
+    std::mutex mMutex;
+    std::filesystem::path mDirectory{};
+    std::uint64_t mMaxSize = 256 * 1024 * 1024;
+    std::string mTarget{};
+    int mOptLevel = 2;
+    bool mFastMath = false;
+    int mVerbose = 0;
+    // Size of the objects in the directory in bytes, as far as this process knows. Requires mMutex.
+    std::uint64_t mSize = 0;
+
+    // Statistics, read without mMutex.
+    std::atomic<std::uint64_t> mHits{0};
+    std::atomic<std::uint64_t> mMisses{0};
+    std::atomic<std::uint64_t> mStores{0};
+};
+} // namespace jit
+} // namespace hannac
+
+#endif // OBJECTCACHE_HPP
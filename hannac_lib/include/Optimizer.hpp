@@ -0,0 +1,216 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+// stdlib includes.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// llvm includes.
+#include "llvm/IR/Function.h"
+
+// hannac includes.
+#include "ContextPool.hpp"
+#include "ObjectCache.hpp"
+
+namespace hannac
+{
+// Function pass pipelines a specialization can be optimized with.
+enum class HOptTier : std::uint8_t
+{
+    Light = 0, // InstCombine and SimplifyCFG.
+    Full = 1   // InstCombine, Reassociate, GVN and SimplifyCFG.
+};
+
+inline char const *to_string(HOptTier tier) noexcept
+{
+    return tier == HOptTier::Full ? "full" : "light";
+}
+
+// Why the cost model chose a pipeline.
+enum class HOptReason : std::uint8_t
+{
+    OverBudget = 0, // The compile-time budget is spent.
+    Tiny = 1,
+    LargeCold = 2,
+    Hot = 3,
+    Default = 4
+};
+
+inline char const *to_string(HOptReason reason) noexcept
+{
+    switch (reason)
+    {
+    case HOptReason::OverBudget:
+        return "compile-time budget spent";
+    case HOptReason::Tiny:
+        return "tiny body";
+    case HOptReason::LargeCold:
+        return "large body, rarely called";
+    case HOptReason::Hot:
+        return "hot";
+    case HOptReason::Default:
+        return "default";
+    default:
+        return "";
+    }
+}
+
+// Pipeline chosen for one function and why.
+struct HOptDecision
+{
+    std::string mFunction;
+    HOptTier mTier = HOptTier::Full;
+    std::uint64_t mInstructions = 0;
+    std::uint64_t mCallFrequency = 0;
+    HOptReason mReason = HOptReason::Default;
+    // Time spent in the pipeline.
+    std::uint64_t mNanos = 0;
+};
+
+// Counters of a HOptimizer.
+struct HOptimizerStats
+{
+    std::uint64_t mLight = 0;
+    std::uint64_t mFull = 0;
+    // Functions optimized with the light pipeline because the budget was spent.
+    std::uint64_t mOverBudget = 0;
+    // Total time spent optimizing.
+    std::uint64_t mNanos = 0;
+};
+
+// Chooses the function pass pipeline per specialization.
+// The cost model weighs the IR instruction count against the number of calls predicted from the call graph: tiny
+// bodies gain nothing from GVN, large bodies called only a few times aren't worth seconds of GVN either. Everything
+// else gets the full pipeline. Once the time spent optimizing exceeds the compile-time budget of the program, only the
+// light pipeline is used.
+// The tier chosen is attached to the function, objects optimized with one pipeline are never loaded from the object
+// cache for the other.
+class HOptimizer final
+{
+  public:
+    // Bodies up to this many instructions are tiny.
+    static constexpr std::uint64_t HTinyFunction = 8;
+    // Bodies from this many instructions on are large.
+    static constexpr std::uint64_t HLargeFunction = 256;
+    // Predicted calls from which a large body is still worth the full pipeline.
+    static constexpr std::uint64_t HHotFunction = 64;
+
+    // Budget in milliseconds, 0 is unlimited.
+    explicit HOptimizer(std::uint64_t budgetMillis = 0, int verbose = 0)
+        : mBudgetNanos(budgetMillis * 1000 * 1000), mVerbose(verbose)
+    {
+    }
+
+    HOptimizer(const HOptimizer &) = delete;
+    HOptimizer &operator=(const HOptimizer &) = delete;
+
+    // Calls of the specializations reachable from a program, predicted from its call graph.
+    void set_call_frequencies(std::map<std::string, std::uint64_t> const &frequencies)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto const &[name, calls] : frequencies)
+            mFrequencies[name] = std::max(mFrequencies[name], calls);
+    }
+
+    // Specializations not reached through the call graph are assumed to be called once.
+    std::uint64_t get_call_frequency(std::string const &name)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto frequency = mFrequencies.find(name);
+        return frequency != mFrequencies.end() ? frequency->second : 1;
+    }
+
+    // The cost model.
+    HOptTier choose(std::uint64_t instructions, std::uint64_t frequency, HOptReason &reason) const
+    {
+        if (mBudgetNanos > 0 && mNanos.load(std::memory_order_relaxed) >= mBudgetNanos)
+        {
+            reason = HOptReason::OverBudget;
+            return HOptTier::Light;
+        }
+        if (instructions <= HTinyFunction)
+        {
+            reason = HOptReason::Tiny;
+            return HOptTier::Light;
+        }
+        if (instructions >= HLargeFunction && frequency < HHotFunction)
+        {
+            reason = HOptReason::LargeCold;
+            return HOptTier::Light;
+        }
+
+        reason = frequency >= HHotFunction ? HOptReason::Hot : HOptReason::Default;
+        return HOptTier::Full;
+    }
+
+    // Choose the pipeline of func, named name in the call graph, and tag func with it. The object cache key of its
+    // module is final afterwards.
+    HOptDecision decide(llvm::Function &func, std::string const &name)
+    {
+        HOptDecision decision;
+        decision.mFunction = name;
+        decision.mInstructions = func.getInstructionCount();
+        decision.mCallFrequency = get_call_frequency(name);
+        decision.mTier = choose(decision.mInstructions, decision.mCallFrequency, decision.mReason);
+        func.addFnAttr(jit::HOptTierAttribute, to_string(decision.mTier));
+        return decision;
+    }
+
+    // Optimize func with the pipeline decided for it.
+    HOptDecision optimize(FPM &fpm, llvm::Function &func, HOptDecision decision)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fpm.run(func, decision.mTier == HOptTier::Full);
+        decision.mNanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        mNanos += decision.mNanos;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mVerbose > 0)
+            std::cout << "Optimizing " << decision.mFunction << ": " << to_string(decision.mTier) << " pipeline, "
+                      << decision.mInstructions << " instructions, " << decision.mCallFrequency
+                      << " predicted calls (" << to_string(decision.mReason) << ")." << std::endl;
+        (decision.mTier == HOptTier::Full ? mStats.mFull : mStats.mLight)++;
+        if (decision.mReason == HOptReason::OverBudget)
+            mStats.mOverBudget++;
+        mDecisions.push_back(decision);
+        return decision;
+    }
+
+    HOptDecision optimize(FPM &fpm, llvm::Function &func, std::string const &name)
+    {
+        return optimize(fpm, func, decide(func, name));
+    }
+
+    std::vector<HOptDecision> get_decisions()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mDecisions;
+    }
+
+    HOptimizerStats get_stats()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto stats = mStats;
+        stats.mNanos = mNanos;
+        return stats;
+    }
+
+  private:
+    std::uint64_t mBudgetNanos;
+    int mVerbose;
+    std::atomic<std::uint64_t> mNanos{0};
+
+    std::mutex mMutex;
+    std::map<std::string, std::uint64_t> mFrequencies;
+    std::vector<HOptDecision> mDecisions;
+    HOptimizerStats mStats;
+};
+} // namespace hannac
+#endif // OPTIMIZER_HPP
@@ -0,0 +1,249 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+// stdlib includes.
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// system includes.
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hannac
+{
+// Hardware events counted while running hanna code.
+struct HCounterValues
+{
+    std::uint64_t mCycles = 0;
+    std::uint64_t mInstructions = 0;
+    std::uint64_t mBranchMisses = 0;
+    std::uint64_t mCacheMisses = 0;
+
+    HCounterValues &operator+=(HCounterValues const &other) noexcept
+    {
+        mCycles += other.mCycles;
+        mInstructions += other.mInstructions;
+        mBranchMisses += other.mBranchMisses;
+        mCacheMisses += other.mCacheMisses;
+        return *this;
+    }
+
+    HCounterValues operator-(HCounterValues const &other) const noexcept
+    {
+        return {mCycles - other.mCycles, mInstructions - other.mInstructions, mBranchMisses - other.mBranchMisses,
+                mCacheMisses - other.mCacheMisses};
+    }
+
+    // Instructions per cycle.
+    double get_ipc() const noexcept
+    {
+        return mCycles > 0 ? static_cast<double>(mInstructions) / mCycles : 0.0;
+    }
+};
+
+// Warn once per process that hardware counters can't be read. Runs continue without them.
+inline void warn_counters_unavailable(std::string const &error)
+{
+    static std::once_flag warned;
+    std::call_once(warned, [&error]() {
+        std::cout << "Warning: hardware counters unavailable, " << error << "." << std::endl;
+        return;
+    });
+    return;
+}
+
+// Hardware counters of the calling thread, opened as one perf_event_open group so all events cover the same code.
+// Kernel and hypervisor are excluded, which is what unprivileged processes may count.
+// Containers and VMs often deny access to the PMU or lack single events. Without the cycle counter the group isn't
+// available at all, other missing events read as 0.
+class HPerfCounters final
+{
+  public:
+    HPerfCounters()
+    {
+#ifdef __linux__
+        static constexpr std::array<std::uint64_t, Events> configs{
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_MISSES};
+        static constexpr std::array<char const *, Events> names{"cycles", "instructions", "branch misses",
+                                                               "cache misses"};
+        for (std::size_t i = 0; i < Events; i++)
+        {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            mFds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : mFds[0], 0));
+            if (mFds[i] >= 0)
+                continue;
+
+            if (i == 0)
+            {
+                mError = std::string("perf_event_open: ") + std::strerror(errno);
+                return;
+            }
+            std::cout << "Warning: unable to count " << names[i] << ", " << std::strerror(errno) << "." << std::endl;
+        }
+
+        ioctl(mFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(mFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+        mError = "perf_event_open is only available on Linux";
+#endif
+    }
+
+    HPerfCounters(const HPerfCounters &) = delete;
+    HPerfCounters &operator=(const HPerfCounters &) = delete;
+
+    ~HPerfCounters()
+    {
+#ifdef __linux__
+        for (auto fd : mFds)
+            if (fd >= 0)
+                close(fd);
+#endif
+    }
+
+    bool available() const noexcept
+    {
+        return mFds[0] >= 0;
+    }
+
+    // Why the counters aren't available.
+    std::string const &get_error() const noexcept
+    {
+        return mError;
+    }
+
+    // Events counted so far, differences of two reads give the events in between.
+    HCounterValues read() const noexcept
+    {
+        HCounterValues values;
+#ifdef __linux__
+        if (!available())
+            return values;
+
+        // The number of events followed by their values in the order they were opened.
+        std::array<std::uint64_t, Events + 1> buffer{};
+        if (::read(mFds[0], buffer.data(), sizeof(buffer)) <= 0)
+            return values;
+
+        std::array<std::uint64_t, Events> counts{};
+        std::size_t next = 1;
+        for (std::size_t i = 0; i < Events && next <= buffer[0]; i++)
+            if (mFds[i] >= 0)
+                counts[i] = buffer[next++];
+        values = {counts[0], counts[1], counts[2], counts[3]};
+#endif
+        return values;
+    }
+
+  private:
+    static constexpr std::size_t Events = 4;
+
+    std::array<int, Events> mFds{-1, -1, -1, -1};
+    std::string mError;
+};
+
+// Hardware events of every main statement, summed over all programs sharing a JIT.
+class HCounterReport final
+{
+  public:
+    explicit HCounterReport(bool enabled = false) : mEnabled(enabled)
+    {
+    }
+
+    HCounterReport(const HCounterReport &) = delete;
+    HCounterReport &operator=(const HCounterReport &) = delete;
+
+    bool enabled() const noexcept
+    {
+        return mEnabled;
+    }
+
+    void add(std::string const &statement, HCounterValues const &values)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto &entry = mStatements[statement];
+        entry.mRuns++;
+        entry.mValues += values;
+        return;
+    }
+
+    // Events of statement, summed over all its runs.
+    HCounterValues get(std::string const &statement)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto entry = mStatements.find(statement);
+        return entry != mStatements.end() ? entry->second.mValues : HCounterValues{};
+    }
+
+    // Print the events of all statements by cycles.
+    void print(std::ostream &out)
+    {
+        std::vector<std::pair<std::string, Entry>> statements;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            statements.assign(mStatements.begin(), mStatements.end());
+        }
+        std::stable_sort(statements.begin(), statements.end(), [](auto const &a, auto const &b) {
+            return a.second.mValues.mCycles > b.second.mValues.mCycles;
+        });
+
+        Entry total;
+        out << "Hardware counters:" << std::endl;
+        out << "\t" << std::setw(16) << "cycles" << std::setw(16) << "instructions" << std::setw(8) << "IPC"
+            << std::setw(16) << "branch misses" << std::setw(16) << "cache misses" << std::setw(8) << "runs"
+            << "  statement" << std::endl;
+        for (auto const &[statement, entry] : statements)
+        {
+            print_entry(out, entry, statement);
+            total.mRuns += entry.mRuns;
+            total.mValues += entry.mValues;
+        }
+        print_entry(out, total, "Total");
+        out.unsetf(std::ios::floatfield);
+        return;
+    }
+
+  private:
+    struct Entry
+    {
+        std::uint64_t mRuns = 0;
+        HCounterValues mValues;
+    };
+
+    static void print_entry(std::ostream &out, Entry const &entry, std::string const &name)
+    {
+        auto const &values = entry.mValues;
+        out << "\t" << std::setw(16) << values.mCycles << std::setw(16) << values.mInstructions << std::setw(8)
+            << std::fixed << std::setprecision(2) << values.get_ipc() << std::setw(16) << values.mBranchMisses
+            << std::setw(16) << values.mCacheMisses << std::setw(8) << entry.mRuns << "  " << name << std::endl;
+        return;
+    }
+
+    bool mEnabled;
+    std::mutex mMutex;
+    std::map<std::string, Entry> mStatements;
+};
+} // namespace hannac
+#endif // PERFCOUNTERS_HPP
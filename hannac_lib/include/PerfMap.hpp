@@ -0,0 +1,119 @@
+#ifndef PERFMAP_HPP
+#define PERFMAP_HPP
+
+// llvm includes.
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+// stdlib includes.
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+// system includes.
+#include <unistd.h>
+
+namespace hannac
+{
+namespace jit
+{
+// Name of a JIT symbol as shown in profilers.
+// Specializations are named <method>_<type>..., the argument types are shown as signature instead, e.g.
+// "scale_int_double" becomes "scale(int, double)". Suffixes like those of clones and hot bodies are kept.
+inline std::string get_display_name(std::string const &symbol)
+{
+    auto end = symbol.find('.');
+    auto base = symbol.substr(0, end);
+    auto suffix = end != std::string::npos ? " [" + symbol.substr(end + 1) + "]" : std::string();
+
+    // Method names are alphanumeric, everything after the first underscore is the signature.
+    auto types = base.find('_');
+    if (types == std::string::npos || base.rfind("__", 0) == 0)
+        return symbol;
+
+    std::string displayName = base.substr(0, types) + "(";
+    for (auto pos = types; pos != std::string::npos;)
+    {
+        auto next = base.find('_', pos + 1);
+        displayName += (pos != types ? ", " : "") + base.substr(pos + 1, next - pos - 1);
+        pos = next;
+    }
+    return displayName + ")" + suffix;
+}
+
+// Writes the functions of every object loaded by the JIT to /tmp/perf-<pid>.map, so perf attributes samples in JIT
+// code to hanna methods. The map has no way to remove entries, perf uses the latest entry covering an address.
+class HPerfMapListener final : public llvm::JITEventListener
+{
+  public:
+    // There is one map per process.
+    static HPerfMapListener &get()
+    {
+        static HPerfMapListener listener;
+        return listener;
+    }
+
+    HPerfMapListener(const HPerfMapListener &) = delete;
+    HPerfMapListener &operator=(const HPerfMapListener &) = delete;
+
+    void notifyObjectLoaded(ObjectKey key, llvm::object::ObjectFile const &object,
+                            llvm::RuntimeDyld::LoadedObjectInfo const &info) override
+    {
+        if (mMap == nullptr)
+            return;
+
+        // The object for debugging has its sections at the addresses they were loaded to.
+        auto debugObject = info.getObjectForDebug(object);
+        auto const *loaded = debugObject.getBinary() != nullptr ? debugObject.getBinary() : &object;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto const &[symbol, size] : llvm::object::computeSymbolSizes(*loaded))
+        {
+            auto type = symbol.getType();
+            auto name = symbol.getName();
+            auto address = symbol.getAddress();
+            if (!type || *type != llvm::object::SymbolRef::ST_Function || !name || !address || size == 0)
+            {
+                llvm::consumeError(type.takeError());
+                llvm::consumeError(name.takeError());
+                llvm::consumeError(address.takeError());
+                continue;
+            }
+
+            *mMap << llvm::format_hex_no_prefix(*address, 1) << " " << llvm::format_hex_no_prefix(size, 1) << " "
+                  << get_display_name(name->str()) << "\n";
+        }
+        mMap->flush();
+    }
+
+    // Path of the map of this process.
+    static std::string get_path()
+    {
+        return "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    }
+
+  private:
+    HPerfMapListener()
+    {
+        std::error_code ec;
+        mMap = std::make_unique<llvm::raw_fd_ostream>(get_path(), ec, llvm::sys::fs::OF_Append);
+        if (ec)
+        {
+            std::cout << "Unable to open " << get_path() << ": " << ec.message() << std::endl;
+            mMap.reset();
+        }
+    }
+
+    std::mutex mMutex;
+    std::unique_ptr<llvm::raw_fd_ostream> mMap;
+};
+} // namespace jit
+} // namespace hannac
+#endif // PERFMAP_HPP
@@ -0,0 +1,481 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// stdlib includes.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// system includes.
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// hannac includes.
+#include "PerfCounters.hpp"
+
+namespace hannac
+{
+// Counters of one profiled function. Times are in ticks of HProfiler::now.
+struct HProfileCounters
+{
+    std::uint64_t mCalls = 0;
+    // Time spent in the function itself, without its callees.
+    std::uint64_t mSelf = 0;
+    // Time spent in the function and its callees. Recursive calls count once, for the outermost call.
+    std::uint64_t mInclusive = 0;
+};
+
+// Profile of a function, summed over all threads.
+struct HProfileEntry
+{
+    std::string mMethod;
+    std::string mSignature;
+    std::string mLibrary;
+    HProfileCounters mCounters;
+    // Hardware events of the function and its callees, if counted.
+    HCounterValues mEvents;
+};
+
+// Calls of callee from caller and the time spent in them, summed over all threads.
+struct HProfileEdge
+{
+    std::string mCaller;
+    std::string mCallee;
+    std::uint64_t mCalls = 0;
+    std::uint64_t mTime = 0;
+};
+
+// Profiler of hanna code. Every profiled function, a method specialization or a main statement, gets a slot.
+// Instrumented code calls enter on entry and exit before returning. Both only touch counters of the calling thread,
+// the threads' counters are summed when the profile is read.
+// The profile can be read while profiled code runs. The hooks never allocate on their own: every thread's counters
+// live in chunks allocated when a slot or the thread is registered, and they never move. Counters are relaxed atomics,
+// a reader may see the calls of a function before their time.
+class HProfiler final
+{
+  public:
+    // The call graph costs a hash lookup per call, it is only recorded if asked for. Hardware counters cost two
+    // system calls per call.
+    explicit HProfiler(bool enabled = false, bool callGraph = false, bool hardwareCounters = false)
+        : mEnabled(enabled), mCallGraph(callGraph), mHardwareCounters(hardwareCounters), mId(sNextId++)
+    {
+    }
+
+    HProfiler(const HProfiler &) = delete;
+    HProfiler &operator=(const HProfiler &) = delete;
+
+    bool enabled() const noexcept
+    {
+        return mEnabled;
+    }
+
+    bool records_call_graph() const noexcept
+    {
+        return mCallGraph;
+    }
+
+    bool counts_hardware_events() const noexcept
+    {
+        return mHardwareCounters;
+    }
+
+    // Slot of function funcName of library, registered on first use. Registering a slot allocates its counters for
+    // every thread.
+    std::uint64_t get_slot(std::string const &library, std::string const &funcName, std::string const &method,
+                           std::string const &signature)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto [entry, inserted] = mSlotIds.try_emplace({library, funcName}, mSlots.size());
+        if (inserted)
+        {
+            mSlots.push_back({method, signature, library, {}, {}});
+            for (auto &[id, thread] : mThreads)
+                add_chunks(*thread);
+        }
+        return entry->second;
+    }
+
+    // Entry points of instrumented code. Calls are dropped from the profile if the memory to record them is missing.
+    static void enter(HProfiler *profiler, std::uint64_t slot) noexcept
+    {
+        auto thread = profiler->get_thread_profile();
+        auto counters = thread != nullptr ? find_slot(*thread, slot) : nullptr;
+        if (counters == nullptr)
+            return;
+
+        auto events = thread->mPerfCounters != nullptr ? thread->mPerfCounters->read() : HCounterValues{};
+        try
+        {
+            thread->mStack.push_back({slot, now(), 0, events});
+        }
+        catch (std::bad_alloc const &)
+        {
+            return;
+        }
+        counters->mActive++;
+        return;
+    }
+
+    static void exit(HProfiler *profiler, std::uint64_t slot) noexcept
+    {
+        auto end = now();
+        auto thread = profiler->get_thread_profile();
+        if (thread == nullptr)
+            return;
+        auto events = thread->mPerfCounters != nullptr ? thread->mPerfCounters->read() : HCounterValues{};
+        if (thread->mStack.empty() || thread->mStack.back().mSlot != slot)
+            return;
+
+        auto frame = thread->mStack.back();
+        thread->mStack.pop_back();
+        auto elapsed = end - frame.mStart;
+        auto &counters = *find_slot(*thread, slot);
+        add(counters.mCalls, 1);
+        add(counters.mSelf, elapsed - std::min(elapsed, frame.mChildren));
+        if (--counters.mActive == 0)
+        {
+            add(counters.mInclusive, elapsed);
+            auto delta = events - frame.mStartEvents;
+            add(counters.mCycles, delta.mCycles);
+            add(counters.mInstructions, delta.mInstructions);
+            add(counters.mBranchMisses, delta.mBranchMisses);
+            add(counters.mCacheMisses, delta.mCacheMisses);
+        }
+
+        if (thread->mStack.empty())
+            return;
+        auto &caller = thread->mStack.back();
+        caller.mChildren += elapsed;
+        if (thread->mEdges != nullptr)
+        {
+            if (auto edge = find_edge(*thread->mEdges, caller.mSlot << 32 | slot))
+            {
+                add(edge->mCalls, 1);
+                add(edge->mTime, elapsed);
+            }
+        }
+        return;
+    }
+
+    // Time stamp counter where available, it is the cheapest clock. Nanoseconds otherwise.
+    static std::uint64_t now() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    static char const *get_time_unit() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return "cycles";
+#else
+        return "ns";
+#endif
+    }
+
+    // Profile of every function called at least once, by self time.
+    std::vector<HProfileEntry> get_profile()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto profile = mSlots;
+        for (auto const &[id, thread] : mThreads)
+            for (std::size_t slot = 0; slot < profile.size(); slot++)
+            {
+                auto threadCounters = find_slot(*thread, slot);
+                if (threadCounters == nullptr)
+                    break;
+
+                auto &counters = profile[slot].mCounters;
+                counters.mCalls += threadCounters->mCalls.load(std::memory_order_relaxed);
+                counters.mSelf += threadCounters->mSelf.load(std::memory_order_relaxed);
+                counters.mInclusive += threadCounters->mInclusive.load(std::memory_order_relaxed);
+                profile[slot].mEvents += {threadCounters->mCycles.load(std::memory_order_relaxed),
+                                          threadCounters->mInstructions.load(std::memory_order_relaxed),
+                                          threadCounters->mBranchMisses.load(std::memory_order_relaxed),
+                                          threadCounters->mCacheMisses.load(std::memory_order_relaxed)};
+            }
+
+        profile.erase(std::remove_if(profile.begin(), profile.end(),
+                                     [](HProfileEntry const &entry) { return entry.mCounters.mCalls == 0; }),
+                      profile.end());
+        std::stable_sort(profile.begin(), profile.end(), [](HProfileEntry const &a, HProfileEntry const &b) {
+            return a.mCounters.mSelf > b.mCounters.mSelf;
+        });
+        return profile;
+    }
+
+    // Edges of the call graph, empty unless it is recorded.
+    std::vector<HProfileEdge> get_call_graph()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::map<std::uint64_t, HProfileEdge> edges;
+        for (auto const &[id, thread] : mThreads)
+        {
+            if (thread->mEdges == nullptr)
+                continue;
+            for (auto const &entry : *thread->mEdges)
+            {
+                auto key = entry.mKey.load(std::memory_order_relaxed);
+                auto calls = entry.mCalls.load(std::memory_order_relaxed);
+                if (key == 0 || calls == 0)
+                    continue;
+
+                auto &edge = edges[key - 1];
+                edge.mCalls += calls;
+                edge.mTime += entry.mTime.load(std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<HProfileEdge> callGraph;
+        for (auto &[key, edge] : edges)
+        {
+            edge.mCaller = get_label(mSlots[key >> 32]);
+            edge.mCallee = get_label(mSlots[key & 0xffffffff]);
+            callGraph.push_back(std::move(edge));
+        }
+        return callGraph;
+    }
+
+    // Print the flat profile.
+    void print(std::ostream &out)
+    {
+        auto profile = get_profile();
+        std::uint64_t total = 0;
+        for (auto const &entry : profile)
+            total += entry.mCounters.mSelf;
+
+        out << "Flat profile (" << get_time_unit() << "):" << std::endl;
+        out << "\t" << std::setw(8) << "self %" << std::setw(16) << "self" << std::setw(16) << "inclusive"
+            << std::setw(12) << "calls";
+        if (mHardwareCounters)
+            out << std::setw(8) << "IPC" << std::setw(16) << "branch misses" << std::setw(16) << "cache misses";
+        out << "  method" << std::endl;
+        for (auto const &entry : profile)
+        {
+            auto const &counters = entry.mCounters;
+            out << "\t" << std::setw(7) << std::fixed << std::setprecision(1)
+                << (total > 0 ? 100.0 * counters.mSelf / total : 0.0) << "%" << std::setw(16) << counters.mSelf
+                << std::setw(16) << counters.mInclusive << std::setw(12) << counters.mCalls;
+            // Events are inclusive like the time.
+            if (mHardwareCounters)
+                out << std::setw(8) << std::setprecision(2) << entry.mEvents.get_ipc() << std::setw(16)
+                    << entry.mEvents.mBranchMisses << std::setw(16) << entry.mEvents.mCacheMisses;
+            out << "  " << get_label(entry) << std::endl;
+        }
+        out.unsetf(std::ios::floatfield);
+        return;
+    }
+
+    // Write the call graph in DOT format.
+    void write_call_graph(std::ostream &out)
+    {
+        out << "digraph profile {" << std::endl;
+        for (auto const &entry : get_profile())
+            out << "  \"" << escape(get_label(entry)) << "\" [label=\"" << escape(get_label(entry)) << "\\nself "
+                << entry.mCounters.mSelf << " " << get_time_unit() << "\\ncalls " << entry.mCounters.mCalls
+                << "\"];" << std::endl;
+        for (auto const &edge : get_call_graph())
+            out << "  \"" << escape(edge.mCaller) << "\" -> \"" << escape(edge.mCallee) << "\" [label=\""
+                << edge.mCalls << " calls\\n"
+                << edge.mTime << " " << get_time_unit() << "\"];" << std::endl;
+        out << "}" << std::endl;
+        return;
+    }
+
+  private:
+    // Slots per chunk of counters and chunks per thread. Calls of slots beyond aren't profiled.
+    static constexpr std::size_t ChunkSlots = 256;
+    static constexpr std::size_t MaxChunks = 4096;
+    // The call graph of a thread is an open addressing hash table which can't grow. Edges not finding a free entry
+    // within a few probes aren't recorded.
+    static constexpr std::size_t EdgeEntries = 4096;
+    static constexpr std::size_t EdgeProbes = 32;
+
+    struct HFrame
+    {
+        std::uint64_t mSlot;
+        std::uint64_t mStart;
+        // Time spent in callees.
+        std::uint64_t mChildren;
+        HCounterValues mStartEvents;
+    };
+
+    // Counters of a slot on one thread. Only the thread writes them, other threads may read them at any time.
+    struct HSlotCounters
+    {
+        std::atomic<std::uint64_t> mCalls{0};
+        std::atomic<std::uint64_t> mSelf{0};
+        std::atomic<std::uint64_t> mInclusive{0};
+        std::atomic<std::uint64_t> mCycles{0};
+        std::atomic<std::uint64_t> mInstructions{0};
+        std::atomic<std::uint64_t> mBranchMisses{0};
+        std::atomic<std::uint64_t> mCacheMisses{0};
+        // Frames of the slot on the stack, recursive calls add to the inclusive time once. Never read by others.
+        std::uint32_t mActive = 0;
+    };
+    using HChunk = std::array<HSlotCounters, ChunkSlots>;
+
+    // Entry of the call graph table, keyed by caller and callee slot plus 1.
+    struct HEdge
+    {
+        std::atomic<std::uint64_t> mKey{0};
+        std::atomic<std::uint64_t> mCalls{0};
+        std::atomic<std::uint64_t> mTime{0};
+    };
+    using HEdges = std::array<HEdge, EdgeEntries>;
+
+    struct HThreadProfile
+    {
+        // Published once allocated, never moved or freed while the profiler lives.
+        std::array<std::atomic<HChunk *>, MaxChunks> mChunks{};
+        // Owners of the chunks, only touched under mMutex.
+        std::vector<std::unique_ptr<HChunk>> mChunkStorage;
+        // Null unless hardware events are counted and the counters are available.
+        std::unique_ptr<HPerfCounters> mPerfCounters;
+        // Only used by the thread itself.
+        std::vector<HFrame> mStack;
+        // Null unless the call graph is recorded.
+        std::unique_ptr<HEdges> mEdges;
+    };
+
+    // Single writer, a relaxed load and store is enough and cheaper than an atomic add.
+    static void add(std::atomic<std::uint64_t> &counter, std::uint64_t value) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        return;
+    }
+
+    static HSlotCounters *find_slot(HThreadProfile &thread, std::uint64_t slot) noexcept
+    {
+        if (slot / ChunkSlots >= MaxChunks)
+            return nullptr;
+        auto chunk = thread.mChunks[slot / ChunkSlots].load(std::memory_order_acquire);
+        return chunk != nullptr ? &(*chunk)[slot % ChunkSlots] : nullptr;
+    }
+
+    // Entry of an edge, claimed on first use. Only the owning thread claims entries.
+    static HEdge *find_edge(HEdges &edges, std::uint64_t edge) noexcept
+    {
+        auto key = edge + 1;
+        auto index = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 52);
+        for (std::size_t probe = 0; probe < EdgeProbes; probe++)
+        {
+            auto &entry = edges[(index + probe) % EdgeEntries];
+            auto current = entry.mKey.load(std::memory_order_relaxed);
+            if (current == 0)
+            {
+                entry.mKey.store(key, std::memory_order_relaxed);
+                return &entry;
+            }
+            if (current == key)
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    // Allocate the chunks of all registered slots for thread. Requires mMutex.
+    void add_chunks(HThreadProfile &thread)
+    {
+        auto chunks = std::min((mSlots.size() + ChunkSlots - 1) / ChunkSlots, MaxChunks);
+        for (std::size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            if (thread.mChunks[chunk].load(std::memory_order_relaxed) != nullptr)
+                continue;
+            thread.mChunkStorage.push_back(std::make_unique<HChunk>());
+            thread.mChunks[chunk].store(thread.mChunkStorage.back().get(), std::memory_order_release);
+        }
+        return;
+    }
+
+    // Buffers of the calling thread, null if they can't be allocated. A thread caches the one of the profiler it
+    // used last.
+    HThreadProfile *get_thread_profile() noexcept
+    {
+        thread_local std::uint64_t sProfiler = 0;
+        thread_local HThreadProfile *sProfile = nullptr;
+        if (sProfiler == mId)
+            return sProfile;
+
+        try
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto &profile = mThreads[std::this_thread::get_id()];
+            if (profile == nullptr)
+            {
+                auto created = std::make_unique<HThreadProfile>();
+                add_chunks(*created);
+                created->mStack.reserve(64);
+                if (mCallGraph)
+                    created->mEdges = std::make_unique<HEdges>();
+                if (mHardwareCounters)
+                {
+                    created->mPerfCounters = std::make_unique<HPerfCounters>();
+                    if (!created->mPerfCounters->available())
+                    {
+                        warn_counters_unavailable(created->mPerfCounters->get_error());
+                        created->mPerfCounters.reset();
+                    }
+                }
+                profile = std::move(created);
+            }
+            sProfiler = mId;
+            sProfile = profile.get();
+            return sProfile;
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    static std::string get_label(HProfileEntry const &entry)
+    {
+        return entry.mMethod + entry.mSignature + (entry.mLibrary.empty() ? "" : " " + entry.mLibrary);
+    }
+
+    static std::string escape(std::string const &label)
+    {
+        std::string escaped;
+        for (auto c : label)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    // Ids tell profilers apart in the thread cache, addresses may be reused.
+    static inline std::atomic<std::uint64_t> sNextId{1};
+
+    bool mEnabled;
+    bool mCallGraph;
+    bool mHardwareCounters;
+    std::uint64_t mId;
+    std::mutex mMutex;
+    std::map<std::tuple<std::string, std::string>, std::uint64_t> mSlotIds;
+    std::vector<HProfileEntry> mSlots;
+    std::map<std::thread::id, std::unique_ptr<HThreadProfile>> mThreads;
+};
+} // namespace hannac
+#endif // PROFILER_HPP
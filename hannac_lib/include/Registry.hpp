@@ -0,0 +1,190 @@
+#ifndef REGISTRY_HPP
+#define REGISTRY_HPP
+
+// stdlib includes.
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace hannac
+{
+// Counters of a HCompileOnceRegistry.
+struct HRegistryStats
+{
+    // Calls of get_or_create.
+    std::uint64_t mRequests = 0;
+    // Requests answered by an already finished entry.
+    std::uint64_t mHits = 0;
+    // Requests which had to wait for another thread producing the entry.
+    std::uint64_t mWaits = 0;
+    // Entries produced, i.e. producer invocations.
+    std::uint64_t mCreated = 0;
+    // Lock acquisitions which found the lock already held.
+    std::uint64_t mContended = 0;
+    // Total time spent waiting for contended locks.
+    std::uint64_t mLockWaitNanos = 0;
+};
+
+// Concurrent table producing every value exactly once.
+// The first thread requesting a key runs the producer. Threads requesting the same key meanwhile wait on a shared
+// future instead of producing it a second time. Finished entries are answered under a shared lock only, so readers
+// never block each other. Keys are spread over shards to keep writers of different keys apart.
+template <typename Value> class HCompileOnceRegistry final
+{
+  public:
+    HCompileOnceRegistry() = default;
+    HCompileOnceRegistry(const HCompileOnceRegistry &) = delete;
+    HCompileOnceRegistry &operator=(const HCompileOnceRegistry &) = delete;
+
+    // Get the value for key, calling producer if nobody produced it yet.
+    // If the producer throws, all waiting threads receive the exception and the key can be requested again.
+    template <typename Producer> Value get_or_create(std::string const &key, Producer &&producer)
+    {
+        mRequests++;
+        auto &shard = get_shard(key);
+
+        // Fast path, entry exists.
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mMutex, std::defer_lock);
+            acquire(lock);
+            auto entry = shard.mEntries.find(key);
+            if (entry != shard.mEntries.end())
+            {
+                if (entry->second->mReady.load(std::memory_order_acquire))
+                {
+                    mHits++;
+                    return entry->second->mValue;
+                }
+
+                auto future = entry->second->mFuture;
+                lock.unlock();
+                mWaits++;
+                return future.get();
+            }
+        }
+
+        // Slow path, insert in-flight entry unless another thread was faster.
+        std::promise<Value> promise;
+        std::shared_ptr<Entry> entry;
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mMutex, std::defer_lock);
+            acquire(lock);
+            auto existing = shard.mEntries.find(key);
+            if (existing != shard.mEntries.end())
+            {
+                auto future = existing->second->mFuture;
+                lock.unlock();
+                mWaits++;
+                return future.get();
+            }
+
+            entry = std::make_shared<Entry>();
+            entry->mFuture = promise.get_future().share();
+            shard.mEntries.emplace(key, entry);
+        }
+
+        // Produce without holding any lock, the producer may request other keys.
+        try
+        {
+            entry->mValue = std::invoke(std::forward<Producer>(producer));
+        }
+        catch (...)
+        {
+            {
+                std::unique_lock<std::shared_mutex> lock(shard.mMutex, std::defer_lock);
+                acquire(lock);
+                shard.mEntries.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        mCreated++;
+        entry->mReady.store(true, std::memory_order_release);
+        promise.set_value(entry->mValue);
+
+        return entry->mValue;
+    }
+
+    bool contains(std::string const &key)
+    {
+        auto &shard = get_shard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mMutex, std::defer_lock);
+        acquire(lock);
+        return shard.mEntries.find(key) != shard.mEntries.end();
+    }
+
+    // Forget a finished entry, the next request produces it again.
+    void erase(std::string const &key)
+    {
+        auto &shard = get_shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex, std::defer_lock);
+        acquire(lock);
+        auto entry = shard.mEntries.find(key);
+        if (entry != shard.mEntries.end() && entry->second->mReady.load(std::memory_order_acquire))
+            shard.mEntries.erase(entry);
+    }
+
+    HRegistryStats get_stats() const noexcept
+    {
+        HRegistryStats stats;
+        stats.mRequests = mRequests;
+        stats.mHits = mHits;
+        stats.mWaits = mWaits;
+        stats.mCreated = mCreated;
+        stats.mContended = mContended;
+        stats.mLockWaitNanos = mLockWaitNanos;
+        return stats;
+    }
+
+  private:
+    struct Entry
+    {
+        std::shared_future<Value> mFuture;
+        std::atomic<bool> mReady{false};
+        Value mValue{};
+    };
+
+    struct Shard
+    {
+        std::shared_mutex mMutex;
+        std::unordered_map<std::string, std::shared_ptr<Entry>> mEntries;
+    };
+
+    Shard &get_shard(std::string const &key)
+    {
+        return mShards[std::hash<std::string>{}(key) % mShards.size()];
+    }
+
+    // Lock and record contention.
+    template <typename Lock> void acquire(Lock &lock)
+    {
+        if (lock.try_lock())
+            return;
+
+        mContended++;
+        auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        mLockWaitNanos +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::array<Shard, 16> mShards;
+
+    // Statistics.
+    std::atomic<std::uint64_t> mRequests{0};
+    std::atomic<std::uint64_t> mHits{0};
+    std::atomic<std::uint64_t> mWaits{0};
+    std::atomic<std::uint64_t> mCreated{0};
+    std::atomic<std::uint64_t> mContended{0};
+    std::atomic<std::uint64_t> mLockWaitNanos{0};
+};
+} // namespace hannac
+#endif // REGISTRY_HPP
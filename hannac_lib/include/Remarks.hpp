@@ -0,0 +1,244 @@
+#ifndef REMARKS_HPP
+#define REMARKS_HPP
+
+// stdlib includes.
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// llvm includes.
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/Casting.h"
+
+// hannac includes.
+#include "PerfMap.hpp"
+
+namespace hannac
+{
+// Optimization remark of an LLVM pass about a function generated from a hanna method.
+struct HRemark
+{
+    // Passed, Missed or Analysis.
+    std::string mKind;
+    std::string mPass;
+    std::string mName;
+    std::string mFunction;
+    std::string mMethod;
+    std::string mSignature;
+    // Line in the hanna source, 0 without debug info.
+    unsigned mLine = 0;
+    std::string mMessage;
+};
+
+// Remarks of a method specialization by kind.
+struct HRemarkCounts
+{
+    std::uint64_t mPassed = 0;
+    std::uint64_t mMissed = 0;
+    std::uint64_t mAnalysis = 0;
+};
+
+// Optimization remarks of all sessions sharing a JIT. They are collected from every context code is generated in,
+// on whatever thread the function and module pipelines or the code generator run.
+class HRemarks final
+{
+  public:
+    explicit HRemarks(bool enabled = false) : mEnabled(enabled)
+    {
+    }
+
+    HRemarks(const HRemarks &) = delete;
+    HRemarks &operator=(const HRemarks &) = delete;
+
+    bool enabled() const noexcept
+    {
+        return mEnabled;
+    }
+
+    void add(llvm::DiagnosticInfoOptimizationBase const &diagnostic)
+    {
+        HRemark remark;
+        remark.mKind = diagnostic.isPassed() ? "Passed" : diagnostic.isMissed() ? "Missed" : "Analysis";
+        remark.mPass = diagnostic.getPassName().str();
+        remark.mName = diagnostic.getRemarkName().str();
+        remark.mFunction = diagnostic.getFunction().getName().str();
+        remark.mLine = diagnostic.isLocationAvailable() ? diagnostic.getLocation().getLine() : 0;
+        remark.mMessage = diagnostic.getMsg();
+
+        // Specializations are named after their method and argument types, see get_display_name.
+        auto displayName = jit::get_display_name(remark.mFunction);
+        auto signature = displayName.find('(');
+        remark.mMethod = displayName.substr(0, signature);
+        remark.mSignature = signature != std::string::npos ? displayName.substr(signature) : "";
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRemarks.push_back(std::move(remark));
+        return;
+    }
+
+    std::vector<HRemark> get_remarks()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mRemarks;
+    }
+
+    // Remarks per method and signature.
+    std::map<std::string, HRemarkCounts> get_counts()
+    {
+        std::map<std::string, HRemarkCounts> counts;
+        for (auto const &remark : get_remarks())
+        {
+            auto &count = counts[remark.mMethod + remark.mSignature];
+            (remark.mKind == "Passed" ? count.mPassed : remark.mKind == "Missed" ? count.mMissed : count.mAnalysis)++;
+        }
+        return counts;
+    }
+
+    // Write all remarks as YAML documents in the format of LLVM's -fsave-optimization-record, extended by the hanna
+    // method and its signature.
+    void write_yaml(std::ostream &out)
+    {
+        for (auto const &remark : get_remarks())
+        {
+            out << "--- !" << remark.mKind << "\n";
+            out << "Pass:            " << quote_yaml(remark.mPass) << "\n";
+            out << "Name:            " << quote_yaml(remark.mName) << "\n";
+            out << "Function:        " << quote_yaml(remark.mFunction) << "\n";
+            out << "Method:          " << quote_yaml(remark.mMethod) << "\n";
+            out << "Signature:       " << quote_yaml(remark.mSignature) << "\n";
+            if (remark.mLine > 0)
+                out << "Line:            " << remark.mLine << "\n";
+            out << "Message:         " << quote_yaml(remark.mMessage) << "\n";
+            out << "...\n";
+        }
+        out.flush();
+        return;
+    }
+
+    // Write all remarks and the counts per method as one JSON object.
+    void write_json(std::ostream &out)
+    {
+        out << "{\n  \"remarks\": [";
+        bool first = true;
+        for (auto const &remark : get_remarks())
+        {
+            out << (first ? "\n" : ",\n") << "    {\"kind\": " << quote_json(remark.mKind)
+                << ", \"pass\": " << quote_json(remark.mPass) << ", \"name\": " << quote_json(remark.mName)
+                << ", \"function\": " << quote_json(remark.mFunction) << ", \"method\": " << quote_json(remark.mMethod)
+                << ", \"signature\": " << quote_json(remark.mSignature) << ", \"line\": " << remark.mLine
+                << ", \"message\": " << quote_json(remark.mMessage) << "}";
+            first = false;
+        }
+        out << "\n  ],\n  \"summary\": {";
+        first = true;
+        for (auto const &[method, count] : get_counts())
+        {
+            out << (first ? "\n" : ",\n") << "    " << quote_json(method) << ": {\"passed\": " << count.mPassed
+                << ", \"missed\": " << count.mMissed << ", \"analysis\": " << count.mAnalysis << "}";
+            first = false;
+        }
+        out << "\n  }\n}" << std::endl;
+        return;
+    }
+
+    // Print the number of remarks per method.
+    void print_summary(std::ostream &out)
+    {
+        out << "Optimization remarks:" << std::endl;
+        out << "\t" << std::setw(8) << "passed" << std::setw(8) << "missed" << std::setw(10) << "analysis"
+            << "  method" << std::endl;
+        for (auto const &[method, count] : get_counts())
+            out << "\t" << std::setw(8) << count.mPassed << std::setw(8) << count.mMissed << std::setw(10)
+                << count.mAnalysis << "  " << method << std::endl;
+        return;
+    }
+
+  private:
+    static std::string quote_yaml(std::string const &value)
+    {
+        std::string quoted = "'";
+        for (auto c : value)
+            quoted += c == '\'' ? "''" : std::string(1, c);
+        return quoted + "'";
+    }
+
+    static std::string quote_json(std::string const &value)
+    {
+        std::string quoted = "\"";
+        for (auto c : value)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+                quoted += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            }
+            else
+            {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    }
+
+    bool mEnabled;
+    std::mutex mMutex;
+    std::vector<HRemark> mRemarks;
+};
+
+// Diagnostic handler of a context enabling all optimization remarks and passing them to HRemarks.
+// Other diagnostics are left to LLVM's default handling.
+class HRemarkHandler final : public llvm::DiagnosticHandler
+{
+  public:
+    explicit HRemarkHandler(HRemarks &remarks) : mRemarks(remarks)
+    {
+    }
+
+    bool handleDiagnostics(llvm::DiagnosticInfo const &diagnostic) override
+    {
+        auto remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&diagnostic);
+        if (remark == nullptr)
+            return false;
+
+        mRemarks.add(*remark);
+        return true;
+    }
+
+    bool isAnalysisRemarkEnabled(llvm::StringRef) const override
+    {
+        return true;
+    }
+
+    bool isMissedOptRemarkEnabled(llvm::StringRef) const override
+    {
+        return true;
+    }
+
+    bool isPassedOptRemarkEnabled(llvm::StringRef) const override
+    {
+        return true;
+    }
+
+    bool isAnyRemarkEnabled() const override
+    {
+        return true;
+    }
+
+  private:
+    HRemarks &mRemarks;
+};
+} // namespace hannac
+#endif // REMARKS_HPP
@@ -0,0 +1,169 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+// stdlib includes.
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// hannac includes.
+#include "AST.hpp"
+#include "GlobalSettings.hpp"
+#include "JIT.hpp"
+#include "Session.hpp"
+
+namespace hannac
+{
+// Compiles method specializations ahead of their first call using all compile threads.
+// The call graph of all specializations reachable from the program is built from the AST via type inference.
+// Since every specialization calls its callees through lazy stubs, no specialization depends on the code of
+// another. Leaves and independent subtrees are therefore compiled concurrently, each on its own thread with its own
+// context, module and IRBuilder.
+// The call graph also predicts how often every specialization is called, which the optimizer bases its choice of
+// pipeline on.
+class HCompileScheduler final
+{
+  public:
+    HCompileScheduler(HSession &session, std::vector<std::unique_ptr<ast::Expression>> const &program)
+        : mSession(session)
+    {
+        ast::HSpecializationList calls;
+        for (auto const &line : program)
+            line->collect_calls(mSession, {}, calls);
+
+        for (auto const &[name, argTypes] : calls)
+        {
+            auto &frequency = mCallFrequencies[ast::produce_func_name(name, argTypes)];
+            frequency = saturating_add(frequency, 1);
+            visit(name, argTypes);
+        }
+
+        // Callers come before their callees in reverse order, so every caller's frequency is final when it is
+        // propagated.
+        for (auto caller = mOrder.rbegin(); caller != mOrder.rend(); caller++)
+            for (auto const &[callee, sites] : mCallSites[*caller])
+                mCallFrequencies[callee] =
+                    saturating_add(mCallFrequencies[callee], saturating_mul(mCallFrequencies[*caller], sites));
+    }
+
+    // Call graph of the reachable specializations.
+    std::map<std::string, std::set<std::string>> const &get_call_graph() const noexcept
+    {
+        return mCallGraph;
+    }
+
+    // Reachable specializations, callees before callers.
+    std::vector<std::string> const &get_order() const noexcept
+    {
+        return mOrder;
+    }
+
+    // Predicted calls of every reachable specialization when running the program once.
+    std::map<std::string, std::uint64_t> const &get_call_frequencies() const noexcept
+    {
+        return mCallFrequencies;
+    }
+
+    void operator()()
+    {
+        for (auto const &[name, argTypes] : mSpecializations)
+            ast::request_specialization(mSession, name, argTypes);
+
+        if (mSession.get_settings().get_verbose() > 0)
+            std::cout << "Compiling " << mOrder.size() << " specializations on " << mSession.get_settings().get_jobs()
+                      << " threads." << std::endl;
+
+        // Specializations of library methods are compiled into their library.
+        static llvm::ExitOnError err;
+        for (auto &[owner, names] : mBatches)
+            err(owner->get_library().compile_methods(names));
+
+        return;
+    }
+
+  private:
+    // Depth first traversal of the call graph producing callees before callers.
+    // Uses an explicit stack, call chains may be deep.
+    void visit(std::string const &name, std::vector<ast::ASTType> const &argTypes)
+    {
+        struct Node
+        {
+            std::string mName;
+            std::vector<ast::ASTType> mArgTypes;
+            bool mExpanded;
+        };
+
+        std::vector<Node> stack{{name, argTypes, false}};
+        while (!stack.empty())
+        {
+            auto node = stack.back();
+            stack.pop_back();
+            auto funcName = ast::produce_func_name(node.mName, node.mArgTypes);
+
+            // All callees have been handled.
+            if (node.mExpanded)
+            {
+                mOrder.push_back(funcName);
+                mSpecializations.push_back({node.mName, node.mArgTypes});
+                mBatches[&mSession.get_method_owner(node.mName)].push_back(funcName);
+                continue;
+            }
+
+            if (!mVisited.insert(funcName).second)
+                continue;
+
+            auto funcAst = mSession.find_method(node.mName);
+            if (funcAst == nullptr)
+                continue;
+            auto returnType = ast::infer_method_return_type(mSession, node.mName, node.mArgTypes);
+            if (returnType != ast::ASTType::Number && returnType != ast::ASTType::RealNumber)
+                continue;
+
+            // Calls beyond the specialization cap run the generic version, it is compiled on demand.
+            if (!ast::allow_specialization(mSession, node.mName, node.mArgTypes))
+                continue;
+
+            ast::HSpecializationList callees;
+            funcAst->collect_specialization_calls(mSession.get_method_owner(node.mName), node.mArgTypes, callees);
+            stack.push_back({node.mName, node.mArgTypes, true});
+            for (auto const &[calleeName, calleeArgTypes] : callees)
+            {
+                auto calleeFuncName = ast::produce_func_name(calleeName, calleeArgTypes);
+                mCallGraph[funcName].insert(calleeFuncName);
+                mCallSites[funcName][calleeFuncName]++;
+                stack.push_back({calleeName, calleeArgTypes, false});
+            }
+        }
+
+        return;
+    }
+
+    static std::uint64_t saturating_add(std::uint64_t a, std::uint64_t b) noexcept
+    {
+        return a > std::numeric_limits<std::uint64_t>::max() - b ? std::numeric_limits<std::uint64_t>::max() : a + b;
+    }
+
+    static std::uint64_t saturating_mul(std::uint64_t a, std::uint64_t b) noexcept
+    {
+        return b != 0 && a > std::numeric_limits<std::uint64_t>::max() / b ? std::numeric_limits<std::uint64_t>::max()
+                                                                           : a * b;
+    }
+
+    HSession &mSession;
+    std::map<std::string, std::set<std::string>> mCallGraph;
+    // Number of call sites of each callee in a caller.
+    std::map<std::string, std::map<std::string, std::uint64_t>> mCallSites;
+    std::map<std::string, std::uint64_t> mCallFrequencies;
+    ast::HSpecializationList mSpecializations;
+    std::set<std::string> mVisited;
+    std::vector<std::string> mOrder;
+    std::map<HSession *, std::vector<std::string>> mBatches;
+};
+} // namespace hannac
+#endif // SCHEDULER_HPP
@@ -0,0 +1,157 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+// stdlib includes.
+#include <memory>
+#include <string>
+
+// hannac includes.
+#include "AST.hpp"
+#include "ContextPool.hpp"
+#include "GlobalSettings.hpp"
+#include "JIT.hpp"
+#include "Optimizer.hpp"
+
+namespace hannac
+{
+// Compilation session of one hanna program.
+// Owns everything compiling and running a program needs: the settings, the parsed methods, the inferred method
+// declarations and the JIT library holding the generated code. Parser, code generation and execution all work on a
+// session, so independent programs can be compiled and executed concurrently in one process, each in its own session.
+//
+// A session can be linked against a library session. Methods the program does not define are taken from the library,
+// their specializations are compiled into the library's JIT library once and shared by all programs linked against
+// it. Tearing down a program session removes its own code only.
+class HSession final
+{
+  public:
+    // The JIT is set up according to the given settings, changing the optimization level, the object cache or the
+    // number of jobs afterwards has no effect.
+    explicit HSession(HSettings settings = {})
+        : mSettings(std::move(settings)), mContextPool(std::make_shared<HContextPool>()),
+          mOptimizer(mSettings.get_opt_budget(), mSettings.get_verbose()), mJIT(jit::HJIT::make_jit(mSettings)),
+          mLibrary(mJIT->create_library("main", get_module_generator()))
+    {
+    }
+
+    // Program session linked against library. The library session must outlive this session.
+    explicit HSession(HSession &library)
+        : mSettings(library.mSettings), mBase(&library), mContextPool(library.mContextPool),
+          mOptimizer(mSettings.get_opt_budget(), mSettings.get_verbose()), mJIT(library.mJIT),
+          mLibrary(mJIT->create_library("program." + std::to_string(mJIT->next_library_id()), get_module_generator()))
+    {
+        mLibrary->link_against(library.get_library());
+    }
+
+    HSession(const HSession &) = delete;
+    HSession &operator=(const HSession &) = delete;
+
+    HSettings &get_settings() noexcept
+    {
+        return mSettings;
+    }
+
+    jit::HJIT &get_jit() noexcept
+    {
+        return *mJIT;
+    }
+
+    // Contexts code is generated in, shared with the library session.
+    HContextPool &get_context_pool() noexcept
+    {
+        return *mContextPool;
+    }
+
+    // Chooses the optimization pipeline of the functions generated in this session.
+    HOptimizer &get_optimizer() noexcept
+    {
+        return mOptimizer;
+    }
+
+    // JIT library holding the code generated in this session.
+    jit::HJITLibrary &get_library() noexcept
+    {
+        return *mLibrary;
+    }
+
+    // Methods defined in this session.
+    ast::HMethodBuffer &get_methods() noexcept
+    {
+        return mMethods;
+    }
+
+    // Find a method defined in this session or the library it is linked against.
+    std::shared_ptr<ast::MethodDefinition> find_method(std::string const &name)
+    {
+        auto method = mMethods.find(name);
+        if (method != mMethods.end())
+            return method->second;
+
+        return mBase != nullptr ? mBase->find_method(name) : nullptr;
+    }
+
+    // Session defining a method, code for the method is generated there.
+    HSession &get_method_owner(std::string const &name)
+    {
+        if (mBase == nullptr || mMethods.find(name) != mMethods.end() || mBase->find_method(name) == nullptr)
+            return *this;
+
+        return mBase->get_method_owner(name);
+    }
+
+    // Library session this session is linked against, if any.
+    HSession *get_base() noexcept
+    {
+        return mBase;
+    }
+
+    ast::HMethodDeclarations &get_declarations() noexcept
+    {
+        return mDeclarations;
+    }
+
+    ast::HPendingSpecializations &get_pending_specializations() noexcept
+    {
+        return mPendingSpecializations;
+    }
+
+    // Specializations of the methods defined in this session.
+    ast::HSpecializationGuard &get_specialization_guard() noexcept
+    {
+        return mSpecializationGuard;
+    }
+
+    // Constant arguments of calls of the methods defined in this session.
+    ast::HValueProfile &get_value_profile() noexcept
+    {
+        return mValueProfile;
+    }
+
+  private:
+    // Method bodies of this session are generated in compilation contexts of this session.
+    jit::HModuleGenerator get_module_generator()
+    {
+        return [this](llvm::function_ref<llvm::Error(HCompilationContext &)> body) {
+            return ast::gen_module(*this, body);
+        };
+    }
+
+    HSettings mSettings;
+
+    // Method ASTs, these need to outlive the JIT library as lazy stubs generate code from them.
+    ast::HMethodBuffer mMethods;
+    ast::HMethodDeclarations mDeclarations;
+    ast::HPendingSpecializations mPendingSpecializations;
+    ast::HValueProfile mValueProfile;
+    ast::HSpecializationGuard mSpecializationGuard;
+
+    // Library session this session is linked against.
+    HSession *mBase = nullptr;
+
+    std::shared_ptr<HContextPool> mContextPool;
+    HOptimizer mOptimizer;
+    std::shared_ptr<jit::HJIT> mJIT;
+    std::unique_ptr<jit::HJITLibrary> mLibrary;
+};
+} // namespace hannac
+#endif // SESSION_HPP
@@ -0,0 +1,202 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+// stdlib includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+
+// system includes.
+#include <malloc.h>
+#include <sys/resource.h>
+
+// hannac includes.
+#include "Allocations.hpp"
+#include "Optimizer.hpp"
+#include "Trace.hpp"
+
+namespace hannac
+{
+// Counters of one run of the compiler, summed over all sessions sharing a JIT and dumped as JSON by --stats-json.
+class HRunStats final
+{
+  public:
+    HRunStats() = default;
+    HRunStats(const HRunStats &) = delete;
+    HRunStats &operator=(const HRunStats &) = delete;
+
+    /****** Front end ******/
+    std::atomic<std::uint64_t> mTokens{0};
+    std::atomic<std::uint64_t> mMethodsParsed{0};
+
+    /****** JIT ******/
+    // Modules handed to the JIT, method batches as well as main statements.
+    std::atomic<std::uint64_t> mModules{0};
+    // Bytes of loaded text and of loaded data and bss sections.
+    std::atomic<std::uint64_t> mCodeBytes{0};
+    std::atomic<std::uint64_t> mDataBytes{0};
+    std::atomic<std::uint64_t> mTrackersCreated{0};
+    std::atomic<std::uint64_t> mTrackersRemoved{0};
+
+    /****** Executor ******/
+    std::atomic<std::uint64_t> mStatements{0};
+
+    // AST nodes by kind.
+    void add_nodes(std::map<std::string, std::uint64_t> const &nodes)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto const &[kind, count] : nodes)
+            mNodes[kind] += count;
+    }
+
+    // Specialization funcName of method was generated. Specializations generated again, e.g. after being evicted,
+    // count once.
+    void add_specialization(std::string const &method, std::string const &funcName)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSpecializations[method].insert(funcName);
+    }
+
+    // Pipeline chosen for a function by the optimizer of any session. Functions optimized again, e.g. after being
+    // evicted, keep their last decision.
+    void add_opt_decision(HOptDecision const &decision)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        (decision.mTier == HOptTier::Full ? mOptStats.mFull : mOptStats.mLight)++;
+        if (decision.mReason == HOptReason::OverBudget)
+            mOptStats.mOverBudget++;
+        mOptStats.mNanos += decision.mNanos;
+        mOptDecisions[decision.mFunction] = decision;
+    }
+
+    std::map<std::string, std::uint64_t> get_nodes()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNodes;
+    }
+
+    std::map<std::string, std::uint64_t> get_specializations()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::map<std::string, std::uint64_t> specializations;
+        for (auto const &[method, funcNames] : mSpecializations)
+            specializations[method] = funcNames.size();
+        return specializations;
+    }
+
+    std::map<std::string, HOptDecision> get_opt_decisions()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mOptDecisions;
+    }
+
+    HOptimizerStats get_opt_stats()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mOptStats;
+    }
+
+    // Peak resident set size of the process in bytes.
+    static std::uint64_t get_peak_rss() noexcept
+    {
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+        return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+    }
+
+    // Write all counters, the time spent per phase and the state of the heap as one JSON object.
+    void write_json(std::ostream &out, HTimeReport const &timeReport)
+    {
+        auto nodes = get_nodes();
+        auto specializations = get_specializations();
+        auto optStats = get_opt_stats();
+        std::uint64_t compiled = 0;
+        for (auto const &[method, count] : specializations)
+            compiled += count;
+
+        out << "{\n";
+        out << "  \"tokens\": " << mTokens << ",\n";
+        out << "  \"ast_nodes\": ";
+        write_map(out, nodes);
+        out << ",\n";
+        out << "  \"methods\": {\"parsed\": " << mMethodsParsed << ", \"compiled\": " << specializations.size()
+            << ", \"specializations\": " << compiled << "},\n";
+        out << "  \"specializations\": ";
+        write_map(out, specializations);
+        out << ",\n";
+        out << "  \"jit\": {\"modules\": " << mModules << ", \"code_bytes\": " << mCodeBytes
+            << ", \"data_bytes\": " << mDataBytes << ", \"trackers_created\": " << mTrackersCreated
+            << ", \"trackers_removed\": " << mTrackersRemoved << "},\n";
+        out << "  \"optimizer\": {\"full\": " << optStats.mFull << ", \"light\": " << optStats.mLight
+            << ", \"over_budget\": " << optStats.mOverBudget << ", \"ns\": " << optStats.mNanos << ", \"functions\": {";
+        bool first = true;
+        for (auto const &[function, decision] : get_opt_decisions())
+        {
+            out << (first ? "" : ", ") << "\"" << function << "\": {\"tier\": \"" << to_string(decision.mTier)
+                << "\", \"reason\": \"" << to_string(decision.mReason)
+                << "\", \"instructions\": " << decision.mInstructions << ", \"calls\": " << decision.mCallFrequency
+                << ", \"ns\": " << decision.mNanos << "}";
+            first = false;
+        }
+        out << "}},\n";
+        out << "  \"statements\": " << mStatements << ",\n";
+
+        out << "  \"phases_ns\": {";
+        for (std::size_t i = 0; i < static_cast<std::size_t>(HPhase::Count); i++)
+            out << (i > 0 ? ", " : "") << "\"" << to_string(static_cast<HPhase>(i))
+                << "\": " << timeReport.get(static_cast<HPhase>(i));
+        out << "},\n";
+
+        out << "  \"memory\": {\"peak_rss_bytes\": " << get_peak_rss();
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        auto heap = mallinfo2();
+        out << ", \"heap_in_use_bytes\": " << heap.uordblks << ", \"heap_mapped_bytes\": " << heap.hblkhd;
+#endif
+        out << "}";
+
+        // Only builds tracking allocations count them.
+        if (HAllocationTracker::enabled())
+        {
+            out << ",\n  \"allocations\": {";
+            for (std::size_t slot = 0; slot < HAllocationTracker::Slots; slot++)
+            {
+                auto allocations = HAllocationTracker::get_stats(static_cast<HPhase>(slot));
+                out << (slot > 0 ? ", " : "") << "\"" << HAllocationTracker::get_phase_name(slot)
+                    << "\": {\"count\": " << allocations.mAllocations << ", \"bytes\": " << allocations.mBytes
+                    << ", \"peak_live_bytes\": " << allocations.mPeakLiveBytes << "}";
+            }
+            out << "}";
+        }
+        out << "\n}" << std::endl;
+        return;
+    }
+
+  private:
+    // Keys are hanna identifiers and type names, they need no escaping.
+    static void write_map(std::ostream &out, std::map<std::string, std::uint64_t> const &map)
+    {
+        out << "{";
+        bool first = true;
+        for (auto const &[key, value] : map)
+        {
+            out << (first ? "" : ", ") << "\"" << key << "\": " << value;
+            first = false;
+        }
+        out << "}";
+        return;
+    }
+
+    std::mutex mMutex;
+    std::map<std::string, std::uint64_t> mNodes;
+    std::map<std::string, std::set<std::string>> mSpecializations;
+    std::map<std::string, HOptDecision> mOptDecisions;
+    HOptimizerStats mOptStats;
+};
+} // namespace hannac
+#endif // STATS_HPP
@@ -12,6 +12,8 @@
 #include "Executor.hpp"
 #include "GlobalSettings.hpp"
 #include "Lexer.hpp"
+#include "Session.hpp"
+#include "Trace.hpp"
 
 namespace hannac
 {
@@ -92,13 +94,17 @@ inline void print_token(HTokenRes &in)
 struct HTokenParser final
 {
   public:
-    explicit HTokenParser(HLexer &&lex) : mLexer{std::move(lex)}
+    HTokenParser(HSession &session, HLexer &&lex) : mSession(session), mLexer{std::move(lex)}
     {
     }
 
     // Parsing main driver.
     std::vector<std::unique_ptr<ast::Expression>> parse()
     {
+        // Lexing is interleaved with parsing, the span covers both.
+        HPhaseScope scope(mSession.get_jit().get_time_report(), HPhase::Parse, "Parse file",
+                          mLexer.get_path().string());
+
         // 1) Parse all method definitions.
         move_parser_ignore_eol();
         while (mCurrentToken.first != HTokenType::Main)
@@ -126,19 +132,47 @@ struct HTokenParser final
         while (mCurrentToken.first != HTokenType::END)
             queue_execution();
 
+        flush_stats();
         return std::move(mProgram);
     }
 
+    // Parse a library, i.e. a hanna file only defining methods.
+    void parse_library()
+    {
+        HPhaseScope scope(mSession.get_jit().get_time_report(), HPhase::Parse, "Parse file",
+                          mLexer.get_path().string());
+
+        move_parser_ignore_eol();
+        while (mCurrentToken.first != HTokenType::END)
+        {
+            switch (mCurrentToken.first)
+            {
+            case HTokenType::Method:
+                produce_method();
+                break;
+            case HTokenType::EOL:
+                break; // Ignore EOL here.
+            case HTokenType::Main:
+                throw ParseError("Libraries can't define main.");
+            default:
+                throw ParseError{"Unkown token."};
+            }
+        }
+
+        flush_stats();
+        return;
+    }
+
   private:
     // Move parser by one.
     inline HTokenRes move_parser_ignore_eol()
     {
         mWasEOL = false;
 
-        mCurrentToken = mLexer.get_token();
+        mCurrentToken = next_token();
         while (mCurrentToken.first == HTokenType::EOL)
         {
-            mCurrentToken = mLexer.get_token();
+            mCurrentToken = next_token();
             mWasEOL = true;
         }
 
@@ -147,11 +181,30 @@ struct HTokenParser final
 
     inline HTokenRes move_parser()
     {
-        mCurrentToken = mLexer.get_token();
+        mCurrentToken = next_token();
 
         return mCurrentToken;
     }
 
+    // Add the counters of this parser to the run statistics.
+    void flush_stats()
+    {
+        auto &stats = mSession.get_jit().get_run_stats();
+        stats.mTokens += mLexer.get_token_count() - mFlushedTokens;
+        mFlushedTokens = mLexer.get_token_count();
+        stats.mMethodsParsed += mNodes["FuncDef"];
+        stats.add_nodes(mNodes);
+        mNodes.clear();
+        return;
+    }
+
+    // Tokens are too small to trace, lexing is only timed.
+    inline HTokenRes next_token()
+    {
+        HPhaseScope scope(mSession.get_jit().get_time_report(), HPhase::Lex);
+        return mLexer.get_token();
+    }
+
     /******************************************************************************
      ********************************* METHODS ************************************
      *****************************************************************************/
@@ -164,17 +217,23 @@ struct HTokenParser final
         // 1) Parse declaration of the method.
         // Expected is "method <METHOD_NAME>(<COMMA_SEPERATED_ARGUMENT_LIST>)"
         // Eat method specifier.
+        auto line = mLexer.get_line();
         move_parser_ignore_eol();
         auto declaration = produce_declaration();
+        HPhaseScope scope(mSession.get_jit().get_time_report(), HPhase::Parse, "Parse method",
+                          declaration->get_name());
 
         // 2) Parse definition of the method which is basically an expression.
         // First thing to expect is a "return" since currently only one line statement methods are supported.
         if (mCurrentToken.first != HTokenType::Return)
             throw ParseError{"Non returning method: " + declaration->get_name()};
+        auto bodyLine = mLexer.get_line();
         move_parser_ignore_eol();
         auto definition = produce_expression();
         auto func = std::make_shared<hannac::ast::MethodDefinition>(std::move(declaration), std::move(definition));
-        if (HSettings::get_settings().get_verbose() > 1)
+        func->set_source(std::filesystem::absolute(mLexer.get_path()).string(), line, bodyLine);
+        mNodes["FuncDef"]++;
+        if (mSession.get_settings().get_verbose() > 1)
         {
             std::cout << "Produced function definition for: " << func->get_name() << "(";
             print_method_declaration(func);
@@ -183,13 +242,14 @@ struct HTokenParser final
         // 3) Put method in method buffer.
         // We are only lazy generating code for function. That means we are only setting up the function AST node
         // here and only generate the code for it if and when it is called.
-        if (ast::HMethodBuffer::get().find(func->get_name()) != ast::HMethodBuffer::get().end())
+        // Methods of a linked library can't be redefined either.
+        if (mSession.find_method(func->get_name()) != nullptr)
         {
             throw ParseError{"Redefinition of function " + func->get_name()};
         }
-        ast::HMethodBuffer::get().insert({func->get_name(), func});
+        mSession.get_methods().insert({func->get_name(), func});
 
-        if (HSettings::get_settings().get_verbose() > 1)
+        if (mSession.get_settings().get_verbose() > 1)
             std::cout << std::endl;
 
         return;
@@ -237,6 +297,7 @@ struct HTokenParser final
         // Eat ')'
         move_parser_ignore_eol();
 
+        mNodes["FuncDecl"]++;
         return std::make_shared<ast::MethodDeclaration>(methodName, std::move(args));
     }
 
@@ -262,9 +323,15 @@ struct HTokenParser final
         std::unique_ptr<ast::Expression> num;
         // Create number AST.
         if (mCurrentToken.first == HTokenType::Number)
+        {
             num = std::make_unique<ast::Number>(sign * std::get<std::int64_t>(mCurrentToken.second));
+            mNodes["Number"]++;
+        }
         else
+        {
             num = std::make_unique<ast::RealNumber>(sign * std::get<double>(mCurrentToken.second));
+            mNodes["RealNumber"]++;
+        }
 
         // Eat number and progress mCurrentToken.
         move_parser_ignore_eol();
@@ -274,6 +341,7 @@ struct HTokenParser final
 
     std::unique_ptr<ast::Expression> produce_var(std::string name)
     {
+        mNodes["Variable"]++;
         return std::make_unique<ast::Variable>(name);
     }
 
@@ -326,6 +394,7 @@ struct HTokenParser final
 
                 type = mCurrentToken.first;
             }
+            mNodes["MethodCall"]++;
             return std::make_unique<ast::MethodCall>(name, std::move(arguments));
         }
     }
@@ -424,6 +493,7 @@ struct HTokenParser final
             {
                 // Merge LHS/RHS
                 LHS = std::make_unique<ast::Binary>(binOp, std::move(LHS), std::move(RHS));
+                mNodes["Binary"]++;
                 return LHS;
             }
 
@@ -437,14 +507,20 @@ struct HTokenParser final
 
             // Merge LHS/RHS
             LHS = std::make_unique<ast::Binary>(binOp, std::move(LHS), std::move(RHS));
+            mNodes["Binary"]++;
         }
     }
 
+    HSession &mSession;
     HLexer mLexer;
     HTokenRes mCurrentToken;
     bool mWasEOL = false;
     std::map<char, int> mOpPrecedence{{'+', 20}, {'-', 20}, {'*', 40}, {'/', 40}};
     std::vector<std::unique_ptr<ast::Expression>> mProgram;
+
+    // AST nodes produced by kind since the last flush and tokens already added to the run statistics.
+    std::map<std::string, std::uint64_t> mNodes;
+    std::uint64_t mFlushedTokens = 0;
 };
 } // namespace hannac
 #endif // TOKENPARSER_HPP
\ No newline at end of file
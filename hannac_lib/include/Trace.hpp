@@ -0,0 +1,204 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// stdlib includes.
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// llvm includes.
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TimeProfiler.h"
+
+namespace hannac
+{
+// Phases of compiling and running a hanna program.
+enum class HPhase : std::uint8_t
+{
+    Lex = 0,
+    Parse = 1,
+    TypeInfer = 2,
+    IRGen = 3,
+    Opt = 4,
+    Codegen = 5,
+    Link = 6,
+    Execute = 7,
+    Count = 8
+};
+
+inline char const *to_string(HPhase phase) noexcept
+{
+    switch (phase)
+    {
+    case HPhase::Lex:
+        return "Lex";
+    case HPhase::Parse:
+        return "Parse";
+    case HPhase::TypeInfer:
+        return "Type inference";
+    case HPhase::IRGen:
+        return "IR generation";
+    case HPhase::Opt:
+        return "Optimization";
+    case HPhase::Codegen:
+        return "Code generation";
+    case HPhase::Link:
+        return "Link";
+    case HPhase::Execute:
+        return "Execute";
+    default:
+        return "";
+    }
+}
+
+// Time spent per phase, summed over all threads.
+// Phases nest, e.g. type inference runs while generating IR. Time is accounted to the innermost phase only.
+class HTimeReport final
+{
+  public:
+    explicit HTimeReport(bool enabled = false) : mEnabled(enabled)
+    {
+    }
+
+    HTimeReport(const HTimeReport &) = delete;
+    HTimeReport &operator=(const HTimeReport &) = delete;
+
+    bool enabled() const noexcept
+    {
+        return mEnabled;
+    }
+
+    void add(HPhase phase, std::uint64_t nanos) noexcept
+    {
+        mNanos[static_cast<std::size_t>(phase)] += nanos;
+    }
+
+    std::uint64_t get(HPhase phase) const noexcept
+    {
+        return mNanos[static_cast<std::size_t>(phase)];
+    }
+
+    void print(std::ostream &out) const
+    {
+        std::uint64_t total = 0;
+        for (auto const &nanos : mNanos)
+            total += nanos;
+
+        out << "Time report:" << std::endl;
+        for (std::size_t i = 0; i < mNanos.size(); i++)
+        {
+            auto nanos = mNanos[i].load();
+            out << "\t" << std::left << std::setw(16) << to_string(static_cast<HPhase>(i)) << std::right
+                << std::setw(12) << std::fixed << std::setprecision(3) << nanos / 1e6 << "ms" << std::setw(8)
+                << std::setprecision(1) << (total > 0 ? 100.0 * nanos / total : 0.0) << "%" << std::endl;
+        }
+        out << "\t" << std::left << std::setw(16) << "Total" << std::right << std::setw(12) << std::setprecision(3)
+            << total / 1e6 << "ms" << std::endl;
+        out.unsetf(std::ios::floatfield);
+        return;
+    }
+
+  private:
+    bool mEnabled;
+    std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(HPhase::Count)> mNanos{};
+};
+
+// Times a phase for the time report and traces it as span, if the time trace profiler runs on this thread.
+// Time spent in scopes nested on the same thread counts for the nested phase only.
+class HPhaseScope final
+{
+  public:
+    // Spans need a name, scopes without one are only timed.
+    HPhaseScope(HTimeReport &report, HPhase phase, llvm::StringRef name = {}, llvm::StringRef detail = {})
+        : mReport(report), mPhase(phase), mTraced(!name.empty() && llvm::timeTraceProfilerEnabled()),
+          mOuterPhase(sPhase)
+    {
+        sPhase = phase;
+        if (mTraced)
+            llvm::timeTraceProfilerBegin(name, detail);
+        if (!mReport.enabled())
+            return;
+
+        auto now = std::chrono::steady_clock::now();
+        mParent = sCurrent;
+        if (mParent != nullptr)
+            mParent->pause(now);
+        sCurrent = this;
+        mStart = now;
+    }
+
+    HPhaseScope(const HPhaseScope &) = delete;
+    HPhaseScope &operator=(const HPhaseScope &) = delete;
+
+    ~HPhaseScope()
+    {
+        sPhase = mOuterPhase;
+        if (mReport.enabled())
+        {
+            auto now = std::chrono::steady_clock::now();
+            pause(now);
+            sCurrent = mParent;
+            if (mParent != nullptr)
+                mParent->mStart = now;
+        }
+        if (mTraced)
+            llvm::timeTraceProfilerEnd();
+    }
+
+    // Innermost phase running on the calling thread, HPhase::Count outside of any phase. Tracked whether or not the
+    // time report is enabled, allocations are tagged with it.
+    static HPhase get_current_phase() noexcept
+    {
+        return sPhase;
+    }
+
+  private:
+    void pause(std::chrono::steady_clock::time_point now)
+    {
+        mReport.add(mPhase, std::chrono::duration_cast<std::chrono::nanoseconds>(now - mStart).count());
+    }
+
+    static inline thread_local HPhaseScope *sCurrent = nullptr;
+    static inline thread_local HPhase sPhase = HPhase::Count;
+
+    HTimeReport &mReport;
+    HPhase mPhase;
+    bool mTraced;
+    HPhaseScope *mParent = nullptr;
+    std::chrono::steady_clock::time_point mStart;
+    HPhase mOuterPhase;
+};
+
+/******************************************************************************
+ ********************************** TRACE *************************************
+ *****************************************************************************/
+
+// The time trace profiler records spans of the calling thread only. Every other thread has to start its own and finish
+// it before the trace is written.
+inline void start_thread_trace()
+{
+    llvm::timeTraceProfilerInitialize(0, "hannac");
+    return;
+}
+
+inline void finish_thread_trace()
+{
+    llvm::timeTraceProfilerFinishThread();
+    return;
+}
+
+// Write the spans of all threads as Chrome trace to path and stop tracing.
+inline llvm::Error write_trace(std::string const &path)
+{
+    auto error = llvm::timeTraceProfilerWrite(path, "hannac");
+    llvm::timeTraceProfilerCleanup();
+    return error;
+}
+} // namespace hannac
+#endif // TRACE_HPP
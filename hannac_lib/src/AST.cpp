@@ -1,18 +1,230 @@
 // stdlib includes
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
 #include <string>
 #include <vector>
 
+// llvm includes.
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/IR/DIBuilder.h"
+
 // hanna includes.
 #include "AST.hpp"
 #include "Codegen.hpp"
+#include "ObjectCache.hpp"
+#include "Profiler.hpp"
+#include "Session.hpp"
+#include "Trace.hpp"
 
 namespace hannac
 {
 namespace ast
 {
+namespace
+{
+// Failure of a producer of the specialization registry.
+struct CompileError : public std::exception
+{
+  public:
+    CompileError(std::string const &message) : mMessage{message}
+    {
+    }
+
+    const char *what() const throw()
+    {
+        return mMessage.c_str();
+    }
+
+  private:
+    std::string mMessage;
+};
+
+HConstantArgument const *find_constant(HConstantArguments const &constants, std::size_t index)
+{
+    auto constant = std::find_if(constants.begin(), constants.end(),
+                                 [index](HConstantArgument const &el) { return el.mIndex == index; });
+    return constant != constants.end() ? &*constant : nullptr;
+}
+
+llvm::Constant *gen_constant(HCompilationContext &ctx, HConstantArgument const &constant)
+{
+    if (constant.mType == ASTType::RealNumber)
+        return llvm::ConstantFP::get(ctx.get_context(), llvm::APFloat(constant.mReal));
+    return llvm::ConstantInt::get(ctx.get_context(), llvm::APInt(64, constant.mInt, true));
+}
+
+// Type of boxed values, see HSpecializationGuard.
+llvm::StructType *gen_boxed_type(HCompilationContext &ctx)
+{
+    auto int64 = llvm::Type::getInt64Ty(ctx.get_context());
+    return llvm::StructType::get(ctx.get_context(), {int64, int64});
+}
+
+llvm::Value *box(HCompilationContext &ctx, llvm::Value *value)
+{
+    auto &builder = ctx.get_builder();
+    auto real = value->getType()->isDoubleTy();
+    llvm::Value *boxed = llvm::PoisonValue::get(gen_boxed_type(ctx));
+    boxed = builder.CreateInsertValue(boxed, builder.getInt64(real ? 1 : 0), 0);
+    return builder.CreateInsertValue(boxed, real ? builder.CreateBitCast(value, builder.getInt64Ty()) : value, 1);
+}
+
+llvm::Value *unbox(HCompilationContext &ctx, llvm::Value *boxed, ASTType type)
+{
+    auto &builder = ctx.get_builder();
+    auto payload = builder.CreateExtractValue(boxed, 1, "payload");
+    return type == ASTType::RealNumber ? builder.CreateBitCast(payload, builder.getDoubleTy()) : payload;
+}
+
+// Arithmetic on two ints or two doubles.
+llvm::Value *gen_binary_op(HCompilationContext &ctx, char op, llvm::Value *left, llvm::Value *right, bool real)
+{
+    auto &builder = ctx.get_builder();
+    switch (op)
+    {
+    case '+':
+        return real ? builder.CreateFAdd(left, right, "dadd") : builder.CreateAdd(left, right, "add");
+    case '-':
+        return real ? builder.CreateFSub(left, right, "dsub") : builder.CreateSub(left, right, "sub");
+    case '*':
+        return real ? builder.CreateFMul(left, right, "dmull") : builder.CreateMul(left, right, "mull");
+    case '/':
+        return real ? builder.CreateFDiv(left, right, "ddiv") : builder.CreateSDiv(left, right, "div");
+    default:
+        std::cout << "Unknown binary operator provided." << std::endl;
+        return nullptr;
+    }
+}
+
+// Arithmetic on boxed values. Ints are converted to double if the other operand is a double.
+llvm::Value *gen_boxed_binary_op(HCompilationContext &ctx, char op, llvm::Value *left, llvm::Value *right)
+{
+    auto &builder = ctx.get_builder();
+    auto &context = ctx.get_context();
+    auto leftTag = builder.CreateExtractValue(left, 0, "ltag");
+    auto rightTag = builder.CreateExtractValue(right, 0, "rtag");
+    auto leftPayload = builder.CreateExtractValue(left, 1, "lpayload");
+    auto rightPayload = builder.CreateExtractValue(right, 1, "rpayload");
+    auto real = builder.CreateICmpNE(builder.CreateOr(leftTag, rightTag), builder.getInt64(0), "isreal");
+
+    auto func = builder.GetInsertBlock()->getParent();
+    auto realBlock = llvm::BasicBlock::Create(context, "real", func);
+    auto intBlock = llvm::BasicBlock::Create(context, "int", func);
+    auto mergeBlock = llvm::BasicBlock::Create(context, "merge", func);
+    builder.CreateCondBr(real, realBlock, intBlock);
+
+    // Branch instead of select, integer division of double bits may trap.
+    builder.SetInsertPoint(realBlock);
+    auto to_real = [&builder](llvm::Value *tag, llvm::Value *payload) {
+        return builder.CreateSelect(builder.CreateICmpNE(tag, builder.getInt64(0)),
+                                    builder.CreateBitCast(payload, builder.getDoubleTy()),
+                                    builder.CreateSIToFP(payload, builder.getDoubleTy()));
+    };
+    auto realResult = gen_binary_op(ctx, op, to_real(leftTag, leftPayload), to_real(rightTag, rightPayload), true);
+    if (realResult == nullptr)
+        return nullptr;
+    realResult = builder.CreateBitCast(realResult, builder.getInt64Ty());
+    builder.CreateBr(mergeBlock);
+
+    builder.SetInsertPoint(intBlock);
+    auto intResult = gen_binary_op(ctx, op, leftPayload, rightPayload, false);
+    builder.CreateBr(mergeBlock);
+
+    builder.SetInsertPoint(mergeBlock);
+    auto tag = builder.CreateZExt(real, builder.getInt64Ty(), "tag");
+    auto payload = builder.CreatePHI(builder.getInt64Ty(), 2, "payload");
+    payload->addIncoming(realResult, realBlock);
+    payload->addIncoming(intResult, intBlock);
+
+    llvm::Value *boxed = llvm::PoisonValue::get(gen_boxed_type(ctx));
+    boxed = builder.CreateInsertValue(boxed, tag, 0);
+    return builder.CreateInsertValue(boxed, payload, 1);
+}
+
+// Count the calls of a call site passing constants and decide whether it calls a clone with the constants baked in.
+// site is the call in the AST, it tells the call sites of one caller apart.
+bool use_clone(HCompilationContext &ctx, std::string const &name, std::vector<ASTType> const &argTypes,
+               HConstantArguments const &constants, void const *site)
+{
+    auto &session = ctx.get_session();
+    auto const &settings = session.get_settings();
+    if (settings.get_clone_threshold() == 0 || settings.get_emit_type() != HEmitType::JIT)
+        return false;
+
+    // The call site runs as often as the function it is generated into.
+    auto caller = ctx.get_builder().GetInsertBlock()->getParent();
+    auto calls = session.get_optimizer().get_call_frequency(caller->getName().str());
+
+    // Clones of library methods live in the library, the calls of all programs count.
+    auto &owner = session.get_method_owner(name);
+    auto &profile = owner.get_value_profile();
+    auto cloneName = produce_clone_name(name, argTypes, constants);
+    std::uint64_t total;
+    bool created = false;
+    {
+        std::lock_guard<std::mutex> lock(profile.mMutex);
+        auto &count = profile.mCalls[cloneName];
+        auto &sites = profile.mCallSites[cloneName];
+        if (sites.insert({session.get_library().get_name(), caller->getName().str(), site}).second)
+        {
+            auto const max = std::numeric_limits<std::uint64_t>::max();
+            count = calls > max - count ? max : count + calls;
+        }
+        total = count;
+        if (profile.mClones.find(cloneName) == profile.mClones.end())
+        {
+            if (total < settings.get_clone_threshold() || profile.mClones.size() >= settings.get_max_clones())
+                return false;
+            profile.mClones.insert(cloneName);
+            created = true;
+        }
+    }
+
+    // The clone is called as often as the call sites calling it.
+    owner.get_optimizer().set_call_frequencies({{cloneName, total}});
+    if (created && settings.get_verbose() > 0)
+        std::cout << "Cloning " << produce_func_name(name, argTypes) << " for constant arguments: " << cloneName
+                  << " (" << total << " predicted calls)." << std::endl;
+
+    return true;
+}
+
+// Whether generated methods are profiled. Only JIT code can embed the address of the profiler.
+bool is_profiled(HSession &session)
+{
+    return session.get_jit().get_profiler().enabled() && session.get_settings().get_emit_type() == HEmitType::JIT;
+}
+
+// Call hook of the profiler for slot, see HProfiler::enter and HProfiler::exit.
+void gen_profile_call(HCompilationContext &ctx, void (*hook)(HProfiler *, std::uint64_t), std::uint64_t slot)
+{
+    auto &builder = ctx.get_builder();
+    auto type = llvm::FunctionType::get(builder.getVoidTy(), {builder.getPtrTy(), builder.getInt64Ty()}, false);
+    auto profiler = reinterpret_cast<std::uintptr_t>(&ctx.get_session().get_jit().get_profiler());
+    auto callee = builder.CreateIntToPtr(builder.getInt64(reinterpret_cast<std::uintptr_t>(hook)), builder.getPtrTy());
+    builder.CreateCall(
+        type, callee, {builder.CreateIntToPtr(builder.getInt64(profiler), builder.getPtrTy()), builder.getInt64(slot)});
+    return;
+}
+} // namespace
+
+/******************************************************************************
+ ******************************** Expression **********************************
+ *****************************************************************************/
+llvm::Value *Expression::codegen_boxed(HCompilationContext &ctx)
+{
+    std::cout << "No generic code for " << get_name() << "." << std::endl;
+    return nullptr;
+}
+
 /******************************************************************************
  ******************************** Variables ***********************************
  *****************************************************************************/
@@ -23,9 +235,14 @@ Number::Number(std::int64_t const &number) : Expression{ASTType::Number}, mNum{n
 }
 
 // Codegen.
-llvm::Value *Number::codegen()
+llvm::Value *Number::codegen(HCompilationContext &ctx)
+{
+    return llvm::ConstantInt::get(ctx.get_context(), llvm::APInt(64, mNum, true));
+}
+
+llvm::Value *Number::codegen_boxed(HCompilationContext &ctx)
 {
-    return llvm::ConstantInt::get(*HContextSingelton::get_context().mContext, llvm::APInt(64, mNum, true));
+    return box(ctx, codegen(ctx));
 }
 
 std::string Number::get_name() const noexcept
@@ -33,15 +250,30 @@ std::string Number::get_name() const noexcept
     return std::to_string(mNum);
 }
 
+std::string Number::get_ast_string() const
+{
+    return "i" + std::to_string(mNum);
+}
+
+ASTType Number::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    return ASTType::Number;
+}
+
 /****************************** Real Number ******************************/
 RealNumber::RealNumber(double const &number) : Expression{ASTType::RealNumber}, mNum{number}
 {
 }
 
 // Codegen.
-llvm::Value *RealNumber::codegen()
+llvm::Value *RealNumber::codegen(HCompilationContext &ctx)
 {
-    return llvm::ConstantFP::get(*HContextSingelton::get_context().mContext, llvm::APFloat(mNum));
+    return llvm::ConstantFP::get(ctx.get_context(), llvm::APFloat(mNum));
+}
+
+llvm::Value *RealNumber::codegen_boxed(HCompilationContext &ctx)
+{
+    return box(ctx, codegen(ctx));
 }
 
 std::string RealNumber::get_name() const noexcept
@@ -49,26 +281,62 @@ std::string RealNumber::get_name() const noexcept
     return std::to_string(mNum);
 }
 
+std::string RealNumber::get_ast_string() const
+{
+    // Use the bit pattern, decimal representations are not exact.
+    std::uint64_t bits;
+    std::memcpy(&bits, &mNum, sizeof(bits));
+    return "r" + std::to_string(bits);
+}
+
+ASTType RealNumber::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    return ASTType::RealNumber;
+}
+
 /******************************* Variable ********************************/
 Variable::Variable(std::string const &name) : Expression{ASTType::Variable}, mName{name}
 {
 }
 
-llvm::Value *Variable::codegen()
+llvm::Value *Variable::codegen(HCompilationContext &ctx)
 {
-    if (HNamesMap::get().find(mName) == HNamesMap::get().end())
+    if (ctx.get_names().find(mName) == ctx.get_names().end())
         std::cout << "Unknown variable referenced." << std::endl;
     else
-        return HNamesMap::get()[mName];
+        return ctx.get_names()[mName];
 
     return nullptr;
 }
 
+// Arguments of generic versions are boxed already.
+llvm::Value *Variable::codegen_boxed(HCompilationContext &ctx)
+{
+    return codegen(ctx);
+}
+
 std::string Variable::get_name() const noexcept
 {
     return mName;
 }
 
+std::string Variable::get_ast_string() const
+{
+    return "v" + mName;
+}
+
+ASTType Variable::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    auto type = variables.find(mName);
+    if (type == variables.end())
+    {
+        std::cout << "Unknown variable referenced." << std::endl;
+        return ASTType::Variable;
+    }
+
+    return type->second;
+}
+
 /******************************************************************************
  ******************************** Opertations *********************************
  *****************************************************************************/
@@ -80,12 +348,12 @@ Binary::Binary(char op, std::unique_ptr<Expression> left, std::unique_ptr<Expres
 }
 
 // Codegen.
-llvm::Value *Binary::codegen()
+llvm::Value *Binary::codegen(HCompilationContext &ctx)
 {
     // mLHS, mRHS get_name and assosicate with type.
     // ToDo
-    auto left = mLHS->codegen();
-    auto right = mRHS->codegen();
+    auto left = mLHS->codegen(ctx);
+    auto right = mRHS->codegen(ctx);
 
     if (left == nullptr || right == nullptr)
         return nullptr;
@@ -97,32 +365,17 @@ llvm::Value *Binary::codegen()
     mReturnType =
         (lType == llvm::Type::DoubleTyID || rType == llvm::Type::DoubleTyID) ? ASTType::RealNumber : ASTType::Number;
 
-    switch (mOperator)
-    {
-    case '+':
-        if (mReturnType == ASTType::RealNumber)
-            return HBuilderSingelton::get_builder().mBuilder->CreateFAdd(left, right, "dadd");
-        else
-            return HBuilderSingelton::get_builder().mBuilder->CreateAdd(left, right, "add");
-    case '-':
-        if (mReturnType == ASTType::RealNumber)
-            return HBuilderSingelton::get_builder().mBuilder->CreateFSub(left, right, "dsub");
-        else
-            return HBuilderSingelton::get_builder().mBuilder->CreateSub(left, right, "sub");
-    case '*':
-        if (mReturnType == ASTType::RealNumber)
-            return HBuilderSingelton::get_builder().mBuilder->CreateFMul(left, right, "dmull");
-        else
-            return HBuilderSingelton::get_builder().mBuilder->CreateMul(left, right, "mull");
-    case '/':
-        if (mReturnType == ASTType::RealNumber)
-            return HBuilderSingelton::get_builder().mBuilder->CreateFDiv(left, right, "ddiv");
-        else
-            return HBuilderSingelton::get_builder().mBuilder->CreateSDiv(left, right, "div");
-    default:
-        std::cout << "Unknown binary operator provided." << std::endl;
+    return gen_binary_op(ctx, mOperator, left, right, mReturnType == ASTType::RealNumber);
+}
+
+llvm::Value *Binary::codegen_boxed(HCompilationContext &ctx)
+{
+    auto left = mLHS->codegen_boxed(ctx);
+    auto right = mRHS->codegen_boxed(ctx);
+    if (left == nullptr || right == nullptr)
         return nullptr;
-    }
+
+    return gen_boxed_binary_op(ctx, mOperator, left, right);
 }
 
 std::string Binary::get_name() const noexcept
@@ -130,6 +383,29 @@ std::string Binary::get_name() const noexcept
     return "Expression";
 }
 
+std::string Binary::get_ast_string() const
+{
+    return "(" + mLHS->get_ast_string() + mOperator + mRHS->get_ast_string() + ")";
+}
+
+ASTType Binary::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    auto left = mLHS->infer_type(session, variables);
+    auto right = mRHS->infer_type(session, variables);
+    if ((left != ASTType::Number && left != ASTType::RealNumber) ||
+        (right != ASTType::Number && right != ASTType::RealNumber))
+        return ASTType::Variable;
+
+    return (left == ASTType::RealNumber || right == ASTType::RealNumber) ? ASTType::RealNumber : ASTType::Number;
+}
+
+void Binary::collect_calls(HSession &session, std::map<std::string, ASTType> const &variables,
+                           HSpecializationList &calls) const
+{
+    mLHS->collect_calls(session, variables, calls);
+    mRHS->collect_calls(session, variables, calls);
+}
+
 ASTType Binary::get_return_type() const noexcept
 {
     return mReturnType;
@@ -151,42 +427,19 @@ MethodDeclaration::MethodDeclaration(std::string const &name, std::vector<std::s
 {
 }
 
-llvm::Function *MethodDeclaration::codegen()
+llvm::Function *MethodDeclaration::codegen(HCompilationContext &ctx)
 {
-    llvm::FunctionType *proto;
-    std::vector<llvm::Type *> types;
-
     if (mArgTypes.size() != mArguments.size())
     {
         std::cout << "Mismatch between argument definition and arguments provided to function call" << std::endl;
         return nullptr;
     }
 
-    // Create types for input arguments.
-    size_t i = 0;
-    for (auto const &el : mArgTypes)
-    {
-        if (el == ASTType::RealNumber)
-            types.push_back(llvm::Type::getDoubleTy(*HContextSingelton::get_context().mContext));
-        else
-            types.push_back(llvm::Type::getInt64Ty(*HContextSingelton::get_context().mContext));
-    }
-
-    // Create function prototype.
-    if (mReturnType == ASTType::RealNumber)
-        proto =
-            llvm::FunctionType::get(llvm::Type::getDoubleTy(*HContextSingelton::get_context().mContext), types, false);
-    else
-        proto =
-            llvm::FunctionType::get(llvm::Type::getInt64Ty(*HContextSingelton::get_context().mContext), types, false);
-
     // Create func.
-    llvm::Function *func =
-        llvm::Function::Create(proto, llvm::Function::ExternalLinkage, produce_func_name(mName, mArgTypes),
-                               HModuleSingelton::get_module().mModule.get());
+    llvm::Function *func = gen_func_decl(ctx, mName, mArgTypes, mReturnType);
 
     // Set argument names.
-    i = 0;
+    size_t i = 0;
     for (auto &arg : func->args())
         arg.setName(mArguments[i++]);
 
@@ -198,6 +451,19 @@ std::string MethodDeclaration::get_name() const noexcept
     return mName;
 }
 
+std::string MethodDeclaration::get_ast_string() const
+{
+    std::string str{mName + "("};
+    for (auto const &el : mArguments)
+        str += el + ",";
+    return str + ")";
+}
+
+ASTType MethodDeclaration::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    return mReturnType;
+}
+
 void MethodDeclaration::set_arg_types(std::vector<ASTType> argTypes) noexcept
 {
     mArgTypes = argTypes;
@@ -229,75 +495,215 @@ std::string MethodDefinition::get_name() const noexcept
     return mDeclaration->get_name();
 }
 
+std::string MethodDefinition::get_ast_string() const
+{
+    return mDeclaration->get_ast_string() + "=" + mFuncBody->get_ast_string();
+}
+
 // Codegen.
-llvm::Function *MethodDefinition::codegen()
+llvm::Function *MethodDefinition::codegen(HCompilationContext &ctx)
 {
-    // For the scope of this method the arguments this function is called with need to exist.
+    return gen_specialization(ctx, false);
+}
 
-    // In case expression to evaluate for this function is itself a function call,
-    // generate this called function only now.
-    llvm::Value *ret = nullptr;
-    std::vector<std::shared_ptr<llvm::Argument>> vec;
-    std::shared_ptr<llvm::Argument> llvmVal;
-    if (mFuncBody->get_type() == ASTType::MethodCall)
+llvm::Function *MethodDefinition::gen_specialization(HCompilationContext &ctx, bool profile)
+{
+    // The return type follows from the argument types this specialization is generated for.
+    auto &session = ctx.get_session();
+    mReturnType = infer_return_type(session, mArgTypes);
+    if (mReturnType != ASTType::Number && mReturnType != ASTType::RealNumber)
+        return nullptr;
+
+    // Produce function declaration.
+    std::string name = get_name();
+    mDeclaration->set_arg_types(mArgTypes);
+    mDeclaration->set_return_type(mReturnType);
     {
-        gen_buffered_func();
+        std::lock_guard<std::mutex> lock(session.get_declarations().mMutex);
+        session.get_declarations().mFunctions[produce_func_name(name, mArgTypes)] = {mDeclaration, mReturnType};
     }
-    else // Expression
+    llvm::Function *func = mDeclaration->codegen(ctx);
+    if (func == nullptr)
+        return nullptr;
+
+    return gen_body(ctx, func, produce_func_name(name, mArgTypes), {}, profile);
+}
+
+llvm::Function *MethodDefinition::codegen_specialization(HCompilationContext &ctx, std::vector<ASTType> const &argTypes)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    set_arg_types(argTypes);
+    auto func = gen_specialization(ctx, true);
+    if (func != nullptr)
+        ctx.get_session().get_jit().get_run_stats().add_specialization(get_name(), func->getName().str());
+    return func;
+}
+
+llvm::Function *MethodDefinition::codegen_clone(HCompilationContext &ctx, std::vector<ASTType> const &argTypes,
+                                                HConstantArguments const &constants)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    set_arg_types(argTypes);
+    auto &session = ctx.get_session();
+    mReturnType = infer_return_type(session, mArgTypes);
+    if (mReturnType != ASTType::Number && mReturnType != ASTType::RealNumber)
+        return nullptr;
+
+    // Constant arguments are no parameters of the clone.
+    std::vector<ASTType> remaining;
+    for (size_t i = 0; i < argTypes.size(); i++)
     {
-        HNamesMap::get().clear();
-        size_t i = 0;
-        for (auto const &el : mDeclaration->get_arguments())
-        {
+        if (find_constant(constants, i) == nullptr)
+            remaining.push_back(argTypes[i]);
+    }
 
-            vec.push_back(llvmVal);
-            if (mArgTypes[i++] == ASTType::RealNumber)
-                llvmVal = std::make_shared<llvm::Argument>(
-                    llvm::Type::getDoubleTy(*HContextSingelton::get_context().mContext), el);
-            else
-                llvmVal = std::make_shared<llvm::Argument>(
-                    llvm::Type::getInt64Ty(*HContextSingelton::get_context().mContext), el);
+    auto cloneName = produce_clone_name(get_name(), mArgTypes, constants);
+    auto func = gen_body(ctx, gen_func_proto(ctx, cloneName, remaining, mReturnType), cloneName, constants, true);
+    if (func != nullptr)
+        session.get_jit().get_run_stats().add_specialization(get_name(), cloneName);
+    return func;
+}
 
-            HNamesMap::get()[std::string(el)] = llvmVal.get();
-        }
-        // Generate expression in order to know return type.
-        ret = mFuncBody->codegen();
-        // Set return type.
-        mDeclaration->set_return_type(mFuncBody->get_return_type());
-        mReturnType = mFuncBody->get_return_type();
+llvm::Function *MethodDefinition::codegen_generic(HCompilationContext &ctx)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto &session = ctx.get_session();
+    auto const arguments = mDeclaration->get_arguments();
+    auto func = gen_generic_decl(ctx, get_name(), arguments.size());
+    if (!func->empty())
+        return func;
+
+    auto &timeReport = session.get_jit().get_time_report();
+    HPhaseScope scope(timeReport, HPhase::IRGen, "Generate", func->getName());
+    auto &builder = ctx.get_builder();
+    builder.SetInsertPoint(llvm::BasicBlock::Create(ctx.get_context(), "Entry", func));
+    builder.SetCurrentDebugLocation(gen_debug_info(ctx, func, get_name() + "(generic)"));
+    auto resetLocation = llvm::make_scope_exit([&builder]() { builder.SetCurrentDebugLocation(llvm::DebugLoc()); });
+    ctx.get_names().clear();
+    std::size_t i = 0;
+    for (auto &arg : func->args())
+    {
+        arg.setName(arguments[i]);
+        ctx.get_names()[arguments[i++]] = &arg;
     }
 
-    // Produce function declaration.
-    std::string name = get_name();
-    HMethodDeclarations::get()[produce_func_name(name, mArgTypes)] = {mDeclaration, mReturnType};
-    llvm::Function *func = gen_func_decl(name, mArgTypes, mReturnType);
-    if (func == nullptr)
+    // Count calls, the counter lives as long as the session. The code embeds its address, so it is never cached.
+    std::atomic<std::uint64_t> *calls;
+    {
+        auto &guard = session.get_specialization_guard();
+        std::lock_guard<std::mutex> guardLock(guard.mMutex);
+        auto &counter = guard.mCalls[get_name()];
+        if (counter == nullptr)
+            counter = std::make_unique<std::atomic<std::uint64_t>>(0);
+        calls = counter.get();
+    }
+    builder.CreateAtomicRMW(
+        llvm::AtomicRMWInst::Add,
+        builder.CreateIntToPtr(builder.getInt64(reinterpret_cast<std::uintptr_t>(calls)), builder.getPtrTy()),
+        builder.getInt64(1), llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+
+    std::optional<std::uint64_t> profileSlot;
+    if (is_profiled(session))
+    {
+        profileSlot = session.get_jit().get_profiler().get_slot(session.get_library().get_name(),
+                                                                func->getName().str(), get_name(), "(generic)");
+        gen_profile_call(ctx, &HProfiler::enter, *profileSlot);
+    }
+
+    auto ret = mFuncBody->codegen_boxed(ctx);
+    if (ret == nullptr)
+    {
+        func->eraseFromParent();
         return nullptr;
+    }
+    if (profileSlot)
+        gen_profile_call(ctx, &HProfiler::exit, *profileSlot);
+    builder.CreateRet(ret);
+    llvm::verifyFunction(*func);
+    session.get_jit().get_run_stats().add_specialization(get_name(), func->getName().str());
+
+    if (session.get_settings().get_opt_level() > 0)
+    {
+        HPhaseScope optScope(timeReport, HPhase::Opt, "Optimize", func->getName());
+        auto decision = session.get_optimizer().optimize(ctx.get_fpm(), *func, produce_generic_name(get_name()));
+        session.get_jit().get_run_stats().add_opt_decision(decision);
+    }
+
+    return func;
+}
+
+llvm::Function *MethodDefinition::gen_body(HCompilationContext &ctx, llvm::Function *func, std::string const &funcName,
+                                           HConstantArguments const &constants, bool profile)
+{
+    auto &session = ctx.get_session();
+
+    // Already generated into this module.
+    if (!func->empty())
+        return func;
+
+    auto &timeReport = session.get_jit().get_time_report();
+    HPhaseScope scope(timeReport, HPhase::IRGen, "Generate", funcName);
 
     // Actually create function now.
-    llvm::BasicBlock *block = llvm::BasicBlock::Create(*HContextSingelton::get_context().mContext, "Entry", func);
-    HBuilderSingelton::get_builder().mBuilder->SetInsertPoint(block);
+    llvm::BasicBlock *block = llvm::BasicBlock::Create(ctx.get_context(), "Entry", func);
+    ctx.get_builder().SetInsertPoint(block);
+
+    // Methods are one expression, all code belongs to the line of the body. Nothing generated afterwards does.
+    auto displayName = produce_display_name(get_name(), mArgTypes) + (constants.empty() ? "" : " clone");
+    ctx.get_builder().SetCurrentDebugLocation(gen_debug_info(ctx, func, displayName));
+    auto resetLocation =
+        llvm::make_scope_exit([&ctx]() { ctx.get_builder().SetCurrentDebugLocation(llvm::DebugLoc()); });
+
+    // Add function args to name map, constant arguments are replaced by their value.
+    ctx.get_names().clear();
+    auto const arguments = mDeclaration->get_arguments();
+    auto arg = func->arg_begin();
+    for (size_t i = 0; i < arguments.size(); i++)
+    {
+        if (auto constant = find_constant(constants, i))
+        {
+            ctx.get_names()[arguments[i]] = gen_constant(ctx, *constant);
+            continue;
+        }
 
-    // Add function args to name map.
-    HNamesMap::get().clear();
-    for (auto &arg : func->args())
-        HNamesMap::get()[std::string(arg.getName())] = &arg;
+        arg->setName(arguments[i]);
+        ctx.get_names()[arguments[i]] = &*arg++;
+    }
 
-    ret = mFuncBody->codegen();
+    // Profiled code embeds the address of the profiler and the slot of the function.
+    std::optional<std::uint64_t> profileSlot;
+    if (profile && is_profiled(session))
+    {
+        auto signature = displayName.substr(get_name().size()) + (constants.empty() ? "" : " [" + funcName + "]");
+        auto &profiler = session.get_jit().get_profiler();
+        profileSlot = profiler.get_slot(session.get_library().get_name(), funcName, get_name(), signature);
+        gen_profile_call(ctx, &HProfiler::enter, *profileSlot);
+    }
+
+    llvm::Value *ret = mFuncBody->codegen(ctx);
 
     if (ret)
     {
         // Finish off the function.
-        HBuilderSingelton::get_builder().mBuilder->CreateRet(ret);
+        if (profileSlot)
+            gen_profile_call(ctx, &HProfiler::exit, *profileSlot);
+        ctx.get_builder().CreateRet(ret);
 
         // Validate the generated code, checking for consistency.
         llvm::verifyFunction(*func);
 
-        FPM fpm;
-        fpm.mFuncPassManager->run(*func, *fpm.mFuncAnalysisManager);
+        // Tag function with its AST so its object can be found in the object cache. Profiled code is never cached.
+        if (!profileSlot)
+            func->addFnAttr(jit::HASTHashAttribute, jit::HObjectCache::hash(get_ast_string()));
 
-        mDeclaration->set_return_type(mFuncBody->get_return_type());
-        mReturnType = mFuncBody->get_return_type();
+        // The pipeline is part of the cache key. Whether the object is cached is only known for the final module,
+        // batching and call counting still add to it, so the compile layer decides that.
+        if (session.get_settings().get_opt_level() > 0)
+        {
+            HPhaseScope optScope(timeReport, HPhase::Opt, "Optimize", funcName);
+            auto decision = session.get_optimizer().optimize(ctx.get_fpm(), *func, funcName);
+            session.get_jit().get_run_stats().add_opt_decision(decision);
+        }
 
         return func;
     }
@@ -308,6 +714,42 @@ llvm::Function *MethodDefinition::codegen()
     return nullptr;
 }
 
+ASTType MethodDefinition::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    return infer_return_type(session, mArgTypes);
+}
+
+void MethodDefinition::collect_specialization_calls(HSession &session, std::vector<ASTType> const &argTypes,
+                                                    HSpecializationList &calls) const
+{
+    auto const arguments = mDeclaration->get_arguments();
+    if (arguments.size() != argTypes.size())
+        return;
+
+    std::map<std::string, ASTType> variables;
+    for (size_t i = 0; i < arguments.size(); i++)
+        variables[arguments[i]] = argTypes[i];
+
+    mFuncBody->collect_calls(session, variables, calls);
+}
+
+ASTType MethodDefinition::infer_return_type(HSession &session, std::vector<ASTType> const &argTypes) const
+{
+    auto const arguments = mDeclaration->get_arguments();
+    if (arguments.size() != argTypes.size())
+    {
+        std::cout << "Incorrect number of arguments for function: " << get_name() << ". Expected "
+                  << arguments.size() << " but got " << argTypes.size() << std::endl;
+        return ASTType::Variable;
+    }
+
+    std::map<std::string, ASTType> variables;
+    for (size_t i = 0; i < arguments.size(); i++)
+        variables[arguments[i]] = argTypes[i];
+
+    return mFuncBody->infer_type(session, variables);
+}
+
 void MethodDefinition::set_arg_types(std::vector<ASTType> argTypes) noexcept
 {
     mArgTypes = argTypes;
@@ -329,115 +771,34 @@ void MethodDefinition::set_return_type(ASTType type) noexcept
     return;
 }
 
-void MethodDefinition::gen_buffered_func()
+void MethodDefinition::set_source(std::string const &file, unsigned line, unsigned bodyLine)
 {
-    // Find function definition in global function buffer.
-    auto funcAst = HMethodBuffer::get().find(mFuncBody->get_name());
-    // If function definition exists, generate code.
-    if (funcAst != HMethodBuffer::get().end())
-    {
-        auto funcCall = dynamic_cast<MethodCall *>(mFuncBody.get());
-
-        // Set arguments. Loop is needed for call of calls.
-        auto args = funcCall->get_argtypes();
-        std::map<std::string, ASTType> argMap{};
-        size_t i = 0;
-        for (auto const &el : mArgTypes)
-        {
-            argMap.insert({mDeclaration->get_arguments()[i++], el});
-        }
-
-        std::vector<ASTType> inter;
-        i = 0;
-        for (auto &el : funcCall->getArgNames())
-        {
-            if (funcCall->get_argtypes()[i] == ASTType::MethodCall)
-            {
-                auto funcAst2 = HMethodBuffer::get().find(el);
-                if (funcAst2 != HMethodBuffer::get().end())
-                {
-                    funcAst2->second->set_arg_types({});
-                    std::vector<ASTType> tmp{};
-                    auto decl = HMethodDeclarations::get().find(produce_func_name(el, tmp));
-                    if (decl == HMethodDeclarations::get().end())
-                    {
-                        auto code = funcAst2->second->codegen();
-                        // mDeclaration->set_return_type(funcAst->second->get_return_type());
-                        // mReturnType = funcAst->second->get_return_type();
-                        if (HSettings::get_settings().get_verbose() > 1)
-                            code->print(llvm::outs());
-
-                        // Generate module for function, put code in and open new module.
-                        gen_module_and_reset();
-                    }
-                }
-                inter.push_back(ASTType::MethodCall);
-                i++;
-                continue;
-            }
-
-            auto type = argMap.find(el);
-            auto varType = funcCall->get_argtypes()[i];
-            if (varType != ASTType::Number && varType != ASTType::RealNumber && type == argMap.end())
-            {
-                if (varType != ASTType::Number && varType != ASTType::RealNumber && el != "Expression")
-                {
-                    std::cout << "Unknown varibale ->" << el << "<- used in call to " << funcCall->get_name()
-                              << std::endl;
-                }
-                if (el == "Expression")
-                    inter.push_back(funcCall->get_argtypes()[i]);
-
-                else
-                    inter.push_back(ASTType::Variable);
-            }
-            else
-            {
-                inter.push_back(type->second);
-            }
-            i++;
-        }
-
-        i = 0;
-        for (auto &arg : args)
-        {
-            if (arg == ASTType::Variable)
-            {
-                arg = inter[i];
-            }
-            i++;
-        }
-
-        funcAst->second->set_arg_types(args);
-        funcCall->set_arg_types(args);
-        // Only generate function if not already happened in previous call to it.
-        auto name = funcCall->get_name();
-        auto decl = HMethodDeclarations::get().find(produce_func_name(name, args));
-        if (decl == HMethodDeclarations::get().end())
-        {
-            auto code = funcAst->second->codegen();
-            mDeclaration->set_return_type(funcAst->second->get_return_type());
-            mReturnType = funcAst->second->get_return_type();
-            if (HSettings::get_settings().get_verbose() > 1)
-                code->print(llvm::outs());
-
-            // Generate module for function, put code in and open new module.
-            gen_module_and_reset();
-        }
-        else
-        {
-            mDeclaration->set_return_type(std::get<1>(decl->second));
-            mReturnType = std::get<1>(decl->second);
-        }
-    }
-    else
-    {
-        std::cout << "Referencing undefined function in call." << std::endl;
-    }
-
+    mSourceFile = file;
+    mLine = line;
+    mBodyLine = bodyLine;
     return;
 }
 
+llvm::DebugLoc MethodDefinition::gen_debug_info(HCompilationContext &ctx, llvm::Function *func,
+                                                std::string const &displayName)
+{
+    auto builder = ctx.get_di_builder();
+    if (builder == nullptr || mSourceFile.empty())
+        return {};
+
+    // Line tables are all profilers need, arguments and values have no debug types.
+    auto file = ctx.get_di_file(mSourceFile);
+    auto type = builder->createSubroutineType(builder->getOrCreateTypeArray({}));
+    auto flags = llvm::DISubprogram::SPFlagDefinition;
+    if (ctx.get_session().get_settings().get_opt_level() > 0)
+        flags |= llvm::DISubprogram::SPFlagOptimized;
+    auto subprogram = builder->createFunction(file, displayName, func->getName(), file, mLine, type, mBodyLine,
+                                              llvm::DINode::FlagPrototyped, flags);
+    func->setSubprogram(subprogram);
+
+    return llvm::DILocation::get(ctx.get_context(), mBodyLine, 0, subprogram);
+}
+
 /******************************* Method call *****************************/
 MethodCall::MethodCall(std::string const &name, std::vector<std::unique_ptr<Expression>> args)
     : Expression{ASTType::MethodCall}, mName{name}, mArguments(std::move(args)), mReturnType{ASTType::Number}
@@ -445,36 +806,100 @@ MethodCall::MethodCall(std::string const &name, std::vector<std::unique_ptr<Expr
 }
 
 // Codegen.
-llvm::Value *MethodCall::codegen()
+llvm::Value *MethodCall::codegen(HCompilationContext &ctx)
 {
-    // Lookup function name first.
-    mReturnType = std::get<1>(HMethodDeclarations::get().find(produce_func_name(mName, get_argtypes()))->second);
+    // The types of the generated arguments determine which specialization is called.
+    std::vector<llvm::Value *> args;
+    mArgTypes.clear();
+    for (auto const &el : mArguments)
+    {
+        auto arg = el->codegen(ctx);
+        if (arg == nullptr)
+            return nullptr;
 
-    llvm::Function *func = gen_func_decl(mName, get_argtypes(), mReturnType);
-    if (HSettings::get_settings().get_verbose() > 1)
-        std::cout << produce_func_name(mName, get_argtypes()) << std::endl;
-    if (func == nullptr)
+        args.push_back(arg);
+        mArgTypes.push_back(arg->getType()->isDoubleTy() ? ASTType::RealNumber : ASTType::Number);
+    }
+
+    // Lookup function name first.
+    auto &session = ctx.get_session();
+    mReturnType = infer_method_return_type(session, mName, mArgTypes);
+    if (session.get_settings().get_verbose() > 1)
+        std::cout << produce_func_name(mName, mArgTypes) << std::endl;
+    if (mReturnType != ASTType::Number && mReturnType != ASTType::RealNumber)
     {
         std::cout << "Unknown reference to function: " << mName << std::endl;
         return nullptr;
     }
 
-    if (func->arg_size() != mArguments.size())
+    // Methods with too many specializations already run their generic version.
+    if (!allow_specialization(session, mName, mArgTypes))
+    {
+        std::vector<llvm::Value *> boxedArgs;
+        for (auto arg : args)
+            boxedArgs.push_back(box(ctx, arg));
+
+        auto generic = gen_generic_decl(ctx, mName, boxedArgs.size());
+        request_generic(session, mName);
+        return unbox(ctx, ctx.get_builder().CreateCall(generic, boxedArgs, "genericcall"), mReturnType);
+    }
+
+    // Call sites passing constants often enough call a clone with the constants baked in.
+    HConstantArguments constants;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(args[i]))
+            constants.push_back({i, ASTType::Number, constant->getSExtValue(), 0.0});
+        else if (auto constant = llvm::dyn_cast<llvm::ConstantFP>(args[i]))
+            constants.push_back({i, ASTType::RealNumber, 0, constant->getValueAPF().convertToDouble()});
+    }
+    if (!constants.empty() && use_clone(ctx, mName, mArgTypes, constants, this))
+    {
+        std::vector<llvm::Value *> remaining;
+        std::vector<ASTType> remainingTypes;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (find_constant(constants, i) != nullptr)
+                continue;
+            remaining.push_back(args[i]);
+            remainingTypes.push_back(mArgTypes[i]);
+        }
+
+        auto clone = gen_func_proto(ctx, produce_clone_name(mName, mArgTypes, constants), remainingTypes, mReturnType);
+        request_clone(session, mName, mArgTypes, constants);
+        return ctx.get_builder().CreateCall(clone, remaining, "funccall");
+    }
+
+    // Only the declaration of the called function is needed here, its code is generated on first call.
+    llvm::Function *func = gen_func_decl(ctx, mName, mArgTypes, mReturnType);
+    request_specialization(session, mName, mArgTypes);
+
+    return ctx.get_builder().CreateCall(func, args, "funccall");
+}
+
+// The argument types are only known at runtime, always call the generic version.
+llvm::Value *MethodCall::codegen_boxed(HCompilationContext &ctx)
+{
+    auto &session = ctx.get_session();
+    auto funcAst = session.find_method(mName);
+    if (funcAst == nullptr || funcAst->get_decl()->get_arguments().size() != mArguments.size())
     {
-        std::cout << "Incorrect number of arguments for function: " << mName << ". Expected " << func->arg_size()
-                  << " but got " << mArguments.size() << std::endl;
+        std::cout << "Unknown reference to function: " << mName << std::endl;
         return nullptr;
     }
 
     std::vector<llvm::Value *> args;
     for (auto const &el : mArguments)
     {
-        args.push_back(el->codegen());
+        auto arg = el->codegen_boxed(ctx);
+        if (arg == nullptr)
+            return nullptr;
+        args.push_back(arg);
     }
 
-    // Since this method call is attached to non type version of the calling function reset its type back.
-    mArgTypes = {};
-    return HBuilderSingelton::get_builder().mBuilder->CreateCall(func, args, "funccall");
+    auto generic = gen_generic_decl(ctx, mName, args.size());
+    request_generic(session, mName);
+    return ctx.get_builder().CreateCall(generic, args, "genericcall");
 }
 
 std::string MethodCall::get_name() const noexcept
@@ -482,47 +907,50 @@ std::string MethodCall::get_name() const noexcept
     return mName;
 }
 
-// In order to produce code for the correct data types, we need to be able to query the types of the input arguments
-// of a function call.
-std::vector<ASTType> MethodCall::get_argtypes()
+std::string MethodCall::get_ast_string() const
 {
-    if (!mArgTypes.empty())
-        return mArgTypes;
+    std::string str{mName + "("};
+    for (auto const &el : mArguments)
+        str += el->get_ast_string() + ",";
+    return str + ")";
+}
 
-    std::vector<ASTType> ret;
+ASTType MethodCall::infer_type(HSession &session, std::map<std::string, ASTType> const &variables) const
+{
+    std::vector<ASTType> argTypes;
     for (auto const &el : mArguments)
     {
-        if (el->get_type() == ASTType::Binary)
-        {
-            // What happens if expression is of variables.
-            el->codegen();
-            ret.push_back(el->get_return_type());
-        }
-        else
-        {
-            ret.push_back(el->get_type());
-        }
+        auto type = el->infer_type(session, variables);
+        if (type != ASTType::Number && type != ASTType::RealNumber)
+            return ASTType::Variable;
+        argTypes.push_back(type);
     }
 
-    mArgTypes = ret;
-    return ret;
+    return infer_method_return_type(session, mName, argTypes);
 }
 
-void MethodCall::set_arg_types(std::vector<ASTType> &args)
+void MethodCall::collect_calls(HSession &session, std::map<std::string, ASTType> const &variables,
+                               HSpecializationList &calls) const
 {
-    mArgTypes = args;
-    return;
-}
+    std::vector<ASTType> argTypes;
+    for (auto const &el : mArguments)
+    {
+        el->collect_calls(session, variables, calls);
+        argTypes.push_back(el->infer_type(session, variables));
+    }
 
-std::vector<std::string> MethodCall::getArgNames()
-{
-    std::vector<std::string> names;
-    for (auto &el : mArguments)
+    for (auto const &el : argTypes)
     {
-        names.push_back(el->get_name());
+        if (el != ASTType::Number && el != ASTType::RealNumber)
+            return;
     }
 
-    return names;
+    calls.push_back({mName, argTypes});
+}
+
+std::vector<ASTType> MethodCall::get_argtypes()
+{
+    return mArgTypes;
 }
 
 ASTType MethodCall::get_return_type() const noexcept
@@ -546,5 +974,296 @@ std::string MethodCall::get_call() const
     return call;
 }
 
+/******************************************************************************
+ ****************************** Specializations *******************************
+ *****************************************************************************/
+llvm::Function *gen_func_decl(HCompilationContext &ctx, std::string const &name, std::vector<ASTType> const &argTypes,
+                              ASTType returnType)
+{
+    return gen_func_proto(ctx, produce_func_name(name, argTypes), argTypes, returnType);
+}
+
+llvm::Function *gen_func_proto(HCompilationContext &ctx, std::string const &funcName,
+                               std::vector<ASTType> const &argTypes, ASTType returnType)
+{
+    auto &module = ctx.get_module();
+    if (auto func = module.getFunction(funcName))
+        return func;
+
+    auto &context = ctx.get_context();
+    auto llvm_type = [&context](ASTType type) -> llvm::Type * {
+        return type == ASTType::RealNumber ? llvm::Type::getDoubleTy(context) : llvm::Type::getInt64Ty(context);
+    };
+
+    // Create types for input arguments.
+    std::vector<llvm::Type *> types;
+    for (auto const &el : argTypes)
+        types.push_back(llvm_type(el));
+
+    // Create function prototype.
+    llvm::FunctionType *proto = llvm::FunctionType::get(llvm_type(returnType), types, false);
+
+    return llvm::Function::Create(proto, llvm::Function::ExternalLinkage, funcName, module);
+}
+
+llvm::Function *gen_generic_decl(HCompilationContext &ctx, std::string const &name, std::size_t arguments)
+{
+    auto funcName = produce_generic_name(name);
+    auto &module = ctx.get_module();
+    if (auto func = module.getFunction(funcName))
+        return func;
+
+    auto boxedType = gen_boxed_type(ctx);
+    std::vector<llvm::Type *> types(arguments, boxedType);
+    llvm::FunctionType *proto = llvm::FunctionType::get(boxedType, types, false);
+
+    return llvm::Function::Create(proto, llvm::Function::ExternalLinkage, funcName, module);
+}
+
+bool allow_specialization(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes)
+{
+    auto const &settings = session.get_settings();
+    if (settings.get_max_specializations() == 0 || settings.get_emit_type() != HEmitType::JIT)
+        return true;
+
+    // Library methods are capped in their library, the specializations of all programs count.
+    auto &owner = session.get_method_owner(name);
+    auto &guard = owner.get_specialization_guard();
+    auto funcName = produce_func_name(name, argTypes);
+    std::lock_guard<std::mutex> lock(guard.mMutex);
+    auto &specializations = guard.mSpecializations[name];
+    if (specializations.find(funcName) != specializations.end())
+        return true;
+    if (specializations.size() < settings.get_max_specializations())
+    {
+        specializations.insert(funcName);
+        return true;
+    }
+
+    if (guard.mFallbacks[name].insert(funcName).second && settings.get_verbose() > 0)
+        std::cout << "Too many specializations of " << name << ", " << funcName << " runs the generic version."
+                  << std::endl;
+    return false;
+}
+
+std::string produce_clone_name(std::string const &name, std::vector<ASTType> const &argTypes,
+                               HConstantArguments const &constants)
+{
+    // Constants are written like in get_ast_string.
+    auto cloneName = produce_func_name(name, argTypes);
+    for (auto const &el : constants)
+    {
+        cloneName += "." + std::to_string(el.mIndex) + "=";
+        if (el.mType == ASTType::RealNumber)
+        {
+            std::uint64_t bits;
+            std::memcpy(&bits, &el.mReal, sizeof(bits));
+            cloneName += "r" + std::to_string(bits);
+        }
+        else
+        {
+            cloneName += "i" + std::to_string(el.mInt);
+        }
+    }
+    return cloneName;
+}
+
+ASTType infer_method_return_type(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes)
+{
+    // Library methods are inferred in their library, the result is shared by all programs.
+    auto &owner = session.get_method_owner(name);
+    if (&owner != &session)
+        return infer_method_return_type(owner, name, argTypes);
+
+    // Already known.
+    auto funcName = produce_func_name(name, argTypes);
+    auto &declarations = session.get_declarations();
+    {
+        std::lock_guard<std::mutex> lock(declarations.mMutex);
+        auto decl = declarations.mFunctions.find(funcName);
+        if (decl != declarations.mFunctions.end())
+            return std::get<1>(decl->second);
+    }
+
+    auto funcAst = session.find_method(name);
+    if (funcAst == nullptr)
+    {
+        std::cout << "Referencing undefined function in call." << std::endl;
+        return ASTType::Variable;
+    }
+
+    HPhaseScope scope(session.get_jit().get_time_report(), HPhase::TypeInfer, "Infer type", funcName);
+
+    // Methods have no branches, a method calling itself never returns.
+    static thread_local std::set<std::string> inProgress;
+    if (!inProgress.insert(funcName).second)
+    {
+        std::cout << "Recursive call of function: " << name << std::endl;
+        return ASTType::Variable;
+    }
+    auto type = funcAst->infer_return_type(session, argTypes);
+    inProgress.erase(funcName);
+
+    if (type == ASTType::Number || type == ASTType::RealNumber)
+    {
+        std::lock_guard<std::mutex> lock(declarations.mMutex);
+        declarations.mFunctions.insert({funcName, {funcAst->get_decl(), type}});
+    }
+
+    return type;
+}
+
+void request_specialization(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes)
+{
+    auto funcName = produce_func_name(name, argTypes);
+
+    if (session.get_settings().get_emit_type() != HEmitType::JIT)
+    {
+        auto &pending = session.get_pending_specializations();
+        if (pending.mRequested.insert(funcName).second)
+            pending.mQueue.push_back({name, argTypes});
+        return;
+    }
+
+    // Register lazy stub, the code is generated when the stub is called the first time.
+    // The library generates the specialization into the module of its batch, possibly on a compile thread.
+    // Library methods are registered in their library, so their code is shared by all programs.
+    static llvm::ExitOnError err;
+    auto &owner = session.get_method_owner(name);
+    auto generator = [&owner, name, argTypes](HCompilationContext &ctx) -> llvm::Error {
+        auto funcAst = owner.find_method(name);
+        if (funcAst == nullptr)
+            return llvm::createStringError(llvm::inconvertibleErrorCode(), "Undefined function " + name);
+
+        auto code = funcAst->codegen_specialization(ctx, argTypes);
+        if (code == nullptr)
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "Unable to generate code for " + produce_func_name(name, argTypes));
+        if (owner.get_settings().get_verbose() > 1)
+            code->print(llvm::outs());
+        ctx.reset_builder();
+
+        return llvm::Error::success();
+    };
+    err(owner.get_library().add_lazy_method(funcName, std::move(generator)));
+
+    return;
+}
+
+void request_generic(HSession &session, std::string const &name)
+{
+    static llvm::ExitOnError err;
+    auto &owner = session.get_method_owner(name);
+    auto generator = [&owner, name](HCompilationContext &ctx) -> llvm::Error {
+        auto funcAst = owner.find_method(name);
+        if (funcAst == nullptr)
+            return llvm::createStringError(llvm::inconvertibleErrorCode(), "Undefined function " + name);
+
+        auto code = funcAst->codegen_generic(ctx);
+        if (code == nullptr)
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "Unable to generate code for " + produce_generic_name(name));
+        if (owner.get_settings().get_verbose() > 1)
+            code->print(llvm::outs());
+        ctx.reset_builder();
+
+        return llvm::Error::success();
+    };
+    err(owner.get_library().add_lazy_method(produce_generic_name(name), std::move(generator)));
+
+    return;
+}
+
+void request_clone(HSession &session, std::string const &name, std::vector<ASTType> const &argTypes,
+                   HConstantArguments const &constants)
+{
+    // Registered like a specialization, the clone is generated when its stub is called the first time.
+    static llvm::ExitOnError err;
+    auto &owner = session.get_method_owner(name);
+    auto generator = [&owner, name, argTypes, constants](HCompilationContext &ctx) -> llvm::Error {
+        auto funcAst = owner.find_method(name);
+        if (funcAst == nullptr)
+            return llvm::createStringError(llvm::inconvertibleErrorCode(), "Undefined function " + name);
+
+        auto code = funcAst->codegen_clone(ctx, argTypes, constants);
+        if (code == nullptr)
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "Unable to generate code for " +
+                                               produce_clone_name(name, argTypes, constants));
+        if (owner.get_settings().get_verbose() > 1)
+            code->print(llvm::outs());
+        ctx.reset_builder();
+
+        return llvm::Error::success();
+    };
+    err(owner.get_library().add_lazy_method(produce_clone_name(name, argTypes, constants), std::move(generator)));
+
+    return;
+}
+
+void gen_pending_specializations(HCompilationContext &ctx)
+{
+    auto &session = ctx.get_session();
+    auto &queue = session.get_pending_specializations().mQueue;
+    while (!queue.empty())
+    {
+        auto [name, argTypes] = queue.back();
+        queue.pop_back();
+
+        auto funcAst = session.find_method(name);
+        if (funcAst == nullptr)
+        {
+            std::cout << "Referencing undefined function in call." << std::endl;
+            continue;
+        }
+
+        auto code = funcAst->codegen_specialization(ctx, argTypes);
+        if (code != nullptr && session.get_settings().get_verbose() > 1)
+            code->print(llvm::outs());
+
+        gen_module_and_reset(ctx);
+    }
+
+    return;
+}
+
+llvm::Expected<llvm::orc::ThreadSafeModule> gen_module(HSession &session,
+                                                       llvm::function_ref<llvm::Error(HCompilationContext &)> body)
+{
+    HCompilationContext ctx(session);
+    if (auto error = body(ctx))
+        return std::move(error);
+
+    return ctx.take_module();
+}
+
+llvm::Expected<llvm::orc::ExecutorAddr> compile_specialization(HSession &session, std::string const &name,
+                                                               std::vector<ASTType> const &argTypes)
+{
+    auto &owner = session.get_method_owner(name);
+    auto &library = owner.get_library();
+    auto funcName = produce_func_name(name, argTypes);
+    try
+    {
+        // Failures are thrown, the registry forgets the key and the next request tries again.
+        return library.get_specializations().get_or_create(funcName, [&]() {
+            auto returnType = infer_method_return_type(owner, name, argTypes);
+            if (returnType != ASTType::Number && returnType != ASTType::RealNumber)
+                throw CompileError{"Unable to infer the return type of " + funcName};
+
+            request_specialization(owner, name, argTypes);
+            auto address = library.lookup_method(funcName);
+            if (!address)
+                throw CompileError{"Unable to compile " + funcName + ": " + llvm::toString(address.takeError())};
+
+            return *address;
+        });
+    }
+    catch (CompileError const &error)
+    {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), error.what());
+    }
+}
+
 } // namespace ast
 } // namespace hannac
\ No newline at end of file
@@ -0,0 +1,88 @@
+// stdlib includes
+#include <cstddef>
+#include <new>
+
+// hanna includes.
+#include "Allocations.hpp"
+
+// Replacements of the global allocation functions feeding HAllocationTracker. Only compiled into builds configured
+// with HANNAC_TRACK_ALLOCATIONS. The over-aligned variants aren't replaced, they allocate and free on their own.
+namespace
+{
+void *allocate(std::size_t size, void const *site)
+{
+    while (true)
+    {
+        if (auto ptr = hannac::HAllocationTracker::allocate(size, site))
+            return ptr;
+
+        auto handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *allocate(std::size_t size, void const *site, std::nothrow_t const &) noexcept
+{
+    try
+    {
+        return allocate(size, site);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+} // namespace
+
+// The return address is the code calling operator new, it is the allocation site.
+void *operator new(std::size_t size)
+{
+    return allocate(size, __builtin_return_address(0));
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size, __builtin_return_address(0));
+}
+
+void *operator new(std::size_t size, std::nothrow_t const &tag) noexcept
+{
+    return allocate(size, __builtin_return_address(0), tag);
+}
+
+void *operator new[](std::size_t size, std::nothrow_t const &tag) noexcept
+{
+    return allocate(size, __builtin_return_address(0), tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    hannac::HAllocationTracker::deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    hannac::HAllocationTracker::deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    hannac::HAllocationTracker::deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    hannac::HAllocationTracker::deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::nothrow_t const &) noexcept
+{
+    hannac::HAllocationTracker::deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept
+{
+    hannac::HAllocationTracker::deallocate(ptr);
+}
@@ -0,0 +1,59 @@
+#include "Allocations.hpp"
+#include "Trace.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST(HPhaseScope, CurrentPhase)
+{
+    // Phases are tracked without a time report as well.
+    hannac::HTimeReport report;
+    EXPECT_EQ(hannac::HPhaseScope::get_current_phase(), hannac::HPhase::Count);
+    {
+        hannac::HPhaseScope parse(report, hannac::HPhase::Parse);
+        EXPECT_EQ(hannac::HPhaseScope::get_current_phase(), hannac::HPhase::Parse);
+        {
+            hannac::HPhaseScope optimize(report, hannac::HPhase::Opt);
+            EXPECT_EQ(hannac::HPhaseScope::get_current_phase(), hannac::HPhase::Opt);
+        }
+        EXPECT_EQ(hannac::HPhaseScope::get_current_phase(), hannac::HPhase::Parse);
+    }
+    EXPECT_EQ(hannac::HPhaseScope::get_current_phase(), hannac::HPhase::Count);
+}
+
+TEST(HAllocationTracker, Phases)
+{
+    if (!hannac::HAllocationTracker::enabled())
+        GTEST_SKIP() << "configure with -DHANNAC_TRACK_ALLOCATIONS=ON";
+
+    hannac::HTimeReport report;
+    auto before = hannac::HAllocationTracker::get_stats(hannac::HPhase::Parse);
+    std::vector<std::unique_ptr<std::uint64_t[]>> blocks;
+    {
+        hannac::HPhaseScope parse(report, hannac::HPhase::Parse);
+        blocks.reserve(10);
+        for (int i = 0; i < 10; i++)
+            blocks.emplace_back(new std::uint64_t[128]);
+    }
+    auto allocated = hannac::HAllocationTracker::get_stats(hannac::HPhase::Parse);
+    EXPECT_EQ(allocated.mAllocations - before.mAllocations, 11);
+    EXPECT_GE(allocated.mBytes - before.mBytes, 10 * 128 * sizeof(std::uint64_t));
+    EXPECT_GE(allocated.mPeakLiveBytes, 10 * 128 * sizeof(std::uint64_t));
+
+    // Freed outside of the phase, still accounted to it.
+    blocks.clear();
+    blocks.shrink_to_fit();
+    auto freed = hannac::HAllocationTracker::get_stats(hannac::HPhase::Parse);
+    EXPECT_EQ(freed.mFrees - before.mFrees, 11);
+    EXPECT_EQ(freed.mLiveBytes, before.mLiveBytes);
+    EXPECT_FALSE(hannac::HAllocationTracker::get_top_sites(hannac::HPhase::Parse, 5).empty());
+
+    std::ostringstream out;
+    hannac::HAllocationTracker::print(out);
+    EXPECT_NE(std::string::npos, out.str().find("Parse"));
+}
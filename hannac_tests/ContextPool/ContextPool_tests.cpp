@@ -0,0 +1,82 @@
+#include "Codegen.hpp"
+#include "ContextPool.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <filesystem>
+#include <string>
+#include <utility>
+
+TEST(HContextPool, ReuseReleasedContext)
+{
+    hannac::HContextPool pool;
+    auto first = pool.acquire();
+    auto context = first->mContext.getContext();
+    pool.release(std::move(first));
+
+    auto second = pool.acquire();
+    EXPECT_EQ(context, second->mContext.getContext());
+    EXPECT_EQ(2, second->mModules);
+
+    // Contexts in use are never handed out twice.
+    auto third = pool.acquire();
+    EXPECT_NE(second->mContext.getContext(), third->mContext.getContext());
+
+    auto stats = pool.get_stats();
+    EXPECT_EQ(2, stats.mCreated);
+    EXPECT_EQ(1, stats.mReused);
+    EXPECT_EQ(0, stats.mRetired);
+}
+
+TEST(HContextPool, RetireContext)
+{
+    hannac::HContextPool pool{2};
+    auto first = pool.acquire();
+    auto context = first->mContext.getContext();
+    pool.release(std::move(first));
+    auto second = pool.acquire();
+    pool.release(std::move(second));
+
+    // Second module of the context reached the limit.
+    auto third = pool.acquire();
+    EXPECT_NE(context, third->mContext.getContext());
+    EXPECT_EQ(1, pool.get_stats().mRetired);
+}
+
+TEST(HContextPool, TakeModule)
+{
+    hannac::HSession session;
+    hannac::HCompilationContext ctx{session};
+    auto &context = ctx.get_context();
+    auto first = ctx.take_module();
+    EXPECT_EQ(&context, first.getContext().getContext());
+
+    // The next module is generated into the same context.
+    EXPECT_EQ(&context, &ctx.get_context());
+    EXPECT_EQ(1, session.get_context_pool().get_stats().mCreated);
+}
+
+TEST(HContextPool, ExecuteProgram)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().parent_path().string() +
+                                                    "/Executor/data/callChain.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_EQ(-7, results[0].get_result().i);
+    EXPECT_EQ(-1.0, results[1].get_result().r);
+    EXPECT_EQ(12, results[2].get_result().i);
+
+    // Statements and specializations are generated one after another, one context serves all of them.
+    auto stats = session.get_context_pool().get_stats();
+    EXPECT_EQ(1, stats.mCreated);
+    EXPECT_GT(stats.mReused, 0);
+}
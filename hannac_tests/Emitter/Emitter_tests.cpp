@@ -0,0 +1,113 @@
+#include "Emitter.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// llvm includes
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Program.h"
+
+// stdlib includes
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::vector<std::unique_ptr<hannac::ast::Expression>> parse(hannac::HSession &session)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "emit.hanna"}}};
+    return parser.parse();
+}
+
+std::filesystem::path make_output(std::string const &name)
+{
+    auto output = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(output);
+    return output;
+}
+} // namespace
+
+TEST(HEmitter, Object)
+{
+    auto output = make_output("hannac_emit.o");
+    hannac::HSession session;
+    hannac::HEmitter emitter{session, parse(session)};
+    emitter(output, hannac::HEmitType::OBJ);
+    ASSERT_TRUE(std::filesystem::exists(output));
+
+    auto object = llvm::object::ObjectFile::createObjectFile(output.string());
+    ASSERT_TRUE(static_cast<bool>(object)) << llvm::toString(object.takeError());
+
+    std::set<std::string> defined;
+    for (auto const &symbol : object->getBinary()->symbols())
+    {
+        if (!(llvm::cantFail(symbol.getFlags()) & llvm::object::SymbolRef::SF_Undefined))
+            defined.insert(llvm::cantFail(symbol.getName()).str());
+    }
+
+    auto const Int = hannac::ast::ASTType::Number;
+    auto const Real = hannac::ast::ASTType::RealNumber;
+    for (auto const &name :
+         {std::string("main"), std::string("__hanna_statement_0"), std::string("__hanna_statement_1"),
+          std::string("__hanna_statement_2"), hannac::ast::produce_func_name("chainA", {Int, Int}),
+          hannac::ast::produce_func_name("chainB", {Int, Int}), hannac::ast::produce_func_name("chainC", {Int, Int}),
+          hannac::ast::produce_func_name("chainA", {Real, Real}), hannac::ast::produce_func_name("half", {Real})})
+        EXPECT_EQ(1, defined.count(name)) << name;
+
+    // Only called methods are compiled.
+    EXPECT_EQ(0, defined.count(hannac::ast::produce_func_name("half", {Int})));
+
+    std::filesystem::remove(output);
+}
+
+TEST(HEmitter, Executable)
+{
+    if (!llvm::sys::findProgramByName("cc"))
+        GTEST_SKIP() << "No system compiler driver (cc) to link with.";
+
+    auto output = make_output("hannac_emit");
+    {
+        hannac::HSession session;
+        hannac::HEmitter emitter{session, parse(session)};
+        emitter(output, hannac::HEmitType::EXE);
+    }
+    ASSERT_TRUE(std::filesystem::exists(output));
+
+    // The executable prints its results the same way print_result does.
+    auto stdoutPath = make_output("hannac_emit.out");
+    std::optional<llvm::StringRef> redirects[] = {std::nullopt, llvm::StringRef(stdoutPath.string()), std::nullopt};
+    std::string program = output.string();
+    std::vector<llvm::StringRef> args{program};
+    std::string error;
+    ASSERT_EQ(0, llvm::sys::ExecuteAndWait(program, args, std::nullopt, redirects, 0, 0, &error)) << error;
+
+    std::stringstream printed;
+    printed << std::ifstream(stdoutPath).rdbuf();
+
+    hannac::HSession session;
+    hannac::HExecutor ex{session, parse(session)};
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_EQ(37, results[0].get_result().i);
+
+    std::ostringstream expected;
+    for (auto const &result : results)
+    {
+        if (result.get_type() == hannac::HResultType::INT)
+            expected << "\tResult: " << result.get_result().i << "\n";
+        else
+            expected << "\tResult: " << result.get_result().r << "\n";
+    }
+    EXPECT_EQ(expected.str(), printed.str());
+
+    std::filesystem::remove(output);
+    std::filesystem::remove(stdoutPath);
+}
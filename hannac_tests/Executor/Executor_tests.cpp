@@ -11,10 +11,11 @@
 TEST(HExecutor, RealMethod)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "real.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "real.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 2);
 
@@ -25,13 +26,30 @@ TEST(HExecutor, RealMethod)
     EXPECT_EQ(1.15, results[1].get_result().r);
 }
 
+TEST(HExecutor, FastMath)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_fast_math(true);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "real.hanna"}}};
+
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_DOUBLE_EQ(1.5, results[0].get_result().r);
+    EXPECT_DOUBLE_EQ(1.15, results[1].get_result().r);
+}
+
 TEST(HExecutor, IntMethod)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "int.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "int.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 2);
 
@@ -45,10 +63,11 @@ TEST(HExecutor, IntMethod)
 TEST(HExecutor, Both)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "both.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "both.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 2);
 
@@ -62,10 +81,11 @@ TEST(HExecutor, Both)
 TEST(HExecutor, FunctionCall)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "functionCall.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "functionCall.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 5);
 
@@ -90,10 +110,11 @@ TEST(HExecutor, FunctionCall)
 TEST(HExecutor, ParameterOrder)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "parameterOrder.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "parameterOrder.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 4);
 
@@ -115,10 +136,11 @@ TEST(HExecutor, ParameterOrder)
 TEST(HExecutor, ExprAsParameter)
 {
     std::filesystem::path path(__FILE__);
-    hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "expressionAsParameter.hanna"}}};
+    hannac::HSession session;
+    hannac::HTokenParser parser{session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" +
+                                                                            "expressionAsParameter.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 5);
 
@@ -141,10 +163,11 @@ TEST(HExecutor, ExprAsParameter)
 TEST(HExecutor, MethodAsParam)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "methodAsParam.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "methodAsParam.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 2);
 
@@ -159,10 +182,11 @@ TEST(HExecutor, Negative)
 {
     // hannac::HSettings::get_settings().set_verbose(2);
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "negative.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "negative.hanna"}}};
 
-    hannac::HExecutor ex{parser.parse()};
+    hannac::HExecutor ex{session, parser.parse()};
     auto results{ex()};
     EXPECT_EQ(results.size(), 28);
 
@@ -277,4 +301,58 @@ TEST(HExecutor, Negative)
     // 7.1 - -7.2
     EXPECT_EQ(hannac::HResultType::REAL, results[27].get_type());
     EXPECT_FLOAT_EQ(14.3, results[27].get_result().r);
-}
\ No newline at end of file
+}
+
+TEST(HExecutor, CallChain)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "callChain.hanna"}}};
+
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+    EXPECT_EQ(results.size(), 3);
+
+    // 3-10
+    EXPECT_EQ(hannac::HResultType::INT, results[0].get_type());
+    EXPECT_EQ(-7, results[0].get_result().i);
+
+    // 0.5-1.5
+    EXPECT_EQ(hannac::HResultType::REAL, results[1].get_type());
+    EXPECT_EQ(-1.0, results[1].get_result().r);
+
+    // 4*(4-1)
+    EXPECT_EQ(hannac::HResultType::INT, results[2].get_type());
+    EXPECT_EQ(12, results[2].get_result().i);
+}
+
+TEST(HExecutor, ParallelCompile)
+{
+    auto run = [](unsigned jobs) {
+        std::filesystem::path path(__FILE__);
+        hannac::HSettings settings;
+        settings.set_jobs(jobs);
+        hannac::HSession session{settings};
+        hannac::HTokenParser parser{
+            session,
+            hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "parallelCompile.hanna"}}};
+        hannac::HExecutor ex{session, parser.parse()};
+        return ex();
+    };
+
+    // Compiling the call chains upfront on several threads doesn't change any result.
+    auto serial{run(1)};
+    auto parallel{run(4)};
+    ASSERT_EQ(serial.size(), 5);
+    ASSERT_EQ(serial.size(), parallel.size());
+    EXPECT_EQ(-50, serial[0].get_result().i);
+    for (std::size_t i = 0; i < serial.size(); i++)
+    {
+        ASSERT_EQ(serial[i].get_type(), parallel[i].get_type());
+        if (serial[i].get_type() == hannac::HResultType::INT)
+            EXPECT_EQ(serial[i].get_result().i, parallel[i].get_result().i);
+        else
+            EXPECT_EQ(serial[i].get_result().r, parallel[i].get_result().r);
+    }
+}
@@ -0,0 +1,52 @@
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Generator.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+TEST(HProgramGenerator, Seeded)
+{
+    hannac::HGeneratorOptions options;
+    options.mSeed = 42;
+    auto first = hannac::HProgramGenerator{options}.generate();
+    EXPECT_EQ(first, hannac::HProgramGenerator{options}.generate());
+
+    options.mSeed = 43;
+    EXPECT_NE(first, hannac::HProgramGenerator{options}.generate());
+}
+
+TEST(HProgramGenerator, Runs)
+{
+    hannac::HGeneratorOptions options;
+    options.mMethods = 40;
+    options.mMaxParameters = 4;
+    options.mExpressionWidth = 5;
+    options.mExpressionDepth = 3;
+    options.mCallChainDepth = 8;
+    options.mRealRatio = 0.5;
+    options.mCommentRatio = 0.5;
+    options.mStatements = 30;
+
+    auto path = std::filesystem::temp_directory_path() / "hannac_generator_test.hanna";
+    {
+        std::ofstream file(path);
+        hannac::HProgramGenerator{options}.generate(file);
+    }
+
+    hannac::HSession session;
+    hannac::HTokenParser parser{session, hannac::HLexer{hannac::HFileParser{path}}};
+    auto program = parser.parse();
+    EXPECT_EQ(session.get_methods().size(), 40);
+    ASSERT_EQ(program.size(), 30);
+
+    hannac::HExecutor ex{session, std::move(program)};
+    EXPECT_EQ(ex().size(), 30);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,409 @@
+#include "AST.hpp"
+#include "Codegen.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "JIT.hpp"
+#include "PerfMap.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::vector<hannac::HResult> run(hannac::HSession &session, std::string const &file)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HTokenParser parser{session,
+                                hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + file}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    return ex();
+}
+
+void check_results(std::vector<hannac::HResult> const &results)
+{
+    ASSERT_EQ(results.size(), 5);
+    EXPECT_EQ(9, results[0].get_result().i);
+    EXPECT_EQ(8, results[1].get_result().i);
+    EXPECT_EQ(16, results[2].get_result().i);
+    EXPECT_EQ(27.0, results[3].get_result().r);
+    EXPECT_EQ(25, results[4].get_result().i);
+}
+} // namespace
+
+TEST(HJIT, UnlimitedCodeBudget)
+{
+    hannac::HSession session;
+    auto results{run(session, "codeBudget.hanna")};
+    check_results(results);
+
+    // square and cube for integers and reals, each compiled once and in its own module.
+    EXPECT_EQ(4, session.get_library().get_compiled_methods());
+    EXPECT_EQ(4, session.get_library().get_compiled_modules());
+    EXPECT_EQ(0, session.get_library().get_evicted_methods());
+}
+
+TEST(HJIT, EvictColdMethods)
+{
+    // Nothing fits, every statement starts without resident method bodies.
+    hannac::HSettings settings;
+    settings.set_code_budget(1);
+    hannac::HSession session{settings};
+    auto results{run(session, "codeBudget.hanna")};
+    check_results(results);
+
+    // Evicted methods are compiled again transparently when called.
+    EXPECT_EQ(7, session.get_library().get_compiled_methods());
+    EXPECT_EQ(7, session.get_library().get_evicted_methods());
+    EXPECT_EQ(0, session.get_library().get_resident_size());
+}
+
+TEST(HJIT, CachedObjectsAndCodeBudget)
+{
+    // Modules counting calls differ from the ones cached without a budget, they are optimized and cached on their own.
+    auto dir = std::filesystem::temp_directory_path() / "hannac_jit_budget_cache";
+    std::filesystem::remove_all(dir);
+    hannac::HSettings settings;
+    settings.set_cache_dir(dir.string());
+    {
+        hannac::HSession session{settings};
+        check_results(run(session, "codeBudget.hanna"));
+        EXPECT_GT(session.get_jit().get_cache().get_stores(), 0);
+    }
+
+    settings.set_code_budget(1);
+    hannac::HSession session{settings};
+    check_results(run(session, "codeBudget.hanna"));
+    auto decisions = session.get_jit().get_run_stats().get_opt_decisions();
+    for (auto const type : {hannac::ast::ASTType::Number, hannac::ast::ASTType::RealNumber})
+        for (auto const &method : {"square", "cube"})
+            EXPECT_EQ(1, decisions.count(hannac::ast::produce_func_name(method, {type}))) << method;
+    std::filesystem::remove_all(dir);
+}
+
+TEST(HJIT, BatchCallees)
+{
+    hannac::HSettings settings;
+    settings.set_batch_size(8);
+    hannac::HSession session{settings};
+    auto results{run(session, "codeBudget.hanna")};
+    check_results(results);
+
+    // The real square is registered while generating the real cube and joins its module.
+    EXPECT_EQ(4, session.get_library().get_compiled_methods());
+    EXPECT_EQ(3, session.get_library().get_compiled_modules());
+}
+
+TEST(HJIT, BatchCompileRound)
+{
+    // Everything reachable is registered upfront and compiled in one round.
+    hannac::HSettings settings;
+    settings.set_batch_size(8);
+    settings.set_jobs(4);
+    hannac::HSession session{settings};
+    auto results{run(session, "codeBudget.hanna")};
+    check_results(results);
+
+    EXPECT_EQ(4, session.get_library().get_compiled_methods());
+    EXPECT_EQ(1, session.get_library().get_compiled_modules());
+}
+
+TEST(HJIT, BatchEviction)
+{
+    // Batches are evicted as a whole and generated again on their next call.
+    hannac::HSettings settings;
+    settings.set_batch_size(8);
+    settings.set_code_budget(1);
+    hannac::HSession session{settings};
+    auto results{run(session, "codeBudget.hanna")};
+    check_results(results);
+
+    EXPECT_EQ(0, session.get_library().get_resident_size());
+    EXPECT_EQ(session.get_library().get_compiled_methods(), session.get_library().get_evicted_methods());
+}
+
+TEST(HJIT, TierUpHotMethods)
+{
+    hannac::HSettings settings;
+    settings.set_tier_up_threshold(10);
+    hannac::HSession session{settings};
+    auto results{run(session, "tierUp.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(32, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+
+    // inc is called 32 times and sum4 8 times, only inc is hot.
+    EXPECT_FALSE(static_cast<bool>(session.get_library().tier_up()));
+    EXPECT_EQ(1, session.get_library().get_tiered_up_methods());
+
+    // Calls now run the optimized body and keep counting, sum4 becomes hot as well.
+    auto hotResults{run(session, "tierUpAgain.hanna")};
+    ASSERT_EQ(hotResults.size(), 2);
+    EXPECT_EQ(32, hotResults[0].get_result().i);
+    EXPECT_EQ(48, hotResults[1].get_result().i);
+    EXPECT_FALSE(static_cast<bool>(session.get_library().tier_up()));
+    EXPECT_EQ(2, session.get_library().get_tiered_up_methods());
+}
+
+TEST(HJIT, TierUpWithCodeBudget)
+{
+    // The tier-up thread races with eviction after every statement, neither may pull the code of the other away.
+    hannac::HSettings settings;
+    settings.set_tier_up_threshold(2);
+    settings.set_code_budget(1);
+    hannac::HSession session{settings};
+    auto results{run(session, "tierUp.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(32, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+
+    for (int i = 0; i < 20; i++)
+    {
+        auto hotResults{run(session, "tierUpAgain.hanna")};
+        ASSERT_EQ(hotResults.size(), 2);
+        EXPECT_EQ(32, hotResults[0].get_result().i);
+        EXPECT_EQ(48, hotResults[1].get_result().i);
+        EXPECT_FALSE(static_cast<bool>(session.get_library().tier_up()));
+    }
+    EXPECT_GT(session.get_library().get_evicted_methods(), 0);
+}
+
+TEST(HJIT, TierUpDisabled)
+{
+    hannac::HSession session;
+    auto results{run(session, "tierUp.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_FALSE(static_cast<bool>(session.get_library().tier_up()));
+    EXPECT_EQ(0, session.get_library().get_tiered_up_methods());
+}
+
+TEST(HJIT, CloneConstantArguments)
+{
+    hannac::HSettings settings;
+    settings.set_clone_threshold(4);
+    hannac::HSession session{settings};
+    auto results{run(session, "clone.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(24, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+
+    // scale4 is predicted to be called 4 times, all of its call sites call the clone with f baked in.
+    auto &clones = session.get_value_profile().mClones;
+    ASSERT_EQ(1, clones.size());
+    EXPECT_EQ(hannac::ast::produce_clone_name("scale",
+                                              {hannac::ast::ASTType::Number, hannac::ast::ASTType::Number},
+                                              {{1, hannac::ast::ASTType::Number, 3, 0.0}}),
+              *clones.begin());
+    EXPECT_EQ(3, session.get_library().get_compiled_methods());
+}
+
+TEST(HJIT, CloneCallSitesCountOnce)
+{
+    // The four call sites in scale4 count 4 calls each. Generating scale4 again after eviction adds nothing.
+    hannac::HSettings settings;
+    settings.set_clone_threshold(17);
+    settings.set_code_budget(1);
+    hannac::HSession session{settings};
+    auto results{run(session, "clone.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(24, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+
+    EXPECT_GT(session.get_library().get_evicted_methods(), 0);
+    EXPECT_TRUE(session.get_value_profile().mClones.empty());
+    auto &calls = session.get_value_profile().mCalls;
+    ASSERT_EQ(1, calls.size());
+    EXPECT_EQ(16, calls.begin()->second);
+}
+
+TEST(HJIT, CloneCap)
+{
+    hannac::HSettings settings;
+    settings.set_clone_threshold(4);
+    settings.set_max_clones(0);
+    hannac::HSession session{settings};
+    auto results{run(session, "clone.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(24, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+    EXPECT_TRUE(session.get_value_profile().mClones.empty());
+    EXPECT_EQ(4, session.get_library().get_compiled_methods());
+}
+
+TEST(HJIT, NoClonesByDefault)
+{
+    hannac::HSession session;
+    auto results{run(session, "clone.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(24, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+    EXPECT_TRUE(session.get_value_profile().mClones.empty());
+}
+
+TEST(HJIT, MergeIdenticalMethods)
+{
+    hannac::HSettings settings;
+    settings.set_batch_size(8);
+    hannac::HSession session{settings};
+    auto results{run(session, "identicalCode.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(5, results[0].get_result().i);
+    EXPECT_EQ(7, results[1].get_result().i);
+
+    // add and plus are generated into the module of both, plus becomes an alias of add.
+    EXPECT_EQ(3, session.get_library().get_compiled_methods());
+    EXPECT_EQ(1, session.get_library().get_compiled_modules());
+    EXPECT_EQ(1, session.get_library().get_merged_methods());
+}
+
+TEST(HJIT, MergeIdenticalMethodsTierUp)
+{
+    hannac::HSettings settings;
+    settings.set_batch_size(8);
+    settings.set_tier_up_threshold(3);
+    hannac::HSession session{settings};
+    auto results{run(session, "identicalCode.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(5, results[0].get_result().i);
+    EXPECT_EQ(7, results[1].get_result().i);
+    EXPECT_EQ(1, session.get_library().get_merged_methods());
+
+    // plus counts its calls in the counter of add, both are called 4 times together and become hot. both is called
+    // twice only.
+    EXPECT_FALSE(static_cast<bool>(session.get_library().tier_up()));
+    EXPECT_EQ(2, session.get_library().get_tiered_up_methods());
+
+    // The optimized bodies of add and plus keep counting in the shared counter.
+    auto hotResults{run(session, "identicalCodeAgain.hanna")};
+    ASSERT_EQ(hotResults.size(), 2);
+    EXPECT_EQ(5, hotResults[0].get_result().i);
+    EXPECT_EQ(7, hotResults[1].get_result().i);
+}
+
+TEST(HJIT, MergeIdenticalMethodsEviction)
+{
+    hannac::HSettings settings;
+    settings.set_batch_size(8);
+    settings.set_code_budget(1);
+    hannac::HSession session{settings};
+    auto results{run(session, "identicalCode.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(5, results[0].get_result().i);
+    EXPECT_EQ(7, results[1].get_result().i);
+    EXPECT_GE(session.get_library().get_merged_methods(), 1);
+    EXPECT_EQ(0, session.get_library().get_resident_size());
+}
+
+TEST(HJIT, NoMergeWithoutBatches)
+{
+    hannac::HSession session;
+    auto results{run(session, "identicalCode.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(5, results[0].get_result().i);
+    EXPECT_EQ(7, results[1].get_result().i);
+    EXPECT_EQ(0, session.get_library().get_merged_methods());
+}
+
+TEST(HJIT, GenericFallback)
+{
+    hannac::HSettings settings;
+    settings.set_max_specializations(1);
+    hannac::HSession session{settings};
+    auto results{run(session, "specializationCap.hanna")};
+    ASSERT_EQ(results.size(), 4);
+    EXPECT_EQ(3, results[0].get_result().i);
+    EXPECT_EQ(4.0, results[1].get_result().r);
+    EXPECT_EQ(6.0, results[2].get_result().r);
+    EXPECT_EQ(3, results[3].get_result().i);
+
+    // add for doubles runs the generic version, called by the second statement and by mix.
+    auto &guard = session.get_specialization_guard();
+    ASSERT_EQ(1, guard.mFallbacks["add"].size());
+    EXPECT_EQ(2, guard.mCalls["add"]->load());
+    EXPECT_TRUE(guard.mFallbacks["mix"].empty());
+    EXPECT_EQ(3, session.get_library().get_compiled_methods());
+}
+
+TEST(HJIT, NoGenericFallbackBelowCap)
+{
+    hannac::HSettings settings;
+    settings.set_max_specializations(2);
+    hannac::HSession session{settings};
+    auto results{run(session, "specializationCap.hanna")};
+    ASSERT_EQ(results.size(), 4);
+    EXPECT_EQ(4.0, results[1].get_result().r);
+    EXPECT_EQ(6.0, results[2].get_result().r);
+    EXPECT_TRUE(session.get_specialization_guard().mFallbacks.empty());
+    EXPECT_EQ(3, session.get_library().get_compiled_methods());
+}
+
+TEST(HJIT, NoGenericFallbackByDefault)
+{
+    hannac::HSession session;
+    auto results{run(session, "specializationCap.hanna")};
+    ASSERT_EQ(results.size(), 4);
+    EXPECT_TRUE(session.get_specialization_guard().mFallbacks.empty());
+    EXPECT_EQ(3, session.get_library().get_compiled_methods());
+}
+
+TEST(HJIT, DisplayNames)
+{
+    EXPECT_EQ("scale(int, double)", hannac::jit::get_display_name("scale_int_double"));
+    EXPECT_EQ("answer", hannac::jit::get_display_name("answer"));
+    EXPECT_EQ("scale(int, int) [hot]", hannac::jit::get_display_name("scale_int_int.hot"));
+    EXPECT_EQ("scale(int, int) [0=i4]", hannac::jit::get_display_name("scale_int_int.0=i4"));
+    EXPECT_EQ("__hanna_execution", hannac::jit::get_display_name("__hanna_execution"));
+    EXPECT_EQ(
+        hannac::ast::produce_display_name("scale", {hannac::ast::ASTType::Number, hannac::ast::ASTType::RealNumber}),
+        hannac::jit::get_display_name("scale_int_double"));
+}
+
+TEST(HJIT, DebugInfoLines)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_debug_info(true);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/debugInfo.hanna"}}};
+    parser.parse();
+
+    hannac::HCompilationContext ctx(session);
+    auto func = session.find_method("sumSquares")
+                    ->codegen_specialization(ctx, {hannac::ast::ASTType::Number, hannac::ast::ASTType::Number});
+    ASSERT_NE(nullptr, func);
+    auto subprogram = func->getSubprogram();
+    ASSERT_NE(nullptr, subprogram);
+    EXPECT_EQ("sumSquares(int, int)", subprogram->getName());
+    EXPECT_EQ("debugInfo.hanna", subprogram->getFilename());
+    EXPECT_EQ(5, subprogram->getLine());
+    EXPECT_EQ(7, subprogram->getScopeLine());
+    auto ret = func->getEntryBlock().getTerminator();
+    ASSERT_TRUE(ret->getDebugLoc());
+    EXPECT_EQ(7, ret->getDebugLoc().getLine());
+}
+
+TEST(HJIT, DebugInfoAndPerfMap)
+{
+    hannac::HSettings settings;
+    settings.set_debug_info(true);
+    settings.set_perf(true);
+    hannac::HSession session{settings};
+    auto results{run(session, "debugInfo.hanna")};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(25, results[0].get_result().i);
+    EXPECT_EQ(6.25, results[1].get_result().r);
+
+    std::ifstream map{hannac::jit::HPerfMapListener::get_path()};
+    ASSERT_TRUE(map.is_open());
+    std::stringstream entries;
+    entries << map.rdbuf();
+    EXPECT_NE(std::string::npos, entries.str().find(" sumSquares(double, int)\n"));
+    EXPECT_NE(std::string::npos, entries.str().find(" square(int)\n"));
+}
@@ -0,0 +1,149 @@
+#include "ObjectCache.hpp"
+#include "gtest/gtest.h"
+
+// llvm includes
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+// stdlib includes
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace
+{
+std::unique_ptr<llvm::Module> make_module(llvm::LLVMContext &context, std::string const &astHash)
+{
+    auto module = std::make_unique<llvm::Module>("Hanna Jit", context);
+    auto type = llvm::FunctionType::get(llvm::Type::getInt64Ty(context), {llvm::Type::getInt64Ty(context)}, false);
+    auto func = llvm::Function::Create(type, llvm::Function::ExternalLinkage, "add_int", module.get());
+    auto block = llvm::BasicBlock::Create(context, "Entry", func);
+    llvm::ReturnInst::Create(context, func->getArg(0), block);
+    if (!astHash.empty())
+        func->addFnAttr(hannac::jit::HASTHashAttribute, astHash);
+
+    return module;
+}
+
+std::filesystem::path make_cache_dir(std::string const &name)
+{
+    auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    return dir;
+}
+} // namespace
+
+TEST(HObjectCache, Key)
+{
+    llvm::LLVMContext context;
+    hannac::jit::HObjectCache cache;
+
+    auto first = make_module(context, "abc");
+    auto second = make_module(context, "abc");
+    auto other = make_module(context, "abd");
+    auto untagged = make_module(context, "");
+
+    EXPECT_EQ(cache.get_key(*first), cache.get_key(*second));
+    EXPECT_NE(cache.get_key(*first), cache.get_key(*other));
+    EXPECT_FALSE(cache.get_key(*untagged).has_value());
+
+    auto key = cache.get_key(*first);
+    cache.set_opt_level(3);
+    EXPECT_NE(key, cache.get_key(*first));
+    cache.set_opt_level(2);
+    cache.set_fast_math(true);
+    EXPECT_NE(key, cache.get_key(*first));
+    cache.set_fast_math(false);
+    cache.set_target("x86_64-unknown-linux-gnu", "znver4", "+avx2");
+    EXPECT_NE(key, cache.get_key(*first));
+}
+
+TEST(HObjectCache, OptTierKey)
+{
+    // Objects optimized with the light pipeline aren't reused where the full one is chosen.
+    llvm::LLVMContext context;
+    hannac::jit::HObjectCache cache;
+    auto light = make_module(context, "abc");
+    light->getFunction("add_int")->addFnAttr(hannac::jit::HOptTierAttribute, "light");
+    auto full = make_module(context, "abc");
+    full->getFunction("add_int")->addFnAttr(hannac::jit::HOptTierAttribute, "full");
+
+    EXPECT_NE(cache.get_key(*light), cache.get_key(*full));
+    EXPECT_NE(cache.get_key(*light), cache.get_key(*make_module(context, "abc")));
+}
+
+TEST(HObjectCache, StoreAndLoad)
+{
+    llvm::LLVMContext context;
+    hannac::jit::HObjectCache cache;
+    cache.set_directory(make_cache_dir("hannac_cache_store"));
+    auto module = make_module(context, "abc");
+
+    EXPECT_FALSE(cache.contains(*module));
+    EXPECT_EQ(cache.getObject(module.get()), nullptr);
+
+    std::string object{"object"};
+    cache.notifyObjectCompiled(module.get(), llvm::MemoryBufferRef(object, "add_int"));
+    EXPECT_TRUE(cache.contains(*module));
+
+    auto loaded = cache.getObject(module.get());
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->getBuffer().str(), object);
+    EXPECT_EQ(cache.get_hits(), 1u);
+    EXPECT_EQ(cache.get_misses(), 1u);
+    EXPECT_EQ(cache.get_stores(), 1u);
+}
+
+TEST(HObjectCache, Eviction)
+{
+    llvm::LLVMContext context;
+    hannac::jit::HObjectCache cache;
+    cache.set_directory(make_cache_dir("hannac_cache_evict"));
+    cache.set_max_size(10);
+    auto first = make_module(context, "first");
+    auto second = make_module(context, "second");
+
+    std::string object{"12345678"};
+    cache.notifyObjectCompiled(first.get(), llvm::MemoryBufferRef(object, "first"));
+    cache.notifyObjectCompiled(second.get(), llvm::MemoryBufferRef(object, "second"));
+
+    // Only one object fits.
+    EXPECT_EQ(cache.contains(*first) + cache.contains(*second), 1);
+}
+
+TEST(HObjectCache, EvictionCountsExistingObjects)
+{
+    // Objects of earlier runs count towards the budget and are evicted first.
+    auto dir = make_cache_dir("hannac_cache_existing");
+    std::filesystem::create_directories(dir);
+    auto old = dir / "old.o";
+    std::ofstream(old, std::ios::binary) << "12345678";
+    std::filesystem::last_write_time(old, std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+
+    llvm::LLVMContext context;
+    hannac::jit::HObjectCache cache;
+    cache.set_directory(dir);
+    cache.set_max_size(10);
+    auto module = make_module(context, "new");
+    std::string object{"12345678"};
+    cache.notifyObjectCompiled(module.get(), llvm::MemoryBufferRef(object, "new"));
+
+    EXPECT_FALSE(std::filesystem::exists(old));
+    EXPECT_TRUE(cache.contains(*module));
+}
+
+TEST(HObjectCache, Disabled)
+{
+    llvm::LLVMContext context;
+    hannac::jit::HObjectCache cache;
+    auto module = make_module(context, "abc");
+
+    std::string object{"object"};
+    cache.notifyObjectCompiled(module.get(), llvm::MemoryBufferRef(object, "add_int"));
+    EXPECT_FALSE(cache.contains(*module));
+    EXPECT_EQ(cache.getObject(module.get()), nullptr);
+}
@@ -0,0 +1,103 @@
+#include "AST.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Optimizer.hpp"
+#include "Scheduler.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <filesystem>
+#include <string>
+
+namespace
+{
+std::string number(std::string const &name)
+{
+    return hannac::ast::produce_func_name(name, {hannac::ast::ASTType::Number});
+}
+} // namespace
+
+TEST(HOptimizer, CostModel)
+{
+    hannac::HOptimizer optimizer;
+    hannac::HOptReason reason;
+    EXPECT_EQ(hannac::HOptTier::Light, optimizer.choose(3, 1000, reason));
+    EXPECT_EQ(hannac::HOptReason::Tiny, reason);
+    EXPECT_EQ(hannac::HOptTier::Full, optimizer.choose(40, 1, reason));
+    EXPECT_EQ(hannac::HOptReason::Default, reason);
+    EXPECT_EQ(hannac::HOptTier::Light, optimizer.choose(1000, 1, reason));
+    EXPECT_EQ(hannac::HOptReason::LargeCold, reason);
+    EXPECT_EQ(hannac::HOptTier::Full, optimizer.choose(1000, 1000, reason));
+    EXPECT_EQ(hannac::HOptReason::Hot, reason);
+}
+
+TEST(HOptimizer, PredictCallFrequencies)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/callGraph.hanna"}}};
+    auto program = parser.parse();
+
+    hannac::HCompileScheduler scheduler{session, program};
+    auto const &frequencies = scheduler.get_call_frequencies();
+    EXPECT_EQ(2, frequencies.at(number("sum16")));
+    EXPECT_EQ(8, frequencies.at(number("sum4")));
+    EXPECT_EQ(32, frequencies.at(number("inc")));
+
+    // Nothing is compiled before the scheduler runs.
+    EXPECT_EQ(0, session.get_library().get_compiled_methods());
+}
+
+TEST(HOptimizer, TierPerFunction)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/callGraph.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(32, results[0].get_result().i);
+    EXPECT_EQ(48, results[1].get_result().i);
+
+    // Every function got a pipeline together with the predicted calls of the call graph.
+    auto decisions = session.get_optimizer().get_decisions();
+    auto stats = session.get_optimizer().get_stats();
+    EXPECT_EQ(decisions.size(), stats.mLight + stats.mFull);
+    bool foundInc = false;
+    for (auto const &decision : decisions)
+    {
+        if (decision.mFunction == number("inc"))
+        {
+            foundInc = true;
+            EXPECT_EQ(32, decision.mCallFrequency);
+            EXPECT_EQ(hannac::HOptTier::Light, decision.mTier);
+            EXPECT_EQ(hannac::HOptReason::Tiny, decision.mReason);
+        }
+    }
+    EXPECT_TRUE(foundInc);
+
+    // The decisions of all sessions are part of the run statistics.
+    auto recorded = session.get_jit().get_run_stats().get_opt_decisions();
+    EXPECT_EQ(decisions.size(), recorded.size());
+    ASSERT_EQ(1, recorded.count(number("inc")));
+    EXPECT_EQ(hannac::HOptTier::Light, recorded[number("inc")].mTier);
+    EXPECT_EQ(stats.mOverBudget, session.get_jit().get_run_stats().get_opt_stats().mOverBudget);
+}
+
+TEST(HOptimizer, NoOptimization)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_opt_level(0);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/callGraph.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_TRUE(session.get_optimizer().get_decisions().empty());
+}
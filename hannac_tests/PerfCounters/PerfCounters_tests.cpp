@@ -0,0 +1,89 @@
+#include "AST.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "PerfCounters.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <cstdint>
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+TEST(HPerfCounters, Read)
+{
+    hannac::HPerfCounters counters;
+    if (!counters.available())
+        GTEST_SKIP() << counters.get_error();
+
+    auto start = counters.read();
+    volatile std::uint64_t sum = 0;
+    for (std::uint64_t i = 0; i < 100000; i++)
+        sum = sum + i;
+    auto events = counters.read() - start;
+    EXPECT_GT(events.mCycles, 0);
+    EXPECT_GT(events.mInstructions, 100000);
+    EXPECT_GT(events.get_ipc(), 0.0);
+}
+
+TEST(HCounterReport, Statements)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_hardware_counters(hannac::HHardwareCounters::Statements);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/counters.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+
+    // Without counters the statements still run.
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(results[0].get_result().i, 6);
+
+    auto &report = session.get_jit().get_counter_report();
+    EXPECT_TRUE(report.enabled());
+    EXPECT_FALSE(session.get_jit().get_profiler().enabled());
+    std::ostringstream out;
+    report.print(out);
+    EXPECT_NE(std::string::npos, out.str().find("IPC"));
+    if (!hannac::HPerfCounters().available())
+        GTEST_SKIP();
+
+    EXPECT_GT(report.get("scale(4,3)").mInstructions, 0);
+    EXPECT_GT(report.get("half(10)").mCycles, 0);
+    EXPECT_NE(std::string::npos, out.str().find("scale(4,3)"));
+}
+
+TEST(HCounterReport, Methods)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_hardware_counters(hannac::HHardwareCounters::Methods);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/counters.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    ex();
+
+    // Counting per method profiles the methods.
+    auto &profiler = session.get_jit().get_profiler();
+    EXPECT_TRUE(profiler.enabled());
+    EXPECT_TRUE(profiler.counts_hardware_events());
+    std::ostringstream out;
+    profiler.print(out);
+    EXPECT_NE(std::string::npos, out.str().find("cache misses"));
+    if (!hannac::HPerfCounters().available())
+        GTEST_SKIP();
+
+    for (auto const &entry : profiler.get_profile())
+    {
+        if (entry.mMethod == "scale")
+        {
+            EXPECT_GT(entry.mEvents.mInstructions, 0);
+        }
+    }
+}
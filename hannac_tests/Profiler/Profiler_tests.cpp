@@ -0,0 +1,167 @@
+#include "AST.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "Profiler.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+std::map<std::string, hannac::HProfileCounters> run_profiled(hannac::HSettings settings, std::string &callGraph)
+{
+    std::filesystem::path path(__FILE__);
+    settings.set_profile(true);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/profile.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    ex();
+
+    auto &profiler = session.get_jit().get_profiler();
+    std::map<std::string, hannac::HProfileCounters> profile;
+    for (auto const &entry : profiler.get_profile())
+        profile[entry.mMethod + entry.mSignature] = entry.mCounters;
+
+    std::ostringstream out;
+    profiler.write_call_graph(out);
+    callGraph = out.str();
+    return profile;
+}
+} // namespace
+
+TEST(HProfiler, SelfAndInclusive)
+{
+    hannac::HProfiler profiler{true, true};
+    auto outer = profiler.get_slot("lib", "outer", "outer", "()");
+    auto inner = profiler.get_slot("lib", "inner", "inner", "()");
+    EXPECT_EQ(outer, profiler.get_slot("lib", "outer", "outer", "()"));
+
+    // inner calls itself once.
+    hannac::HProfiler::enter(&profiler, outer);
+    hannac::HProfiler::enter(&profiler, inner);
+    hannac::HProfiler::enter(&profiler, inner);
+    hannac::HProfiler::exit(&profiler, inner);
+    hannac::HProfiler::exit(&profiler, inner);
+    hannac::HProfiler::exit(&profiler, outer);
+
+    std::map<std::string, hannac::HProfileCounters> profile;
+    for (auto const &entry : profiler.get_profile())
+        profile[entry.mMethod] = entry.mCounters;
+    ASSERT_EQ(2, profile.size());
+    EXPECT_EQ(1, profile["outer"].mCalls);
+    EXPECT_EQ(2, profile["inner"].mCalls);
+
+    // The recursive call counts once for the inclusive time, all self time adds up to the outermost call.
+    EXPECT_EQ(profile["inner"].mSelf, profile["inner"].mInclusive);
+    EXPECT_EQ(profile["outer"].mSelf + profile["inner"].mSelf, profile["outer"].mInclusive);
+
+    auto callGraph = profiler.get_call_graph();
+    ASSERT_EQ(2, callGraph.size());
+    std::map<std::string, std::uint64_t> calls;
+    for (auto const &edge : callGraph)
+        calls[edge.mCaller + " -> " + edge.mCallee] = edge.mCalls;
+    EXPECT_EQ(1, (calls["outer() lib -> inner() lib"]));
+    EXPECT_EQ(1, (calls["inner() lib -> inner() lib"]));
+}
+
+TEST(HProfiler, Disabled)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/profile.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    ex();
+
+    EXPECT_FALSE(session.get_jit().get_profiler().enabled());
+    EXPECT_TRUE(session.get_jit().get_profiler().get_profile().empty());
+}
+
+TEST(HProfiler, Calls)
+{
+    for (int optLevel : {0, 2})
+    {
+        hannac::HSettings settings;
+        settings.set_opt_level(optLevel);
+        std::string callGraph;
+        auto profile = run_profiled(settings, callGraph);
+
+        EXPECT_EQ(2, profile["scale(int, int)"].mCalls) << optLevel;
+        EXPECT_EQ(2, profile["half(int)"].mCalls) << optLevel;
+        EXPECT_EQ(1, profile["half(double)"].mCalls) << optLevel;
+        EXPECT_EQ(1, profile["main: scale(4,3)"].mCalls) << optLevel;
+        EXPECT_GE(profile["main: scale(4,3)"].mInclusive, profile["main: scale(4,3)"].mSelf) << optLevel;
+
+        // Every statement has a slot of its own.
+        std::uint64_t statements = 0;
+        for (auto const &[name, counters] : profile)
+            statements += name.rfind("main: ", 0) == 0 ? counters.mCalls : 0;
+        EXPECT_EQ(3, statements) << optLevel;
+
+        // Without call graph only the nodes are written.
+        EXPECT_EQ(std::string::npos, callGraph.find("->")) << optLevel;
+    }
+}
+
+TEST(HProfiler, CallGraph)
+{
+    hannac::HSettings settings;
+    settings.set_call_graph_file("profile.dot");
+    std::string callGraph;
+    auto profile = run_profiled(settings, callGraph);
+
+    EXPECT_EQ(2, profile["scale(int, int)"].mCalls);
+    EXPECT_EQ(0, callGraph.find("digraph profile {"));
+    EXPECT_NE(std::string::npos,
+              callGraph.find("\"main: scale(4,3) <main>\" -> \"scale(int, int) <main>\" [label=\"1 calls"));
+    EXPECT_NE(std::string::npos,
+              callGraph.find("\"scale(int, int) <main>\" -> \"half(int) <main>\" [label=\"2 calls"));
+}
+
+TEST(HProfiler, ReadWhileRunning)
+{
+    // Slots are registered and counted while another thread reads the profile, the counters must never go backwards.
+    hannac::HProfiler profiler{true, true};
+    auto outer = profiler.get_slot("lib", "outer", "outer", "");
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int i = 0; i < 1000; i++)
+        {
+            auto inner = profiler.get_slot("lib", "inner" + std::to_string(i), "inner", std::to_string(i));
+            hannac::HProfiler::enter(&profiler, outer);
+            hannac::HProfiler::enter(&profiler, inner);
+            hannac::HProfiler::exit(&profiler, inner);
+            hannac::HProfiler::exit(&profiler, outer);
+        }
+        done = true;
+    });
+
+    std::uint64_t lastCalls = 0;
+    while (!done)
+    {
+        auto profile = profiler.get_profile();
+        ASSERT_FALSE(profile.empty());
+        EXPECT_GE(profile[0].mCounters.mCalls, lastCalls);
+        lastCalls = profile[0].mCounters.mCalls;
+        profiler.get_call_graph();
+    }
+    writer.join();
+
+    auto profile = profiler.get_profile();
+    ASSERT_EQ(1001, profile.size());
+    EXPECT_EQ(1000, profile[0].mCounters.mCalls);
+    for (std::size_t slot = 1; slot < profile.size(); slot++)
+        EXPECT_EQ(1, profile[slot].mCounters.mCalls) << slot;
+    EXPECT_EQ(1000, profiler.get_call_graph().size());
+}
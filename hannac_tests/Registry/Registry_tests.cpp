@@ -0,0 +1,152 @@
+#include "AST.hpp"
+#include "FileParser.hpp"
+#include "JIT.hpp"
+#include "Session.hpp"
+#include "Registry.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr unsigned threadCount = 16;
+constexpr unsigned keyCount = 20;
+constexpr unsigned requestCount = 1000;
+} // namespace
+
+TEST(HCompileOnceRegistry, ProducesOnce)
+{
+    hannac::HCompileOnceRegistry<int> registry;
+    std::array<std::atomic<int>, keyCount> produced{};
+
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong{0};
+    for (unsigned t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (unsigned i = 0; i < requestCount; i++)
+            {
+                auto key = (i + t) % keyCount;
+                auto value = registry.get_or_create("key" + std::to_string(key), [&]() {
+                    produced[key]++;
+                    // Keep the entry in flight for a while so other threads have to wait for it.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    return static_cast<int>(key * key);
+                });
+                if (value != static_cast<int>(key * key))
+                    wrong++;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    EXPECT_EQ(wrong.load(), 0);
+    for (auto const &count : produced)
+        EXPECT_EQ(count.load(), 1);
+
+    auto stats = registry.get_stats();
+    EXPECT_EQ(stats.mRequests, threadCount * requestCount);
+    EXPECT_EQ(stats.mCreated, keyCount);
+    EXPECT_EQ(stats.mHits + stats.mWaits + stats.mCreated, stats.mRequests);
+}
+
+TEST(HCompileOnceRegistry, ProducerThrows)
+{
+    hannac::HCompileOnceRegistry<int> registry;
+    EXPECT_THROW(registry.get_or_create("key", []() -> int { throw std::runtime_error("failed"); }),
+                 std::runtime_error);
+    EXPECT_FALSE(registry.contains("key"));
+
+    // Failed entries are produced again.
+    EXPECT_EQ(registry.get_or_create("key", []() { return 1; }), 1);
+    EXPECT_EQ(registry.get_or_create("key", []() { return 2; }), 1);
+    EXPECT_EQ(registry.get_stats().mCreated, 1u);
+
+    registry.erase("key");
+    EXPECT_EQ(registry.get_or_create("key", []() { return 2; }), 2);
+}
+
+TEST(HCompileOnceRegistry, ConcurrentSpecializations)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "registry.hanna"}}};
+    parser.parse();
+
+    using hannac::ast::ASTType;
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong{0};
+    for (unsigned t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (std::int64_t i = 0; i < 100; i++)
+            {
+                // Overlapping signatures: every thread requests the same three specializations.
+                switch ((i + t) % 3)
+                {
+                case 0: {
+                    auto address = llvm::cantFail(
+                        hannac::ast::compile_specialization(session, "regAdd", {ASTType::Number, ASTType::Number}));
+                    if (address.toPtr<std::int64_t (*)(std::int64_t, std::int64_t)>()(i, 2) != i + 2)
+                        wrong++;
+                    break;
+                }
+                case 1: {
+                    auto address = llvm::cantFail(hannac::ast::compile_specialization(
+                        session, "regMul", {ASTType::RealNumber, ASTType::RealNumber}));
+                    if (address.toPtr<double (*)(double, double)>()(0.5, 2.0) != 5.0)
+                        wrong++;
+                    break;
+                }
+                default: {
+                    auto address =
+                        llvm::cantFail(hannac::ast::compile_specialization(session, "regSquare", {ASTType::Number}));
+                    if (address.toPtr<std::int64_t (*)(std::int64_t)>()(i) != 0)
+                        wrong++;
+                    break;
+                }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    EXPECT_EQ(wrong.load(), 0);
+    auto stats = session.get_library().get_specializations().get_stats();
+    EXPECT_EQ(stats.mRequests, threadCount * 100u);
+    EXPECT_EQ(stats.mCreated, 3u);
+}
+
+TEST(HCompileOnceRegistry, FailedSpecializationRetried)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "registry.hanna"}}};
+    parser.parse();
+
+    // The return type of regUndefined can't be inferred, every request fails and nothing is cached.
+    using hannac::ast::ASTType;
+    for (int i = 0; i < 2; i++)
+    {
+        auto address = hannac::ast::compile_specialization(session, "regUndefined", {ASTType::Number});
+        ASSERT_FALSE(static_cast<bool>(address));
+        llvm::consumeError(address.takeError());
+        EXPECT_FALSE(session.get_library().get_specializations().contains(
+            hannac::ast::produce_func_name("regUndefined", {ASTType::Number})));
+    }
+    EXPECT_EQ(session.get_library().get_specializations().get_stats().mCreated, 0u);
+}
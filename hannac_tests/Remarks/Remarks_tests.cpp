@@ -0,0 +1,96 @@
+#include "AST.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "Remarks.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// llvm includes.
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+// stdlib includes
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+TEST(HRemarks, TaggedWithMethod)
+{
+    hannac::HRemarks remarks{true};
+    llvm::LLVMContext context;
+    context.setDiagnosticHandler(std::make_unique<hannac::HRemarkHandler>(remarks));
+    llvm::Module module("remarks", context);
+    llvm::IRBuilder<> builder(context);
+    auto func = llvm::Function::Create(llvm::FunctionType::get(builder.getInt64Ty(), false),
+                                       llvm::Function::ExternalLinkage, "scale_int_double", module);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "Entry", func));
+    auto ret = builder.CreateRet(builder.getInt64(0));
+
+    llvm::OptimizationRemarkMissed missed("inline", "NoDefinition", ret);
+    missed << "'half' isn't defined";
+    context.diagnose(missed);
+    llvm::OptimizationRemark passed("gvn", "LoadElim", ret);
+    passed << "load eliminated";
+    context.diagnose(passed);
+
+    auto all = remarks.get_remarks();
+    ASSERT_EQ(2, all.size());
+    EXPECT_EQ("Missed", all[0].mKind);
+    EXPECT_EQ("inline", all[0].mPass);
+    EXPECT_EQ("scale", all[0].mMethod);
+    EXPECT_EQ("(int, double)", all[0].mSignature);
+    EXPECT_EQ("'half' isn't defined", all[0].mMessage);
+    EXPECT_EQ("Passed", all[1].mKind);
+
+    auto counts = remarks.get_counts();
+    EXPECT_EQ(1, counts["scale(int, double)"].mMissed);
+    EXPECT_EQ(1, counts["scale(int, double)"].mPassed);
+
+    std::ostringstream yaml;
+    remarks.write_yaml(yaml);
+    EXPECT_EQ(0, yaml.str().find("--- !Missed\nPass:            'inline'\n"));
+    EXPECT_NE(std::string::npos, yaml.str().find("Signature:       '(int, double)'"));
+    EXPECT_NE(std::string::npos, yaml.str().find("Message:         '''half'' isn''t defined'"));
+
+    std::ostringstream json;
+    remarks.write_json(json);
+    EXPECT_NE(std::string::npos, json.str().find("\"method\": \"scale\", \"signature\": \"(int, double)\""));
+    EXPECT_NE(std::string::npos,
+              json.str().find("\"scale(int, double)\": {\"passed\": 1, \"missed\": 1, \"analysis\": 0}"));
+}
+
+TEST(HRemarks, Program)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_remarks_file("remarks.yaml");
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/remarks.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    ASSERT_EQ(2, ex().size());
+
+    // The code generator reports on every function it emits.
+    auto &remarks = session.get_jit().get_remarks();
+    EXPECT_TRUE(remarks.enabled());
+    auto counts = remarks.get_counts();
+    EXPECT_GT(counts.count("scale(int, int)"), 0);
+    EXPECT_GT(counts.count("scale(double, int)"), 0);
+    EXPECT_GT(counts.count("half(int)"), 0);
+}
+
+TEST(HRemarks, Disabled)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/remarks.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    ex();
+
+    EXPECT_FALSE(session.get_jit().get_remarks().enabled());
+    EXPECT_TRUE(session.get_jit().get_remarks().get_remarks().empty());
+}
@@ -0,0 +1,165 @@
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(HSession, SameMethodNames)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession first;
+    hannac::HSession second;
+    hannac::HTokenParser firstParser{
+        first, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "first.hanna"}}};
+    hannac::HTokenParser secondParser{
+        second, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "second.hanna"}}};
+
+    // Both sessions exist at the same time, each with its own definition of value.
+    hannac::HExecutor firstEx{first, firstParser.parse()};
+    hannac::HExecutor secondEx{second, secondParser.parse()};
+    auto firstResults{firstEx()};
+    auto secondResults{secondEx()};
+
+    ASSERT_EQ(firstResults.size(), 1);
+    ASSERT_EQ(secondResults.size(), 1);
+    EXPECT_EQ(42, firstResults[0].get_result().i);
+    EXPECT_EQ(82, secondResults[0].get_result().i);
+}
+
+TEST(HSession, ConcurrentPrograms)
+{
+    std::filesystem::path path(__FILE__);
+    auto file = path.parent_path().parent_path().string() + "/Executor/data/callChain.hanna";
+
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+    {
+        threads.emplace_back([&file, &wrong]() {
+            hannac::HSession session;
+            hannac::HTokenParser parser{session, hannac::HLexer{hannac::HFileParser{file}}};
+            hannac::HExecutor ex{session, parser.parse()};
+            auto results{ex()};
+
+            if (results.size() != 3 || results[0].get_result().i != -7 || results[1].get_result().r != -1.0 ||
+                results[2].get_result().i != 12)
+                wrong++;
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    EXPECT_EQ(wrong.load(), 0);
+}
+
+TEST(HSession, SharedLibrary)
+{
+    std::filesystem::path path(__FILE__);
+    auto data = path.parent_path().string() + "/data/";
+    hannac::HSession library;
+    hannac::HTokenParser libParser{library, hannac::HLexer{hannac::HFileParser{data + "library.hanna"}}};
+    libParser.parse_library();
+
+    std::size_t compiled = 0;
+    for (int run = 0; run < 2; run++)
+    {
+        hannac::HSession program{library};
+        hannac::HTokenParser parser{program, hannac::HLexer{hannac::HFileParser{data + "useLibrary.hanna"}}};
+        hannac::HExecutor ex{program, parser.parse()};
+        auto results{ex()};
+
+        ASSERT_EQ(results.size(), 2);
+        EXPECT_EQ(25, results[0].get_result().i);
+        EXPECT_EQ(5, results[1].get_result().i);
+
+        // Library methods are compiled into the library, the program only holds its own methods.
+        EXPECT_EQ(1, program.get_library().get_compiled_methods());
+        if (run == 0)
+            compiled = library.get_library().get_compiled_methods();
+    }
+
+    // The second program reuses the library code of the first one.
+    EXPECT_EQ(2, compiled);
+    EXPECT_EQ(compiled, library.get_library().get_compiled_methods());
+}
+
+TEST(HSession, LibraryCodeBudget)
+{
+    std::filesystem::path path(__FILE__);
+    auto data = path.parent_path().string() + "/data/";
+    hannac::HSettings settings;
+    settings.set_code_budget(1);
+    hannac::HSession library{settings};
+    hannac::HTokenParser libParser{library, hannac::HLexer{hannac::HFileParser{data + "library.hanna"}}};
+    libParser.parse_library();
+
+    for (int run = 0; run < 2; run++)
+    {
+        {
+            hannac::HSession program{library};
+            hannac::HTokenParser parser{program, hannac::HLexer{hannac::HFileParser{data + "useLibrary.hanna"}}};
+            hannac::HExecutor ex{program, parser.parse()};
+            auto results{ex()};
+            ASSERT_EQ(results.size(), 2);
+            EXPECT_EQ(25, results[0].get_result().i);
+            EXPECT_EQ(5, results[1].get_result().i);
+        }
+
+        // The library code stays loaded while the program runs and is evicted between programs.
+        EXPECT_GT(library.get_library().get_resident_size(), 0);
+        EXPECT_FALSE(static_cast<bool>(library.get_library().evict_cold_methods()));
+        EXPECT_EQ(0, library.get_library().get_resident_size());
+    }
+
+    // The second program compiled the evicted library methods again.
+    EXPECT_EQ(4, library.get_library().get_compiled_methods());
+    EXPECT_EQ(4, library.get_library().get_evicted_methods());
+}
+
+TEST(HSession, ProgramTeardown)
+{
+    std::filesystem::path path(__FILE__);
+    auto data = path.parent_path().string() + "/data/";
+    hannac::HSession library;
+    hannac::HTokenParser libParser{library, hannac::HLexer{hannac::HFileParser{data + "library.hanna"}}};
+    libParser.parse_library();
+
+    auto first = std::make_unique<hannac::HSession>(library);
+    hannac::HSession second{library};
+    hannac::HTokenParser firstParser{*first, hannac::HLexer{hannac::HFileParser{data + "useLibrary.hanna"}}};
+    hannac::HTokenParser secondParser{second, hannac::HLexer{hannac::HFileParser{data + "useLibrary.hanna"}}};
+    hannac::HExecutor firstEx{*first, firstParser.parse()};
+    auto firstResults{firstEx()};
+    ASSERT_EQ(firstResults.size(), 2);
+
+    // Removing the first program leaves the library and other programs intact.
+    EXPECT_FALSE(static_cast<bool>(first->get_library().remove()));
+    first.reset();
+
+    hannac::HExecutor secondEx{second, secondParser.parse()};
+    auto secondResults{secondEx()};
+    ASSERT_EQ(secondResults.size(), 2);
+    EXPECT_EQ(25, secondResults[0].get_result().i);
+    EXPECT_EQ(5, secondResults[1].get_result().i);
+}
+
+TEST(HSession, RedefineLibraryMethod)
+{
+    std::filesystem::path path(__FILE__);
+    auto data = path.parent_path().string() + "/data/";
+    hannac::HSession library;
+    hannac::HTokenParser libParser{library, hannac::HLexer{hannac::HFileParser{data + "library.hanna"}}};
+    libParser.parse_library();
+
+    hannac::HSession program{library};
+    hannac::HTokenParser parser{program, hannac::HLexer{hannac::HFileParser{data + "redefineLibrary.hanna"}}};
+    EXPECT_THROW(parser.parse(), hannac::ParseError);
+}
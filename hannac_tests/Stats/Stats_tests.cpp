@@ -0,0 +1,73 @@
+#include "AST.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "Session.hpp"
+#include "Stats.hpp"
+#include "TokenParser.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+TEST(HRunStats, Counters)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSession session;
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/stats.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 3);
+
+    auto &stats = session.get_jit().get_run_stats();
+    EXPECT_GT(stats.mTokens, 0);
+    EXPECT_EQ(3, stats.mMethodsParsed);
+    EXPECT_EQ(3, stats.mStatements);
+
+    auto nodes = stats.get_nodes();
+    EXPECT_EQ(3, nodes["FuncDef"]);
+    EXPECT_EQ(3, nodes["FuncDecl"]);
+    EXPECT_EQ(2, nodes["Binary"]);
+    EXPECT_EQ(4, nodes["MethodCall"]);
+    EXPECT_EQ(1, nodes["RealNumber"]);
+
+    // unused is never compiled, scale and half are compiled for int and double arguments.
+    auto specializations = stats.get_specializations();
+    EXPECT_EQ(2, specializations.size());
+    EXPECT_EQ(2, specializations["scale"]);
+    EXPECT_EQ(2, specializations["half"]);
+
+    // Every statement runs in its own module and tracker.
+    EXPECT_GE(stats.mModules, 3 + 4);
+    EXPECT_GT(stats.mCodeBytes, 0);
+    EXPECT_GE(stats.mTrackersCreated, 3);
+    EXPECT_GE(stats.mTrackersRemoved, 3);
+}
+
+TEST(HRunStats, Json)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_stats_file("stats.json");
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/stats.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    ex();
+
+    std::ostringstream out;
+    session.get_jit().get_run_stats().write_json(out, session.get_jit().get_time_report());
+    auto json = out.str();
+    for (auto const &key :
+         {"\"tokens\"", "\"ast_nodes\"", "\"methods\": {\"parsed\": 3, \"compiled\": 2", "\"scale\": 2",
+          "\"code_bytes\"", "\"statements\": 3", "\"phases_ns\"", "\"peak_rss_bytes\"", "\"optimizer\": {\"full\"",
+          "\"tier\""})
+        EXPECT_NE(std::string::npos, json.find(key)) << key;
+    EXPECT_EQ('{', json.front());
+
+    // Stats imply timing the phases.
+    EXPECT_GT(session.get_jit().get_time_report().get(hannac::HPhase::Execute), 0);
+}
@@ -11,13 +11,14 @@
 TEST(HTokenParser, MissingReturn)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "missingReturn.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "missingReturn.hanna"}}};
 
     bool exception = false;
     try
     {
-        hannac::HExecutor ex{parser.parse()};
+        hannac::HExecutor ex{session, parser.parse()};
     }
     catch (const std::exception &e)
     {
@@ -30,13 +31,14 @@ TEST(HTokenParser, MissingReturn)
 TEST(HTokenParser, NoMain)
 {
     std::filesystem::path path(__FILE__);
+    hannac::HSession session;
     hannac::HTokenParser parser{
-        hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "noMain.hanna"}}};
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/" + "noMain.hanna"}}};
 
     bool exception = false;
     try
     {
-        hannac::HExecutor ex{parser.parse()};
+        hannac::HExecutor ex{session, parser.parse()};
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,98 @@
+#include "AST.hpp"
+#include "Executor.hpp"
+#include "FileParser.hpp"
+#include "GlobalSettings.hpp"
+#include "Session.hpp"
+#include "TokenParser.hpp"
+#include "Trace.hpp"
+#include "gtest/gtest.h"
+
+// stdlib includes
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+TEST(HTimeReport, ExclusiveNesting)
+{
+    hannac::HTimeReport report{true};
+    {
+        hannac::HPhaseScope outer(report, hannac::HPhase::Execute);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        {
+            // Time spent here is not accounted to the outer phase.
+            hannac::HPhaseScope inner(report, hannac::HPhase::IRGen);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    EXPECT_GE(report.get(hannac::HPhase::Execute), 5 * 1000 * 1000);
+    EXPECT_GE(report.get(hannac::HPhase::IRGen), 50 * 1000 * 1000);
+    EXPECT_LT(report.get(hannac::HPhase::Execute), report.get(hannac::HPhase::IRGen));
+    EXPECT_EQ(0, report.get(hannac::HPhase::Lex));
+}
+
+TEST(HTimeReport, Disabled)
+{
+    hannac::HTimeReport report;
+    {
+        hannac::HPhaseScope scope(report, hannac::HPhase::Execute);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(0, report.get(hannac::HPhase::Execute));
+}
+
+TEST(HTimeReport, Phases)
+{
+    std::filesystem::path path(__FILE__);
+    hannac::HSettings settings;
+    settings.set_time_report(true);
+    hannac::HSession session{settings};
+    hannac::HTokenParser parser{
+        session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/phases.hanna"}}};
+    hannac::HExecutor ex{session, parser.parse()};
+    auto results{ex()};
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(25, results[0].get_result().i);
+    EXPECT_DOUBLE_EQ(6.25, results[1].get_result().r);
+
+    auto &report = session.get_jit().get_time_report();
+    for (auto phase : {hannac::HPhase::Lex, hannac::HPhase::Parse, hannac::HPhase::TypeInfer, hannac::HPhase::IRGen,
+                       hannac::HPhase::Opt, hannac::HPhase::Codegen, hannac::HPhase::Link, hannac::HPhase::Execute})
+        EXPECT_GT(report.get(phase), 0) << hannac::to_string(phase);
+
+    std::ostringstream out;
+    report.print(out);
+    EXPECT_NE(std::string::npos, out.str().find("Code generation"));
+    EXPECT_NE(std::string::npos, out.str().find("Total"));
+}
+
+TEST(HTimeReport, Trace)
+{
+    std::filesystem::path path(__FILE__);
+    auto traceFile = (std::filesystem::temp_directory_path() / "hannac_trace_test.json").string();
+    hannac::start_thread_trace();
+    {
+        hannac::HSession session;
+        hannac::HTokenParser parser{
+            session, hannac::HLexer{hannac::HFileParser{path.parent_path().string() + "/data/phases.hanna"}}};
+        hannac::HExecutor ex{session, parser.parse()};
+        ex();
+    }
+    ASSERT_FALSE(static_cast<bool>(hannac::write_trace(traceFile)));
+
+    std::ifstream file{traceFile};
+    std::stringstream trace;
+    trace << file.rdbuf();
+    std::filesystem::remove(traceFile);
+
+    // Spans of the source file, its methods, every specialization, the passes and every statement.
+    for (auto const &span :
+         {std::string("Parse file"), std::string("Parse method"), std::string("sumSquares"),
+          hannac::ast::produce_func_name("square", {hannac::ast::ASTType::RealNumber}), std::string("InstCombinePass"),
+          std::string("Codegen"), std::string("Execute"), std::string("sumSquares(")})
+        EXPECT_NE(std::string::npos, trace.str().find(span)) << span;
+}
@@ -0,0 +1,135 @@
+// stdlib includes
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// hannac includes
+#include "Generator.hpp"
+
+void print_help()
+{
+    hannac::HGeneratorOptions defaults;
+    std::cout << "Generator of hanna programs for scaling experiments." << std::endl;
+    std::cout << "Usage: hannac_generate <COMMAND_LINE_OPTIONS>" << std::endl;
+    std::cout << "Command line options:" << std::endl;
+    std::cout << "--seed=<N>:\t" << "Seed, the same seed and options generate the same program (default "
+              << defaults.mSeed << ")." << std::endl;
+    std::cout << "--methods=<N>:\t" << "Number of methods (default " << defaults.mMethods << ")." << std::endl;
+    std::cout << "--min-parameters=<N>:\t" << "Minimum parameters per method (default " << defaults.mMinParameters
+              << ")." << std::endl;
+    std::cout << "--max-parameters=<N>:\t" << "Maximum parameters per method (default " << defaults.mMaxParameters
+              << ")." << std::endl;
+    std::cout << "--width=<N>:\t" << "Operands per expression (default " << defaults.mExpressionWidth << ")."
+              << std::endl;
+    std::cout << "--depth=<N>:\t" << "Nesting of expressions in call arguments (default " << defaults.mExpressionDepth
+              << ")." << std::endl;
+    std::cout << "--chain-depth=<N>:\t" << "Methods calling each other in a chain (default " << defaults.mCallChainDepth
+              << ")." << std::endl;
+    std::cout << "--real-ratio=<0-1>:\t" << "Share of real literals (default " << defaults.mRealRatio << ")."
+              << std::endl;
+    std::cout << "--literal-density=<0-1>:\t" << "Share of operands which are literals (default "
+              << defaults.mLiteralDensity << ")." << std::endl;
+    std::cout << "--comment-ratio=<0-1>:\t" << "Share of methods and statements with a comment (default "
+              << defaults.mCommentRatio << ")." << std::endl;
+    std::cout << "--statements=<N>:\t" << "Number of main statements (default " << defaults.mStatements << ")."
+              << std::endl;
+    std::cout << "-o <FILE>:\t" << "Output file, standard output otherwise." << std::endl;
+    std::cout << "-h,--help:\t" << "Print this text" << std::endl;
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    hannac::HGeneratorOptions options;
+    std::string output{};
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg{argv[i]};
+            auto value = arg.substr(arg.find('=') + 1);
+            if (arg.rfind("--seed=", 0) == 0)
+            {
+                options.mSeed = std::stoull(value);
+            }
+            else if (arg.rfind("--methods=", 0) == 0)
+            {
+                options.mMethods = std::stoull(value);
+            }
+            else if (arg.rfind("--min-parameters=", 0) == 0)
+            {
+                options.mMinParameters = std::stoull(value);
+            }
+            else if (arg.rfind("--max-parameters=", 0) == 0)
+            {
+                options.mMaxParameters = std::stoull(value);
+            }
+            else if (arg.rfind("--width=", 0) == 0)
+            {
+                options.mExpressionWidth = std::stoull(value);
+            }
+            else if (arg.rfind("--depth=", 0) == 0)
+            {
+                options.mExpressionDepth = std::stoull(value);
+            }
+            else if (arg.rfind("--chain-depth=", 0) == 0)
+            {
+                options.mCallChainDepth = std::stoull(value);
+            }
+            else if (arg.rfind("--real-ratio=", 0) == 0)
+            {
+                options.mRealRatio = std::stod(value);
+            }
+            else if (arg.rfind("--literal-density=", 0) == 0)
+            {
+                options.mLiteralDensity = std::stod(value);
+            }
+            else if (arg.rfind("--comment-ratio=", 0) == 0)
+            {
+                options.mCommentRatio = std::stod(value);
+            }
+            else if (arg.rfind("--statements=", 0) == 0)
+            {
+                options.mStatements = std::stoull(value);
+            }
+            else if (arg == "-o" && i + 1 < argc)
+            {
+                output = argv[++i];
+            }
+            else if (arg == "-h" || arg == "--help")
+            {
+                print_help();
+                return 0;
+            }
+            else
+            {
+                std::cout << "Unknown option: " << arg << std::endl;
+                print_help();
+                return 1;
+            }
+        }
+    }
+    catch (std::exception const &e)
+    {
+        std::cout << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
+
+    hannac::HProgramGenerator generator{options};
+    if (output.empty())
+    {
+        generator.generate(std::cout);
+        return 0;
+    }
+
+    std::ofstream file(output, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Unable to open " << output << " for writing." << std::endl;
+        return 1;
+    }
+    generator.generate(file);
+    return 0;
+}
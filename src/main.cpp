@@ -1,25 +1,65 @@
 // stdlib includes
 #include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <stdio.h>
+#include <string>
+#include <vector>
 
 // hannac includes
 #include "AST.hpp"
+#include "Allocations.hpp"
 #include "Codegen.hpp"
+#include "Emitter.hpp"
 #include "FileParser.hpp"
 #include "GlobalSettings.hpp"
 #include "Lexer.hpp"
+#include "Session.hpp"
 #include "TokenParser.hpp"
+#include "Trace.hpp"
 
 #define HANNAC_VERSION "0.0.1"
 
 void print_help()
 {
     std::cout << "Hannac compiler/interpreter." << "(" << HANNAC_VERSION << ")" << std::endl;
-    std::cout << "Usage: hannac <HANNA_FILE> <COMMAND_LINE_OPTIONS>" << std::endl;
+    std::cout << "Usage: hannac <HANNA_FILE>... <COMMAND_LINE_OPTIONS>" << std::endl;
     std::cout << "Command line options:" << std::endl;
     std::cout << "-v,--verbose:\t" << "Enable verbose logging." << std::endl;
+    std::cout << "-O<0-3>:\t" << "Optimization level (default 2)." << std::endl;
+    std::cout << "--fast-math:\t" << "Allow reassociating and contracting real arithmetic, like -ffast-math."
+              << std::endl;
+    std::cout << "-g:\t" << "Emit debug info mapping JIT code to hanna source lines." << std::endl;
+    std::cout << "--perf:\t" << "Write /tmp/perf-<PID>.map and jitdump records for profilers." << std::endl;
+    std::cout << "--cache-dir=<DIR>:\t" << "Persistent object cache directory." << std::endl;
+    std::cout << "--cache-size=<MB>:\t" << "Maximum size of the object cache (default 256)." << std::endl;
+    std::cout << "--batch-size=<N>:\t" << "Methods generated into one JIT module (default 1)." << std::endl;
+    std::cout << "--code-budget=<KB>:\t" << "Maximum JIT code kept loaded, cold methods are evicted." << std::endl;
+    std::cout << "--tier-up=<CALLS>:\t" << "Optimize methods called CALLS times at -O3 in the background." << std::endl;
+    std::cout << "--opt-budget=<MS>:\t" << "Time the optimizer may spend per program, then only light passes run."
+              << std::endl;
+    std::cout << "--clone-threshold=<CALLS>:\t"
+              << "Clone methods called CALLS times with the same constant (default 0, disabled)." << std::endl;
+    std::cout << "--max-clones=<N>:\t" << "Maximum number of clones with baked in constants (default 64)." << std::endl;
+    std::cout << "--max-specializations=<N>:\t"
+              << "Specializations per method before the generic version runs (default 0, unlimited)." << std::endl;
+    std::cout << "--time-report:\t" << "Print the time spent per compilation phase." << std::endl;
+    std::cout << "--trace=<FILE>:\t" << "Write a Chrome trace of compilation and execution." << std::endl;
+    std::cout << "--stats-json=<FILE>:\t" << "Write counters, sizes and memory of the run as JSON." << std::endl;
+    std::cout << "--profile:\t" << "Print calls and time of every method and statement at exit." << std::endl;
+    std::cout << "--profile-callgraph=<FILE>:\t" << "Profile and write the call graph in DOT format." << std::endl;
+    std::cout << "--remarks=<FILE>:\t" << "Write LLVM optimization remarks per method as YAML, or JSON for *.json."
+              << std::endl;
+    std::cout << "--alloc-report:\t" << "Print heap allocations per phase, needs a HANNAC_TRACK_ALLOCATIONS build."
+              << std::endl;
+    std::cout << "--hw-counters[=methods]:\t"
+              << "Count cycles, instructions, branch and cache misses per statement, or also per method." << std::endl;
+    std::cout << "-j<N>,--jobs=<N>:\t" << "Number of compile threads (default 1)." << std::endl;
+    std::cout << "--emit=<obj|exe>:\t" << "Compile ahead of time to an object file or executable." << std::endl;
+    std::cout << "-o <FILE>:\t" << "Output file for --emit." << std::endl;
+    std::cout << "--lib=<FILE>:\t" << "Hanna file defining methods shared by all programs." << std::endl;
     std::cout << "-h,--help:\t" << "Print this text" << std::endl;
     std::cout << "--version:\t" << "Print version" << std::endl;
 
@@ -36,22 +76,139 @@ int main(int argc, char *argv[])
         return 0;
     }
     // Parse command line arguments.
-    std::string filename{};
+    std::vector<std::string> filenames{};
+    std::string libname{};
+    std::string output{};
+    hannac::HSettings settings;
+    auto emitType = hannac::HEmitType::JIT;
+    bool allocReport = false;
     for (int i = 1; i < argc; i++)
     {
         std::string arg{argv[i]};
         if (arg[0] != '-')
         {
             // Get filename
-            filename = arg;
+            filenames.push_back(arg);
         }
         else if (arg == "-v" || arg == "--verbose")
         {
-            hannac::HSettings::get_settings().set_verbose(2);
+            settings.set_verbose(2);
         }
         else if (arg == "-v1" || arg == "--verbose1")
         {
-            hannac::HSettings::get_settings().set_verbose(1);
+            settings.set_verbose(1);
+        }
+        else if (arg.size() == 3 && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3')
+        {
+            settings.set_opt_level(arg[2] - '0');
+        }
+        else if (arg == "--fast-math")
+        {
+            settings.set_fast_math(true);
+        }
+        else if (arg == "-g")
+        {
+            settings.set_debug_info(true);
+        }
+        else if (arg == "--perf")
+        {
+            settings.set_perf(true);
+        }
+        else if (arg.rfind("--cache-dir=", 0) == 0)
+        {
+            settings.set_cache_dir(arg.substr(std::string("--cache-dir=").size()));
+        }
+        else if (arg.rfind("--cache-size=", 0) == 0)
+        {
+            settings.set_cache_size(std::stoull(arg.substr(std::string("--cache-size=").size())) * 1024 * 1024);
+        }
+        else if (arg.rfind("--batch-size=", 0) == 0)
+        {
+            settings.set_batch_size(std::stoull(arg.substr(std::string("--batch-size=").size())));
+        }
+        else if (arg.rfind("--code-budget=", 0) == 0)
+        {
+            settings.set_code_budget(std::stoull(arg.substr(std::string("--code-budget=").size())) * 1024);
+        }
+        else if (arg.rfind("--tier-up=", 0) == 0)
+        {
+            settings.set_tier_up_threshold(std::stoull(arg.substr(std::string("--tier-up=").size())));
+        }
+        else if (arg.rfind("--opt-budget=", 0) == 0)
+        {
+            settings.set_opt_budget(std::stoull(arg.substr(std::string("--opt-budget=").size())));
+        }
+        else if (arg.rfind("--clone-threshold=", 0) == 0)
+        {
+            settings.set_clone_threshold(std::stoull(arg.substr(std::string("--clone-threshold=").size())));
+        }
+        else if (arg.rfind("--max-clones=", 0) == 0)
+        {
+            settings.set_max_clones(std::stoull(arg.substr(std::string("--max-clones=").size())));
+        }
+        else if (arg.rfind("--max-specializations=", 0) == 0)
+        {
+            settings.set_max_specializations(std::stoull(arg.substr(std::string("--max-specializations=").size())));
+        }
+        else if (arg == "--time-report")
+        {
+            settings.set_time_report(true);
+        }
+        else if (arg.rfind("--trace=", 0) == 0)
+        {
+            settings.set_trace_file(arg.substr(std::string("--trace=").size()));
+        }
+        else if (arg.rfind("--stats-json=", 0) == 0)
+        {
+            settings.set_stats_file(arg.substr(std::string("--stats-json=").size()));
+        }
+        else if (arg == "--profile")
+        {
+            settings.set_profile(true);
+        }
+        else if (arg.rfind("--profile-callgraph=", 0) == 0)
+        {
+            settings.set_call_graph_file(arg.substr(std::string("--profile-callgraph=").size()));
+        }
+        else if (arg.rfind("--remarks=", 0) == 0)
+        {
+            settings.set_remarks_file(arg.substr(std::string("--remarks=").size()));
+        }
+        else if (arg == "--alloc-report")
+        {
+            allocReport = true;
+        }
+        else if (arg == "--hw-counters")
+        {
+            settings.set_hardware_counters(hannac::HHardwareCounters::Statements);
+        }
+        else if (arg == "--hw-counters=methods")
+        {
+            settings.set_hardware_counters(hannac::HHardwareCounters::Methods);
+        }
+        else if (arg.rfind("--jobs=", 0) == 0)
+        {
+            settings.set_jobs(std::stoul(arg.substr(std::string("--jobs=").size())));
+        }
+        else if (arg.size() > 2 && arg.rfind("-j", 0) == 0)
+        {
+            settings.set_jobs(std::stoul(arg.substr(2)));
+        }
+        else if (arg == "--emit=obj")
+        {
+            emitType = hannac::HEmitType::OBJ;
+        }
+        else if (arg == "--emit=exe")
+        {
+            emitType = hannac::HEmitType::EXE;
+        }
+        else if (arg.rfind("--lib=", 0) == 0)
+        {
+            libname = arg.substr(std::string("--lib=").size());
+        }
+        else if (arg == "-o" && i + 1 < argc)
+        {
+            output = argv[++i];
         }
         else if (arg == "-h" || arg == "--help")
         {
@@ -69,18 +226,111 @@ int main(int argc, char *argv[])
             return 0;
         }
     }
-    std::cout << "Compiling: " << filename << std::endl;
+    if (filenames.empty())
+    {
+        std::cout << "No hanna file provided." << std::endl;
+        return 0;
+    }
+    if (emitType != hannac::HEmitType::JIT && !output.empty() && filenames.size() > 1)
+    {
+        std::cout << "-o can't be used with multiple hanna files." << std::endl;
+        return 0;
+    }
+
+    // Compile threads trace their own spans.
+    if (!settings.get_trace_file().empty())
+        hannac::start_thread_trace();
 
     // Start compiler.
     try
     {
-        // Setup parsing of hanna file.
-        hannac::HTokenParser parser{hannac::HLexer{hannac::HFileParser{filename}}};
+        // Methods of the library are compiled once and shared by all programs.
+        hannac::HSession library{settings};
+        if (!libname.empty())
+        {
+            std::cout << "Loading library: " << libname << std::endl;
+            hannac::HTokenParser parser{library, hannac::HLexer{hannac::HFileParser{libname}}};
+            parser.parse_library();
+        }
+
+        for (auto const &filename : filenames)
+        {
+            std::cout << "Compiling: " << filename << std::endl;
+
+            // Everything compiled from the hanna file lives in its own session, it is torn down after the program ran.
+            hannac::HSession session{library};
+
+            // Setup parsing of hanna file.
+            hannac::HTokenParser parser{session, hannac::HLexer{hannac::HFileParser{filename}}};
+
+            // Parse program.
+            auto program = parser.parse();
+
+            // Compile program ahead of time.
+            if (emitType != hannac::HEmitType::JIT)
+            {
+                auto path = output;
+                if (path.empty())
+                {
+                    std::filesystem::path file{filename};
+                    path = file.stem().string() + (emitType == hannac::HEmitType::OBJ ? ".o" : "");
+                }
+                hannac::HEmitter emitter{session, std::move(program)};
+                emitter(path, emitType);
+                std::cout << "Written: " << path << std::endl;
+
+                continue;
+            }
+
+            // Execute program.
+            hannac::HExecutor ex{session, std::move(program)};
+            ex();
+
+            // Specializations of library methods are compiled into the library, which the executor doesn't evict.
+            // No code runs between two programs.
+            if (auto error = library.get_library().evict_cold_methods())
+                std::cout << "Unable to evict library code: " << llvm::toString(std::move(error)) << std::endl;
+        }
 
-        // Parse program.
-        // Execute program.
-        hannac::HExecutor ex{parser.parse()};
-        ex();
+        // All programs share the JIT of the library.
+        if (settings.get_time_report())
+            library.get_jit().get_time_report().print(std::cout);
+        if (allocReport && hannac::HAllocationTracker::enabled())
+            hannac::HAllocationTracker::print(std::cout);
+        else if (allocReport)
+            std::cout << "Allocations aren't tracked, configure with -DHANNAC_TRACK_ALLOCATIONS=ON." << std::endl;
+        if (!settings.get_stats_file().empty())
+        {
+            std::ofstream stats{settings.get_stats_file()};
+            if (stats.is_open())
+                library.get_jit().get_run_stats().write_json(stats, library.get_jit().get_time_report());
+            else
+                std::cout << "Unable to write statistics: " << settings.get_stats_file() << std::endl;
+        }
+        if (settings.get_profile() || settings.get_hardware_counters() == hannac::HHardwareCounters::Methods)
+            library.get_jit().get_profiler().print(std::cout);
+        if (settings.get_hardware_counters() != hannac::HHardwareCounters::None)
+            library.get_jit().get_counter_report().print(std::cout);
+        if (!settings.get_remarks_file().empty())
+        {
+            std::filesystem::path path{settings.get_remarks_file()};
+            std::ofstream remarks{path};
+            if (!remarks.is_open())
+                std::cout << "Unable to write remarks: " << path.string() << std::endl;
+            else if (path.extension() == ".json")
+                library.get_jit().get_remarks().write_json(remarks);
+            else
+                library.get_jit().get_remarks().write_yaml(remarks);
+            library.get_jit().get_remarks().print_summary(std::cout);
+        }
+        if (!settings.get_call_graph_file().empty())
+        {
+            std::ofstream callGraph{settings.get_call_graph_file()};
+            if (callGraph.is_open())
+                library.get_jit().get_profiler().write_call_graph(callGraph);
+            else
+                std::cout << "Unable to write call graph: " << settings.get_call_graph_file() << std::endl;
+        }
     }
     catch (const std::exception &excep)
     {
@@ -89,5 +339,14 @@ int main(int argc, char *argv[])
         std::cerr << red << "ERROR: " << excep.what() << reset << std::endl;
     }
 
+    // The JIT is gone, so are the compile threads and their spans are complete.
+    if (!settings.get_trace_file().empty())
+    {
+        if (auto error = hannac::write_trace(settings.get_trace_file()))
+            std::cout << "Unable to write trace: " << llvm::toString(std::move(error)) << std::endl;
+        else
+            std::cout << "Written: " << settings.get_trace_file() << std::endl;
+    }
+
     return 1;
 }
\ No newline at end of file